@@ -1,10 +1,14 @@
+#include <algorithm>
 #include <cstring>
-#include <ctime>
+#include <atomic>
 #include <iostream>
+#include <thread>
 
 #include "global.h"
 #include "struct/table.h"
+#include "struct/aggregate.h"
 #include "file/heapFile.h"
+#include "index/keySorter.h"
 #include "utils/utils.h"
 
 #include "minisql.h"
@@ -14,10 +18,18 @@
 
 using namespace std;
 
+// Percentage of entries of an analyzed index beyond which scanning table is cheaper than index
+const int Api::SCAN_PERCENT = 30;
+
+// Percentage of entries taken to satisfy range conditions on a column other than the first
+const int Api::RANGE_PERCENT = 30;
+
 // Select record. Return number of records selected
+// All columns are selected if selected column list is empty
 int Api::select(
-    const char* tableName, const vector<string>* colName,
-    const vector<int>* cond, const vector<string>* operand
+    const char* tableName, const vector<string>* selColName,
+    const vector<string>* colName, const vector<int>* cond,
+    const vector<string>* operand
 )
 {
     // Get manager and table
@@ -27,77 +39,169 @@ int Api::select(
     if (table == NULL)
         return -1;
 
-    int condCount = (int)cond->size();
-
     // Check condition validity
-    for (int i = 0; i < condCount; i++)
-        if (
-            cond->at(i) != COND_EQ &&
-            cond->at(i) != COND_NE &&
-            cond->at(i) != COND_LT &&
-            cond->at(i) != COND_GT &&
-            cond->at(i) != COND_LE &&
-            cond->at(i) != COND_GE
-        )
-        {
-            cerr << "ERROR: [Api::select] Unknown condition `" << cond->at(i) << "`!" << endl;
-            return -1;
-        }
+    if (!checkCondition(tableName, colName, cond))
+        return -1;
 
-    // Check if column name exists
-    for (int i = 0; i < condCount; i++)
+    // Get projected column ids
+    vector<int> projection;
+    if (selColName->empty())
+        for (int i = 0; i < table->getColCount(); i++)
+            projection.push_back(i);
+    for (auto name : *selColName)
     {
-        short type = table->getType(colName->at(i).c_str());
-        if (type == TYPE_NULL)
+        int id = table->getId(name.c_str());
+        if (id < 0)
+        {
+            cerr << "ERROR: [Api::select] Table `" << tableName << "` has no column named `" << name << "`!" << endl;
             return -1;
+        }
+        projection.push_back(id);
     }
 
-    // Get select result
+    // Get select result. Only projected columns are extracted
     vector<char*> record;
     vector<int> _;
 
     int selectCount = filter(
-        tableName, colName, cond, operand, &record, &_
+        tableName, colName, cond, operand, &record, &_, &projection
     );
     if (selectCount < 0)
         return -1;
 
     // Print column name
     cout << endl;
-    int colCount = table->getColCount();
-    for (int i = 0; i < colCount; i++)
-        cout << table->getColName(i) << "\t";
+    for (auto id : projection)
+        cout << table->getColName(id) << "\t";
     cout << endl << "----------------------------------------" << endl;
 
-    // Parse and print each record
-    vector<char*> parsed;
-
+    // Print each projected record
     for (auto data : record)
     {
-        table->recordToVec(data, &parsed);
-        for (int i = 0; i < colCount; i++)
+        const char* value = data;
+        for (auto id : projection)
         {
-            short type = table->getType(table->getColName(i));
-            
+            short type = table->getColType(id);
+
             if (type <= TYPE_CHAR)
-                cout << parsed[i] << "\t";
+                cout << value << "\t";
             else if (type == TYPE_INT)
-                cout << *(reinterpret_cast<int*>(parsed[i])) << "\t";
+                cout << *(reinterpret_cast<const int*>(value)) << "\t";
             else if (type == TYPE_FLOAT)
-                cout << *(reinterpret_cast<float*>(parsed[i])) << "\t";
+                cout << *(reinterpret_cast<const float*>(value)) << "\t";
+            value += Utils::getTypeSize(type);
         }
         cout << endl;
 
-        // Clean up parsed record
-        for (int i = 0; i < colCount; i++)
-            delete[] parsed[i];
-        parsed.clear();
+        delete[] data;
     }
     cout << endl;
 
     return selectCount;
 }
 
+// Select aggregates of records. Return number of records aggregated
+int Api::aggregate(
+    const char* tableName, const vector<int>* aggFunc, const vector<string>* aggCol,
+    const vector<string>* colName, const vector<int>* cond, const vector<string>* operand
+)
+{
+    // Get manager and table
+    CatalogManager* catalogManager = MiniSQL::getCatalogManager();
+    RecordManager* recordManager = MiniSQL::getRecordManager();
+
+    Table* table = catalogManager->getTable(tableName);
+    if (table == NULL)
+        return -1;
+
+    // Check condition validity
+    if (!checkCondition(tableName, colName, cond))
+        return -1;
+
+    // Prepare aggregates
+    vector<Aggregate*> aggregates;
+    bool countOnly = true;
+
+    for (int i = 0; i < (int)aggFunc->size(); i++)
+    {
+        int func = aggFunc->at(i);
+        const char* col = aggCol->at(i).c_str();
+
+        if (func != AGG_COUNT)
+            countOnly = false;
+        if (aggCol->at(i) == "*")
+        {
+            aggregates.push_back(new Aggregate(func, col, TYPE_NULL, 0));
+            continue;
+        }
+
+        short type = table->getType(col);
+        if (type == TYPE_NULL || ((func == AGG_SUM || func == AGG_AVG) && type <= TYPE_CHAR))
+        {
+            if (type != TYPE_NULL)
+                cerr << "ERROR: [Api::aggregate] Cannot apply sum or avg on char column `" << col << "`!" << endl;
+            for (auto agg : aggregates)
+                delete agg;
+            return -1;
+        }
+
+        int id = table->getId(col);
+        aggregates.push_back(new Aggregate(func, col, type, table->getColStart(id)));
+    }
+
+    int aggCount;
+    if (countOnly && cond->empty())
+    {
+        // Count without condition. Read live record count from file header
+        HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
+        aggCount = file->getLiveCount();
+        delete file;
+
+        for (auto agg : aggregates)
+            agg->setCount(aggCount);
+    }
+    else if (hasIndexedCondition(tableName, colName, cond))
+    {
+        // Index may match many records by ranges, in-lists looked up as one batch, or combined bitmaps
+        // Matched records are collected in record id order, then aggregated one by one
+        // Only aggregated columns are read, so a covering index may answer alone
+        vector<char*> record;
+        vector<int> _, used;
+        for (auto& col : *aggCol)
+            if (col != "*")
+                used.push_back(table->getId(col.c_str()));
+
+        aggCount = filter(tableName, colName, cond, operand, &record, &_, NULL, &used);
+        for (auto data : record)
+        {
+            for (auto agg : aggregates)
+                agg->add(data);
+            delete[] data;
+        }
+    }
+    else
+        // Aggregate while scanning
+        aggCount = recordManager->aggregate(
+            tableName, colName, cond, operand, &aggregates
+        );
+
+    if (aggCount >= 0)
+    {
+        // Print aggregate name and result
+        cout << endl;
+        for (auto agg : aggregates)
+            cout << agg->getTitle() << "\t";
+        cout << endl << "----------------------------------------" << endl;
+        for (auto agg : aggregates)
+            cout << agg->getResult() << "\t";
+        cout << endl << endl;
+    }
+
+    for (auto agg : aggregates)
+        delete agg;
+    return aggCount;
+}
+
 // Insert record. Return true if success
 bool Api::insert(const char* tableName, const vector<string>* value)
 {
@@ -129,18 +233,17 @@ bool Api::insert(const char* tableName, const vector<string>* value)
     }
 
     // Insert data into indices
-    vector<char*> vec;
-    table->recordToVec(data, &vec);
     vector<Index*> indices;
     catalogManager->getIndexByTable(tableName, &indices);
 
     for (auto index : indices)
-        indexManager->insert(
-            index->getName(), vec[table->getId(index->getColName())], res
-        );
+    {
+        vector<int> cols;
+        getKeyCol(table, index, &cols);
+        indexManager->insert(index->getName(), table->getKey(data, &cols).data(), res);
+        index->addModified(1);
+    }
 
-    for (auto t : vec)
-        delete[] t;
     delete[] data;
     return true;
 }
@@ -158,43 +261,169 @@ int Api::remove(
 
     Table* table = catalogManager->getTable(tableName);
     if (table == NULL)
-        return false;
+        return -1;
 
-    // Get select result
-    vector<char*> record;
-    vector<int> ids;
+    // Check condition validity
+    if (!checkCondition(tableName, colName, cond))
+        return -1;
 
-    int selectCount = filter(
-        tableName, colName, cond, operand, &record, &ids
-    );
-    if (selectCount < 0)
+    // Get key columns of indices
+    vector<Index*> indices;
+    catalogManager->getIndexByTable(tableName, &indices);
+    vector<vector<int>> keyCol(indices.size());
+    for (int i = 0; i < (int)indices.size(); i++)
+        getKeyCol(table, indices[i], &keyCol[i]);
+
+    // Get delete result. Keys of deleted records are collected for each index
+    vector<vector<string>> keys;
+    vector<int> keyIds;
+    int removeCount;
+
+    if (hasIndexedCondition(tableName, colName, cond))
+    {
+        // Use index to find records to delete
+        vector<char*> record;
+        vector<int> ids;
+
+        if (filter(tableName, colName, cond, operand, &record, &ids) < 0)
+            return -1;
+        for (auto data : record)
+            delete[] data;
+
+        removeCount = recordManager->remove(tableName, &ids, &keyCol, &keys, &keyIds);
+    }
+    else
+        // Delete while scanning
+        removeCount = recordManager->remove(
+            tableName, colName, cond, operand, &keyCol, &keys, &keyIds
+        );
+    if (removeCount < 0)
         return -1;
 
-    // Get delete result
-    bool res = recordManager->remove(tableName, &ids);
-    if (!res)
+    // Delete keys from indices in batch
+    for (int i = 0; i < (int)indices.size(); i++)
+    {
+        indexManager->removeBatch(indices[i]->getName(), &keys[i], &keyIds);
+        indices[i]->addModified(keys[i].size());
+    }
+
+    return removeCount;
+}
+
+// Update record. Return number of records updated
+int Api::update(
+    const char* tableName, const vector<string>* setColName, const vector<string>* setValue,
+    const vector<string>* colName, const vector<int>* cond, const vector<string>* operand
+)
+{
+    // Get manager and table
+    CatalogManager* catalogManager = MiniSQL::getCatalogManager();
+    RecordManager* recordManager = MiniSQL::getRecordManager();
+    IndexManager* indexManager = MiniSQL::getIndexManager();
+
+    Table* table = catalogManager->getTable(tableName);
+    if (table == NULL)
         return -1;
 
-    // Delete data from indices
-    vector<char*> vec;
+    // Check condition validity
+    if (!checkCondition(tableName, colName, cond))
+        return -1;
+
+    // Parse new values
+    vector<int> setCol;
+    vector<string> setData;
+    bool setUnique = false;
+
+    for (int i = 0; i < (int)setColName->size(); i++)
+    {
+        const char* name = setColName->at(i).c_str();
+        short type = table->getType(name);
+        if (type == TYPE_NULL)
+            return -1;
+
+        char* data = Utils::getDataFromStr(setValue->at(i).c_str(), type);
+        if (data == NULL)
+            return -1;
+
+        setCol.push_back(table->getId(name));
+        setData.push_back(string(data, Utils::getTypeSize(type)));
+        if (table->getUnique(name))
+            setUnique = true;
+        delete[] data;
+    }
+
+    // Get key columns of indices
     vector<Index*> indices;
     catalogManager->getIndexByTable(tableName, &indices);
+    vector<vector<int>> keyCol(indices.size());
+    for (int i = 0; i < (int)indices.size(); i++)
+        getKeyCol(table, indices[i], &keyCol[i]);
 
-    for (auto data : record)
+    // Get update result. Old and new keys of indices on changed columns are collected
+    vector<vector<string>> keys;
+    vector<vector<string>> newKeys;
+    vector<vector<int>> keyIds;
+    int updateCount;
+
+    if (setUnique || hasIndexedCondition(tableName, colName, cond))
     {
-        vec.clear();
-        table->recordToVec(data, &vec);
+        // Find records to update first
+        vector<char*> record;
+        vector<int> ids;
 
-        for (auto index : indices)
-            indexManager->remove(
-                index->getName(), vec[table->getId(index->getColName())]
-            );
+        if (filter(tableName, colName, cond, operand, &record, &ids) < 0)
+            return -1;
+        for (auto data : record)
+            delete[] data;
+
+        // Setting unique column to a constant must not create duplicates
+        for (int i = 0; i < (int)setCol.size() && !ids.empty(); i++)
+        {
+            if (!table->getUnique(setColName->at(i).c_str()))
+                continue;
+
+            vector<string> uniqueColName(1, setColName->at(i));
+            vector<int> uniqueCond(1, COND_EQ);
+            vector<string> uniqueOperand(1, setValue->at(i));
+            vector<char*> exist;
+            vector<int> existIds;
 
-        for (auto t : vec)
-            delete[] t;
+            filter(tableName, &uniqueColName, &uniqueCond, &uniqueOperand, &exist, &existIds);
+            for (auto data : exist)
+                delete[] data;
+
+            if (ids.size() > 1 || (!existIds.empty() && existIds[0] != ids[0]))
+            {
+                cerr << "ERROR: [Api::update] Duplicate values in unique column `" << setColName->at(i) << "` of table `" << tableName << "`!" << endl;
+                return -1;
+            }
+        }
+
+        updateCount = recordManager->update(
+            tableName, &ids, &setCol, &setData, &keyCol, &keys, &newKeys, &keyIds
+        );
     }
+    else
+        // Update while scanning
+        updateCount = recordManager->update(
+            tableName, colName, cond, operand, &setCol, &setData, &keyCol, &keys, &newKeys, &keyIds
+        );
+    if (updateCount < 0)
+        return -1;
 
-    return selectCount;
+    // Maintain indices whose column is changed
+    for (int i = 0; i < (int)indices.size(); i++)
+    {
+        if (keys[i].empty())
+            continue;
+
+        indexManager->removeBatch(indices[i]->getName(), &keys[i], &keyIds[i]);
+        for (int j = 0; j < (int)newKeys[i].size(); j++)
+            indexManager->insert(indices[i]->getName(), newKeys[i][j].data(), keyIds[i][j]);
+        indices[i]->addModified(keys[i].size());
+    }
+
+    return updateCount;
 }
 
 // Create table. Return true if success
@@ -213,7 +442,17 @@ bool Api::createTable(
     ))
     {
         recordManager->createTable(tableName);
-        createIndex(to_string(time(0)).c_str(), tableName, primary);
+
+        // Index on primary key is named after its table
+        // Table is dropped again if index cannot be created, e.g. another index has its name
+        vector<string> primaryCol(1, primary);
+        if (!createIndex(tableName, tableName, &primaryCol))
+        {
+            cerr << "ERROR: [Api::createTable] Cannot create index on primary key of table `"
+                << tableName << "`!" << endl;
+            dropTable(tableName);
+            return false;
+        }
         return true;
     }
     else
@@ -244,31 +483,27 @@ bool Api::dropTable(const char* tableName)
         return false;
 }
 
-// Create index. Return true if success
-bool Api::createIndex(const char* indexName, const char* tableName, const char* colName)
+// Create index of type on columns. Included columns are stored in index after key columns
+// Progress of scanning records is reported if progress is not NULL. Return true if success
+bool Api::createIndex(
+    const char* indexName, const char* tableName,
+    const vector<string>* colName, int type,
+    const vector<string>* includeColName, ProgressCallback progress
+)
 {
     // Get manager
     CatalogManager* catalogManager = MiniSQL::getCatalogManager();
-    IndexManager* indexManager = MiniSQL::getIndexManager();
 
     // Get create result
-    if (catalogManager->createIndex(indexName, tableName, colName))
+    vector<string> noInclude;
+    if (catalogManager->createIndex(
+        indexName, tableName, colName, includeColName == NULL ? &noInclude : includeColName, type
+    ))
     {
-        indexManager->createIndex(indexName);
-
-        // Add current records into index
-        HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
-        Table* table = catalogManager->getTable(tableName);
-        char* data = new char[table->getRecordLength()];
-        int id;
-        while ((id = file->getNextRecord(data)) >= 0)
-        {
-            char dataOut[MAX_VALUE_LENGTH];
-            table->getValue(colName, data, dataOut);
-            indexManager->insert(indexName, dataOut, id);
-        }
-
-        return true;
+        bool res = buildIndex(indexName, progress);
+        if (!res)
+            dropIndex(indexName);
+        return res;
     }
     else
         return false;
@@ -291,12 +526,225 @@ bool Api::dropIndex(const char* indexName)
         return false;
 }
 
+// Collect and print statistics of index, and save them for planning. Return true if success
+bool Api::analyzeIndex(const char* indexName)
+{
+    // Get manager
+    CatalogManager* catalogManager = MiniSQL::getCatalogManager();
+    IndexManager* indexManager = MiniSQL::getIndexManager();
+
+    Index* index = catalogManager->getIndex(indexName);
+    if (index == NULL)
+        return false;
+    IndexStats stats;
+    if (!indexManager->analyze(indexName, &stats) || !catalogManager->setIndexStats(indexName, &stats))
+        return false;
+
+    // Print tree figures
+    cout << endl << "height\tnodes\tleaves\tfill(%)\tentries\t";
+    cout << endl << "----------------------------------------" << endl;
+    cout << stats.height << "\t" << stats.nodeCount << "\t" << stats.leafCount << "\t";
+    cout << stats.leafFill << "\t" << stats.entryCount << "\t" << endl << endl;
+
+    // Print distinct values of each column prefix
+    cout << "column\tdistinct\t";
+    cout << endl << "----------------------------------------" << endl;
+    for (int i = 0; i < index->getColCount(); i++)
+        cout << index->getColName(i) << "\t" << stats.distinct[i] << "\t" << endl;
+    cout << endl;
+
+    // Print histogram of first column
+    short type = catalogManager->getTable(index->getTableName())->getType(index->getColName());
+    char* data = new char[Utils::getTypeSize(type)];
+    cout << "bound\trows\tdistinct\t";
+    cout << endl << "----------------------------------------" << endl;
+    for (int i = 0; i < (int)stats.bound.size(); i++)
+    {
+        Utils::decodeKey(stats.bound[i].data(), type, data);
+        cout << Utils::getStrFromData(data, type) << "\t" << stats.bucketCount[i] << "\t";
+        cout << stats.bucketDistinct[i] << "\t" << endl;
+    }
+    cout << endl;
+    delete[] data;
+
+    return true;
+}
+
+// Vacuum table. Return true if success
+bool Api::vacuum(const char* tableName)
+{
+    // Get manager
+    CatalogManager* catalogManager = MiniSQL::getCatalogManager();
+    RecordManager* recordManager = MiniSQL::getRecordManager();
+
+    if (catalogManager->getTable(tableName) == NULL)
+        return false;
+    return recordManager->vacuum(tableName);
+}
+
+// Write modification counts of analyzed indices, headers, pending messages and bitmaps kept by open indices,
+// and then all dirty blocks back to file
+void Api::checkpoint()
+{
+    MiniSQL::getCatalogManager()->flushStats();
+    MiniSQL::getIndexManager()->checkpoint();
+    MiniSQL::getBufferManager()->flush();
+}
+
+// Rebuild indices whose files are in an older format from records of their tables
+void Api::upgradeIndices()
+{
+    CatalogManager* catalogManager = MiniSQL::getCatalogManager();
+    IndexManager* indexManager = MiniSQL::getIndexManager();
+
+    vector<Index*> indices;
+    catalogManager->getAllIndices(&indices);
+    for (auto index : indices)
+    {
+        if (!indexManager->isOutdated(index->getName()))
+            continue;
+
+        // Catalog keeps index. Only its file is dropped and built again
+        indexManager->dropIndex(index->getName());
+        if (buildIndex(index->getName(), NULL))
+            cout << "Index `" << index->getName() << "` is rebuilt in current file format." << endl;
+        else
+            cerr << "ERROR: [Api::upgradeIndices] Cannot rebuild index `" << index->getName() << "`!" << endl;
+    }
+}
+
+// Set percentage of each index node filled by bulk loading. Return true if success
+bool Api::setFillFactor(int fillFactor)
+{
+    if (fillFactor < 50 || fillFactor > 100)
+    {
+        cerr << "ERROR: [Api::setFillFactor] Fill factor should be between 50 and 100, but found " << fillFactor << "." << endl;
+        return false;
+    }
+
+    MiniSQL::getIndexManager()->setFillFactor(fillFactor);
+    return true;
+}
+
+// Set number of threads building an index. Return true if success
+bool Api::setThreadCount(int threadCount)
+{
+    if (threadCount < 1 || threadCount > IndexManager::MAX_THREAD_COUNT)
+    {
+        cerr << "ERROR: [Api::setThreadCount] Number of threads should be between 1 and " << IndexManager::MAX_THREAD_COUNT << ", but found " << threadCount << "." << endl;
+        return false;
+    }
+
+    MiniSQL::getIndexManager()->setThreadCount(threadCount);
+    return true;
+}
+
+// Set megabytes of memory for in-memory mirrors of B+ tree indices. Return true if success
+bool Api::setCacheSize(int cacheSize)
+{
+    if (cacheSize < 0 || cacheSize > IndexManager::MAX_CACHE_SIZE)
+    {
+        cerr << "ERROR: [Api::setCacheSize] Cache size should be between 0 and " << IndexManager::MAX_CACHE_SIZE << " megabytes, but found " << cacheSize << "." << endl;
+        return false;
+    }
+
+    MiniSQL::getIndexManager()->setCacheSize(cacheSize);
+    return true;
+}
+
+// Estimate number of entries of index read for equality or in conditions on prefix columns,
+// and for range conditions on the next column if range is true. Return -1 if index is not analyzed
+double Api::estimateRows(
+    Table* table, Index* index, const vector<int>* prefix, bool range,
+    const vector<string>* colName, const vector<int>* cond, const vector<string>* operand
+)
+{
+    const IndexStats* stats = index->getStats();
+    if (stats == NULL)
+        return -1;
+    if (stats->entryCount == 0)
+        return 0;
+
+    // Encode value of first column to compare with histogram bounds
+    short type = table->getType(index->getColName());
+    string key(Utils::getTypeSize(type), 0);
+    auto encode = [&](const string& value) -> bool
+    {
+        if (type <= TYPE_CHAR && (int)value.size() > type)
+            return false;
+        char* data = Utils::getDataFromStr(value.c_str(), type);
+        if (data == NULL)
+            return false;
+        Utils::encodeKey(data, type, &key[0]);
+        delete[] data;
+        return true;
+    };
+
+    // Values of the first column are looked up in histogram
+    // Each further column divides entries by the growth of distinct prefixes
+    double rows = stats->entryCount;
+    int prefixCount = prefix->size();
+    for (int c = 0; c < prefixCount; c++)
+    {
+        vector<string> values;
+        int i = prefix->at(c);
+        if (cond->at(i) == COND_IN)
+            Utils::splitList(operand->at(i), &values);
+        else
+            values.push_back(operand->at(i));
+
+        if (c > 0)
+        {
+            rows *= 1.0 * values.size() * stats->distinct[c - 1] / stats->distinct[c];
+            continue;
+        }
+        rows = 0;
+        for (auto& value : values)
+            if (encode(value))
+                rows += index->estimateEqual(key.data());
+    }
+
+    if (range && prefixCount > 0)
+        return rows * RANGE_PERCENT / 100;
+    if (!range)
+        return rows;
+
+    // Range on the first column keeps entries between the tightest bounds
+    double below = 0, upTo = stats->entryCount;
+    for (int i = 0; i < (int)cond->size(); i++)
+    {
+        int op = cond->at(i);
+        if (
+            colName->at(i) != index->getColName() ||
+            (op != COND_LT && op != COND_LE && op != COND_GT && op != COND_GE) ||
+            !encode(operand->at(i))
+        )
+            continue;
+
+        double less = index->estimateLess(key.data());
+        double lessEqual = less + index->estimateEqual(key.data());
+        if (op == COND_GT)
+            below = max(below, lessEqual);
+        else if (op == COND_GE)
+            below = max(below, less);
+        else if (op == COND_LT)
+            upTo = min(upTo, less);
+        else
+            upTo = min(upTo, lessEqual);
+    }
+    return max(upTo - below, 0.0);
+}
+
 // Filter records satisfying all conditions
 // Return number of records filtered
+// Only projected columns are copied if projection is provided
+// If projection or used columns are provided and an index holds them and all condition columns,
+// records are rebuilt from index entries without reading record file. Other columns are left zero
 int Api::filter(
     const char* tableName, const vector<string>* colName,
     const vector<int>* cond, const vector<string>* operand,
-    vector<char*>* record, vector<int>* ids
+    vector<char*>* record, vector<int>* ids,
+    const vector<int>* projection, const vector<int>* used
 )
 {
     // Get managers
@@ -307,56 +755,500 @@ int Api::filter(
     Table* table = catalogManager->getTable(tableName);
     int condCount = (int)cond->size();
 
-    // Try to use index
-    for (int i = 0; i < condCount; i++)
+    // Columns read by caller and conditions. Records cannot be rebuilt from index if caller reads all
+    vector<int> needCol;
+    bool readAll = projection == NULL && used == NULL;
+    if (!readAll)
     {
-        if (cond->at(i) != COND_EQ)
+        needCol = projection != NULL ? *projection : *used;
+        for (auto& name : *colName)
+            needCol.push_back(table->getId(name.c_str()));
+    }
+
+    // Choose index with the longest prefix of columns under equality or in conditions
+    // A range condition on the column after the prefix narrows it further, unless the prefix has in
+    // Hash index is usable only if all its key columns are under equality conditions
+    // It is preferred to B+ tree with the same prefix, as a lookup reads one bucket
+    // Among indices with the same score, one holding all needed columns is preferred
+    // Analyzed indices are compared by estimated number of entries read instead of score
+    // Bitmap indices are not chosen here, as their conditions are combined separately below
+    vector<Index*> indices;
+    catalogManager->getIndexByTable(tableName, &indices);
+    Index* index = NULL;
+    vector<int> eqId;
+    bool useRange = false, useList = false, covering = false;
+    int bestScore = 0;
+    double bestRows = -1;
+
+    for (auto item : indices)
+    {
+        if (item->getType() == INDEX_BITMAP)
             continue;
-        Index* index = catalogManager->getIndexByTableCol(
-            tableName, colName->at(i).c_str()
+
+        vector<int> prefix;
+        bool range = false, list = false;
+        for (int c = 0; c < item->getColCount(); c++)
+        {
+            int found = -1;
+            for (int i = 0; i < condCount && found < 0; i++)
+                if (cond->at(i) == COND_EQ && colName->at(i) == item->getColName(c))
+                    found = i;
+            for (int i = 0; i < condCount && found < 0; i++)
+                if (cond->at(i) == COND_IN && colName->at(i) == item->getColName(c))
+                    found = i;
+            if (found < 0)
+            {
+                for (int i = 0; i < condCount; i++)
+                    if (cond->at(i) != COND_NE && colName->at(i) == item->getColName(c))
+                        range = true;
+                break;
+            }
+            prefix.push_back(found);
+        }
+
+        if (item->getType() == INDEX_HASH)
+        {
+            if ((int)prefix.size() < item->getKeyColCount())
+                continue;
+            prefix.resize(item->getKeyColCount());
+            range = false;
+        }
+        for (auto i : prefix)
+            if (cond->at(i) == COND_IN)
+                list = true;
+        if (list)
+            range = false;
+
+        bool itemCovering = !readAll;
+        if (itemCovering)
+        {
+            vector<int> itemCol;
+            getKeyCol(table, item, &itemCol);
+            for (auto col : needCol)
+                if (find(itemCol.begin(), itemCol.end(), col) == itemCol.end())
+                    itemCovering = false;
+        }
+
+        // Index with fewer columns is preferred for the same conditions
+        int score = prefix.size() * 2 + (range || item->getType() == INDEX_HASH ? 1 : 0);
+        double rows = score > 0 ? estimateRows(table, item, &prefix, range, colName, cond, operand) : -1;
+        bool tie = index != NULL && (
+            (itemCovering && !covering) ||
+            (itemCovering == covering && item->getColCount() < index->getColCount())
         );
-        if (index == NULL)
-            continue;
+        bool better = index != NULL && rows >= 0 && bestRows >= 0 ?
+            rows < bestRows || (rows == bestRows && tie) :
+            score > bestScore || (score == bestScore && tie);
+        if (better)
+        {
+            index = item;
+            eqId = prefix;
+            useRange = range;
+            useList = list;
+            covering = itemCovering;
+            bestScore = score;
+            bestRows = rows;
+        }
+    }
 
-        // Use index to select
-        short type = table->getType(colName->at(i).c_str());
-        char* key = Utils::getDataFromStr(operand->at(i).c_str(), type);
-        if (key == NULL)
+    // Scanning records sequentially is cheaper than fetching most of them through index
+    if (
+        index != NULL && !covering && bestRows >= 0 &&
+        bestRows > 1.0 * index->getStats()->entryCount * SCAN_PERCENT / 100
+    )
+        index = NULL;
+
+    // Bitmaps of conditions on columns with bitmap index are intersected before records are read
+    // A covering index reads no record, so it needs no bitmap
+    Bitmap bitmap;
+    int bitmapCount = 0;
+    if (index == NULL || !covering)
+    {
+        bitmapCount = intersectBitmaps(table, &indices, colName, cond, operand, &bitmap);
+        if (bitmapCount < 0)
             return 0;
-        int id = indexManager->find(index->getName(), key);
+    }
 
-        int ret;
-        if (id < 0)
-            ret = 0;
+    // Use brute force
+    if (index == NULL && bitmapCount == 0)
+        return recordManager->select(
+            tableName, colName, cond, operand, record, ids, projection
+        );
+
+    // Fetch records in bitmap in id order and check all conditions
+    if (index == NULL)
+    {
+        vector<int> candidates;
+        bitmap.getIds(&candidates);
+        return recordManager->select(
+            tableName, &candidates, colName, cond, operand, record, ids, projection
+        );
+    }
+
+    // Concatenate values of equality conditions into key prefix
+    // Condition in gives one key prefix for each of its values
+    int prefixCount = eqId.size();
+    vector<string> prefixes(1);
+    for (int c = 0; c < prefixCount; c++)
+    {
+        short type = table->getType(index->getColName(c));
+        vector<string> values, extended;
+        if (cond->at(eqId[c]) == COND_IN)
+            Utils::splitList(operand->at(eqId[c]), &values);
         else
+            values.push_back(operand->at(eqId[c]));
+
+        for (auto& value : values)
         {
-            // Record found. Check other conditions
-            HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
-            const char* data = file->getRecordById(id);
-            delete file;
-
-            if (recordManager->checkRecord(
-                data, tableName, colName, cond, operand
-            ))
+            // Char value of in longer than column never matches
+            if (cond->at(eqId[c]) == COND_IN && type <= TYPE_CHAR && (int)value.size() > type)
+                continue;
+            char* key = Utils::getDataFromStr(value.c_str(), type);
+            if (key == NULL)
+                return 0;
+            for (auto& prefix : prefixes)
+                extended.push_back(prefix + string(key, Utils::getTypeSize(type)));
+            delete[] key;
+        }
+        prefixes.swap(extended);
+    }
+    string prefix = prefixes.empty() ? "" : prefixes[0];
+    vector<int> candidates;
+    vector<string> entries;
+    vector<string>* entryOut = covering ? &entries : NULL;
+
+    if (useList)
+        // Look up all key prefixes in one sorted pass
+        indexManager->findBatch(index->getName(), &prefixes, prefixCount, &candidates, entryOut);
+    else if (!useRange)
+        // Use index to find all records with equal prefix
+        indexManager->findRange(
+            index->getName(), prefix.data(), true, prefix.data(), true,
+            &candidates, prefixCount, prefixCount, entryOut
+        );
+    else
+    {
+        // Combine all bounds on the column after prefix into the tightest range
+        string rangeColName = index->getColName(prefixCount);
+        short type = table->getType(rangeColName.c_str());
+        char* lower = NULL;
+        char* upper = NULL;
+        bool lowerInclusive = true, upperInclusive = true;
+
+        for (int i = 0; i < condCount; i++)
+        {
+            if (colName->at(i) != rangeColName || cond->at(i) == COND_NE || cond->at(i) == COND_IN)
+                continue;
+
+            char* key = Utils::getDataFromStr(operand->at(i).c_str(), type);
+            if (key == NULL)
             {
-                int recordLength = table->getRecordLength();
-                char* hit = new char[recordLength];
-                memcpy(hit, data, recordLength);
+                delete[] lower;
+                delete[] upper;
+                return 0;
+            }
 
-                record->push_back(hit);
-                ids->push_back(id);
-                ret = 1;
+            if (cond->at(i) == COND_GT || cond->at(i) == COND_GE)
+            {
+                int res = lower == NULL ? 1 : Utils::compareData(key, lower, type);
+                if (res > 0 || (res == 0 && cond->at(i) == COND_GT))
+                {
+                    delete[] lower;
+                    lower = key;
+                    lowerInclusive = cond->at(i) == COND_GE;
+                    continue;
+                }
             }
-            else
-                ret = 0;
+            else if (cond->at(i) == COND_LT || cond->at(i) == COND_LE)
+            {
+                int res = upper == NULL ? -1 : Utils::compareData(key, upper, type);
+                if (res < 0 || (res == 0 && cond->at(i) == COND_LT))
+                {
+                    delete[] upper;
+                    upper = key;
+                    upperInclusive = cond->at(i) == COND_LE;
+                    continue;
+                }
+            }
+            delete[] key;
+        }
+
+        // Missing bound is the prefix itself, or unbounded if there is no prefix
+        string lowerKey = prefix, upperKey = prefix;
+        if (lower != NULL)
+            lowerKey.append(lower, Utils::getTypeSize(type));
+        if (upper != NULL)
+            upperKey.append(upper, Utils::getTypeSize(type));
+
+        // Walk along index leaves
+        indexManager->findRange(
+            index->getName(),
+            lower == NULL && prefixCount == 0 ? NULL : lowerKey.data(), lowerInclusive,
+            upper == NULL && prefixCount == 0 ? NULL : upperKey.data(), upperInclusive,
+            &candidates, prefixCount + (lower != NULL), prefixCount + (upper != NULL), entryOut
+        );
+        delete[] lower;
+        delete[] upper;
+    }
+
+    if (covering)
+    {
+        // Answer from index entries alone. Records are returned in id order like the other paths
+        vector<int> order(candidates.size());
+        for (int i = 0; i < (int)order.size(); i++)
+            order[i] = i;
+        sort(order.begin(), order.end(), [&](int a, int b) { return candidates[a] < candidates[b]; });
+
+        vector<int> sortedCandidates;
+        vector<string> sortedEntries;
+        for (auto i : order)
+        {
+            sortedCandidates.push_back(candidates[i]);
+            sortedEntries.push_back(move(entries[i]));
         }
 
-        delete[] key;
-        return ret;
+        vector<int> entryCol;
+        getKeyCol(table, index, &entryCol);
+        return recordManager->select(
+            tableName, &sortedCandidates, &sortedEntries, &entryCol,
+            colName, cond, operand, record, ids, projection
+        );
     }
 
-    // Use brute force
+    // Ids are sorted so each block is loaded once. Those outside bitmap are dropped before fetching
+    sort(candidates.begin(), candidates.end());
+    if (bitmapCount > 0)
+        candidates.erase(
+            remove_if(candidates.begin(), candidates.end(), [&](int id) { return !bitmap.contains(id); }),
+            candidates.end()
+        );
+
+    // Fetch candidates and check all conditions
     return recordManager->select(
-        tableName, colName, cond, operand, record, ids
+        tableName, &candidates, colName, cond, operand, record, ids, projection
     );
 }
+
+// Intersect bitmaps of conditions on columns with bitmap index into result
+// Each condition unites bitmaps of the keys it accepts. Return number of conditions used, or -1 if an operand is invalid
+int Api::intersectBitmaps(
+    Table* table, const vector<Index*>* indices, const vector<string>* colName,
+    const vector<int>* cond, const vector<string>* operand, Bitmap* result
+)
+{
+    IndexManager* indexManager = MiniSQL::getIndexManager();
+    int useCount = 0;
+    for (int i = 0; i < (int)cond->size(); i++)
+    {
+        Index* index = NULL;
+        for (auto item : *indices)
+            if (item->getType() == INDEX_BITMAP && colName->at(i) == item->getColName())
+                index = item;
+        if (index == NULL)
+            continue;
+
+        // Values of in are united like equalities
+        short type = table->getType(colName->at(i).c_str());
+        vector<string> values;
+        if (cond->at(i) == COND_IN)
+            Utils::splitList(operand->at(i), &values);
+        else
+            values.push_back(operand->at(i));
+
+        Bitmap found;
+        for (auto& value : values)
+        {
+            // Char value of in longer than column never matches
+            if (cond->at(i) == COND_IN && type <= TYPE_CHAR && (int)value.size() > type)
+                continue;
+            char* key = Utils::getDataFromStr(value.c_str(), type);
+            if (key == NULL)
+                return -1;
+
+            // Not equal accepts keys on both sides of its value
+            if (cond->at(i) == COND_NE)
+            {
+                indexManager->findBitmap(index->getName(), NULL, true, key, false, &found);
+                indexManager->findBitmap(index->getName(), key, false, NULL, true, &found);
+            }
+            else
+            {
+                bool lower = cond->at(i) != COND_LT && cond->at(i) != COND_LE;
+                bool upper = cond->at(i) != COND_GT && cond->at(i) != COND_GE;
+                indexManager->findBitmap(
+                    index->getName(),
+                    lower ? key : NULL, cond->at(i) != COND_GT,
+                    upper ? key : NULL, cond->at(i) != COND_LT,
+                    &found
+                );
+            }
+            delete[] key;
+        }
+
+        if (useCount++ == 0)
+            *result = found;
+        else
+            result->intersect(&found);
+    }
+    return useCount;
+}
+
+// Check if conditions are valid. Return true if valid
+bool Api::checkCondition(
+    const char* tableName, const vector<string>* colName, const vector<int>* cond
+)
+{
+    CatalogManager* catalogManager = MiniSQL::getCatalogManager();
+    Table* table = catalogManager->getTable(tableName);
+    int condCount = (int)cond->size();
+
+    // Check condition validity
+    for (int i = 0; i < condCount; i++)
+        if (
+            cond->at(i) != COND_EQ &&
+            cond->at(i) != COND_NE &&
+            cond->at(i) != COND_LT &&
+            cond->at(i) != COND_GT &&
+            cond->at(i) != COND_LE &&
+            cond->at(i) != COND_GE &&
+            cond->at(i) != COND_IN
+        )
+        {
+            cerr << "ERROR: [Api::checkCondition] Unknown condition `" << cond->at(i) << "`!" << endl;
+            return false;
+        }
+
+    // Check if column name exists
+    for (int i = 0; i < condCount; i++)
+    {
+        short type = table->getType(colName->at(i).c_str());
+        if (type == TYPE_NULL)
+            return false;
+    }
+
+    return true;
+}
+
+// Check if any condition can be accelerated by index
+bool Api::hasIndexedCondition(
+    const char* tableName, const vector<string>* colName, const vector<int>* cond
+)
+{
+    for (int i = 0; i < (int)cond->size(); i++)
+        if (isIndexedCondition(tableName, colName->at(i).c_str(), cond->at(i)))
+            return true;
+    return false;
+}
+
+// Check if condition can be accelerated by index
+bool Api::isIndexedCondition(const char* tableName, const char* colName, int cond)
+{
+    // Bitmap index also answers not equal by uniting bitmaps of the other keys
+    CatalogManager* catalogManager = MiniSQL::getCatalogManager();
+    Index* index = catalogManager->getIndexByTableCol(tableName, colName);
+    return index != NULL && (cond != COND_NE || index->getType() == INDEX_BITMAP);
+}
+
+// Get column ids of index in table
+void Api::getKeyCol(Table* table, Index* index, vector<int>* cols)
+{
+    for (int i = 0; i < index->getColCount(); i++)
+        cols->push_back(table->getId(index->getColName(i)));
+}
+
+// Create file of index in catalog and load keys of current records into it
+// Progress of scanning records is reported if progress is not NULL. Return true if success
+bool Api::buildIndex(const char* indexName, ProgressCallback progress)
+{
+    CatalogManager* catalogManager = MiniSQL::getCatalogManager();
+    IndexManager* indexManager = MiniSQL::getIndexManager();
+    Index* index = catalogManager->getIndex(indexName);
+    if (index == NULL || !indexManager->createIndex(indexName))
+        return false;
+
+    // Collect keys of current records. They are sorted and loaded bottom-up
+    Table* table = catalogManager->getTable(index->getTableName());
+    vector<int> cols;
+    bool unique = false;
+    getKeyCol(table, index, &cols);
+    for (int i = 0; i < index->getKeyColCount(); i++)
+        if (table->getColUnique(cols[i]) == 1)
+            unique = true;
+
+    KeySorter* sorter = sortKeys(indexName, table, &cols, unique, progress);
+    bool res = indexManager->bulkLoad(indexName, sorter);
+    delete sorter;
+    return res;
+}
+
+// Collect keys of columns in all records of table into a sorter named after index
+// Ranges of record blocks are scanned and sorted by several threads, and merged when read
+// Progress is reported in blocks if progress is not NULL. Return sorted sorter of keys
+KeySorter* Api::sortKeys(
+    const char* indexName, Table* table,
+    const vector<int>* cols, bool unique, ProgressCallback progress
+)
+{
+    HeapFile* file = new HeapFile(("record/" + string(table->getName())).c_str());
+    int blockCount = file->getBlockCount();
+    int threadCount = max(min(MiniSQL::getIndexManager()->getThreadCount(), blockCount), 1);
+    int recordLength = table->getRecordLength();
+
+    vector<short> types;
+    for (auto col : *cols)
+        types.push_back(table->getColType(col));
+
+    // Each thread sorts keys of its own range of blocks within its share of memory
+    vector<KeySorter*> parts;
+    for (int t = 0; t < threadCount; t++)
+    {
+        string partName = "index/" + string(indexName) + (threadCount > 1 ? ".part" + to_string(t) : "");
+        parts.push_back(new KeySorter(partName.c_str(), &types, unique, KeySorter::MAX_MEMORY / threadCount));
+    }
+
+    atomic<int> doneCount(0);
+    auto work = [&](int t)
+    {
+        char* data = new char[file->getRecordBlockCount() * recordLength];
+        int* ids = new int[file->getRecordBlockCount()];
+        int lastReport = -1;
+        for (int b = blockCount * t / threadCount; b < blockCount * (t + 1) / threadCount; b++)
+        {
+            int count = file->getBlockRecords(b, data, ids);
+            for (int i = 0; i < count; i++)
+                parts[t]->add(table->getKey(data + i * recordLength, cols).data(), ids[i]);
+
+            // Only the calling thread reports, once for each percent of all blocks
+            // The last report is made after all threads finish
+            int done = ++doneCount;
+            if (t == 0 && progress != NULL && done < blockCount && done * 100 / blockCount != lastReport)
+            {
+                lastReport = done * 100 / blockCount;
+                progress(done, blockCount);
+            }
+        }
+        parts[t]->sort();
+        delete[] ids;
+        delete[] data;
+    };
+
+    // Calling thread scans the first range
+    vector<thread> threads;
+    for (int t = 1; t < threadCount; t++)
+        threads.push_back(thread(work, t));
+    work(0);
+    for (auto& th : threads)
+        th.join();
+    if (progress != NULL && blockCount > 0)
+        progress(blockCount, blockCount);
+    delete file;
+
+    if (threadCount == 1)
+        return parts[0];
+
+    // Sorted parts are merged by a k-way heap while loaded
+    KeySorter* sorter = new KeySorter(("index/" + string(indexName)).c_str(), &types, unique);
+    sorter->merge(&parts);
+    sorter->sort();
+    return sorter;
+}
@@ -4,16 +4,33 @@
 #include <string>
 #include <vector>
 
+#include "global.h"
+#include "struct/table.h"
+#include "struct/index.h"
+#include "index/bitmap.h"
+#include "index/keySorter.h"
+
 using namespace std;
 
+// Receiver of progress of a long operation, given as finished and total units of work
+typedef void (*ProgressCallback)(int done, int total);
+
 class Api
 {
 public:
 
     // Select record. Return number of records selected
+    // All columns are selected if selected column list is empty
     int select(
-        const char* tableName, const vector<string>* colName,
-        const vector<int>* cond, const vector<string>* operand
+        const char* tableName, const vector<string>* selColName,
+        const vector<string>* colName, const vector<int>* cond,
+        const vector<string>* operand
+    );
+
+    // Select aggregates of records. Return number of records aggregated
+    int aggregate(
+        const char* tableName, const vector<int>* aggFunc, const vector<string>* aggCol,
+        const vector<string>* colName, const vector<int>* cond, const vector<string>* operand
     );
 
     // Insert record. Return true if success
@@ -25,6 +42,12 @@ public:
         const vector<int>* cond, const vector<string>* operand
     );
 
+    // Update record. Return number of records updated
+    int update(
+        const char* tableName, const vector<string>* setColName, const vector<string>* setValue,
+        const vector<string>* colName, const vector<int>* cond, const vector<string>* operand
+    );
+
     // Create table. Return true if success
     bool createTable(
         const char* tableName, const char* primary,
@@ -34,20 +57,99 @@ public:
     // Drop table. Return true if success
     bool dropTable(const char* tableName);
 
-    // Create index. Return true if success
-    bool createIndex(const char* indexName, const char* tableName, const char* colName);
+    // Create index of type on columns. Included columns are stored in index after key columns
+    // Progress of scanning records is reported if progress is not NULL. Return true if success
+    bool createIndex(
+        const char* indexName, const char* tableName,
+        const vector<string>* colName, int type = INDEX_BPTREE,
+        const vector<string>* includeColName = NULL, ProgressCallback progress = NULL
+    );
 
     // Drop index. Return true if succes
     bool dropIndex(const char* indexName);
 
+    // Collect and print statistics of index, and save them for planning. Return true if success
+    bool analyzeIndex(const char* indexName);
+
+    // Vacuum table. Return true if success
+    bool vacuum(const char* tableName);
+
+    // Write modification counts of analyzed indices, headers, pending messages and bitmaps kept by open indices,
+    // and then all dirty blocks back to file
+    void checkpoint();
+
+    // Rebuild indices whose files are in an older format from records of their tables
+    void upgradeIndices();
+
+    // Set percentage of each index node filled by bulk loading. Return true if success
+    bool setFillFactor(int fillFactor);
+
+    // Set number of threads building an index. Return true if success
+    bool setThreadCount(int threadCount);
+
+    // Set megabytes of memory for in-memory mirrors of B+ tree indices. Return true if success
+    bool setCacheSize(int cacheSize);
+
 private:
 
+    // Percentage of entries of an analyzed index beyond which scanning table is cheaper than index
+    static const int SCAN_PERCENT;
+
+    // Percentage of entries taken to satisfy range conditions on a column other than the first
+    static const int RANGE_PERCENT;
+
+    // Check if conditions are valid. Return true if valid
+    bool checkCondition(
+        const char* tableName, const vector<string>* colName, const vector<int>* cond
+    );
+
+    // Check if any condition can be accelerated by index
+    bool hasIndexedCondition(
+        const char* tableName, const vector<string>* colName, const vector<int>* cond
+    );
+
+    // Check if condition can be accelerated by index
+    bool isIndexedCondition(const char* tableName, const char* colName, int cond);
+
+    // Get column ids of index in table
+    void getKeyCol(Table* table, Index* index, vector<int>* cols);
+
+    // Create file of index in catalog and load keys of current records into it
+    // Progress of scanning records is reported if progress is not NULL. Return true if success
+    bool buildIndex(const char* indexName, ProgressCallback progress);
+
+    // Collect keys of columns in all records of table into a sorter named after index
+    // Ranges of record blocks are scanned and sorted by several threads, and merged when read
+    // Progress is reported in blocks if progress is not NULL. Return sorted sorter of keys
+    KeySorter* sortKeys(
+        const char* indexName, Table* table,
+        const vector<int>* cols, bool unique, ProgressCallback progress
+    );
+
+    // Estimate number of entries of index read for equality or in conditions on prefix columns,
+    // and for range conditions on the next column if range is true. Return -1 if index is not analyzed
+    double estimateRows(
+        Table* table, Index* index, const vector<int>* prefix, bool range,
+        const vector<string>* colName, const vector<int>* cond, const vector<string>* operand
+    );
+
+    // Intersect bitmaps of conditions on columns with bitmap index into result
+    // Each condition unites bitmaps of the keys it accepts. Return number of conditions used, or -1 if an operand is invalid
+    int intersectBitmaps(
+        Table* table, const vector<Index*>* indices, const vector<string>* colName,
+        const vector<int>* cond, const vector<string>* operand, Bitmap* result
+    );
+
     // Filter records satisfying all conditions
     // Return number of records filtered
+    // Only projected columns are copied if projection is provided
+    // If projection or used columns are provided and an index holds them and all condition columns,
+    // records are rebuilt from index entries without reading record file. Other columns are left zero
     int filter(
         const char* tableName, const vector<string>* colName,
         const vector<int>* cond, const vector<string>* operand,
-        vector<char*>* record, vector<int>* ids
+        vector<char*>* record, vector<int>* ids,
+        const vector<int>* projection = NULL, const vector<int>* used = NULL
     );
 };
 
@@ -1,5 +1,9 @@
+#include <chrono>
+#include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <thread>
 #include "buffer/bufferManager.h"
 
 using namespace std;
@@ -7,6 +11,10 @@ using namespace std;
 // Max number of block
 const int BufferManager::MAX_BLOCK_COUNT = 100;
 
+// Milliseconds to wait for an unpinned block when all blocks are pinned
+// Blocks pinned for longer are taken as leaked pins, which abort the program
+const int BufferManager::PIN_WAIT_TIME = 1000;
+
 // Constructor
 BufferManager::BufferManager()
 {
@@ -32,34 +40,23 @@ BufferManager::~BufferManager()
 // Get the id-th block in file
 Block* BufferManager::getBlock(const char* filename, int id)
 {
-    string blockName = string(filename) + "`" + to_string(id);
-
-    if (nodeMap.find(blockName) != nodeMap.end())
-    {
-        // Set block as most recently used
-        BlockNode* node = nodeMap[blockName];
-        node->remove();
-        node->add(lruHead);
-        return node->block;
-    }
-
-    if (blockCnt == MAX_BLOCK_COUNT)
-    {
-        // Current block number full
-        // Find the least recently used block
-        BlockNode* node = lruTail->pre;
-        while (node->block->pin)
-            node = node->pre;
-
-        deleteNodeBlock(node);
-    }
+    unique_lock<mutex> lock(latch);
+    return fetchBlock(filename, id, &lock);
+}
 
-    return loadBlock(filename, id);
+// Get the id-th block in file and pin it. It stays in memory until unpinned
+Block* BufferManager::pinBlock(const char* filename, int id)
+{
+    unique_lock<mutex> lock(latch);
+    Block* block = fetchBlock(filename, id, &lock);
+    block->pin++;
+    return block;
 }
 
 // Remove all block with filename(used when delete file)
 void BufferManager::removeBlockByFilename(const char* filename)
 {
+    lock_guard<mutex> guard(latch);
     BlockNode* nxtNode;
     for (BlockNode* node = lruHead->nxt; node != lruTail; node = nxtNode)
     {
@@ -69,6 +66,17 @@ void BufferManager::removeBlockByFilename(const char* filename)
     }
 }
 
+// Write all dirty blocks back to file. Blocks stay in memory
+void BufferManager::flush()
+{
+    lock_guard<mutex> guard(latch);
+    for (BlockNode* node = lruHead->nxt; node != lruTail; node = node->nxt)
+    {
+        writeBlock(node->block->filename.c_str(), node->block->id);
+        node->block->dirty = false;
+    }
+}
+
 #ifdef DEBUG
 // Print block filename and id
 void BufferManager::debugPrint() const
@@ -81,11 +89,60 @@ void BufferManager::debugPrint() const
 }
 #endif
 
+// Get the id-th block in file. Latch should be held by lock
+// If all blocks are pinned, wait with latch released until one is unpinned
+// Abort if none is unpinned in PIN_WAIT_TIME
+Block* BufferManager::fetchBlock(const char* filename, int id, unique_lock<mutex>* lock)
+{
+    string blockName = string(filename) + "`" + to_string(id);
+    auto start = chrono::steady_clock::now();
+
+    while (true)
+    {
+        auto it = nodeMap.find(blockName);
+        if (it != nodeMap.end())
+        {
+            // Set block as most recently used
+            BlockNode* node = it->second;
+            node->remove();
+            node->add(lruHead);
+            return node->block;
+        }
+
+        if (blockCnt < MAX_BLOCK_COUNT)
+            return loadBlock(filename, id);
+
+        // Current block number full
+        // Find the least recently used block which is not pinned
+        BlockNode* node = lruTail->pre;
+        while (node != lruHead && node->block->pin)
+            node = node->pre;
+        if (node != lruHead)
+        {
+            deleteNodeBlock(node);
+            return loadBlock(filename, id);
+        }
+
+        // Pins are released without latch. Block may also be loaded by others meanwhile, so it is looked up again
+        // Callers cannot go on without the block, and a half-done change to an index cannot be undone
+        if (chrono::steady_clock::now() - start > chrono::milliseconds(PIN_WAIT_TIME))
+        {
+            cerr << "ERROR: [BufferManager::fetchBlock] All " << MAX_BLOCK_COUNT << " blocks stay pinned while loading block "
+                << id << " of `" << filename << "`! Aborting." << endl;
+            abort();
+        }
+        lock->unlock();
+        this_thread::yield();
+        lock->lock();
+    }
+}
+
 // Delete node and its block from memory
 void BufferManager::deleteNodeBlock(BlockNode* node, bool write)
 {
     Block* block = node->block;
-    writeBlock(block->filename.c_str(), block->id);
+    if (write)
+        writeBlock(block->filename.c_str(), block->id);
     nodeMap.erase(block->filename + "`" + to_string(block->id));
     delete node;
     delete block;
@@ -96,7 +153,9 @@ void BufferManager::deleteNodeBlock(BlockNode* node, bool write)
 Block* BufferManager::loadBlock(const char* filename, int id)
 {
     // Load block from file
+    // Blocks beyond end of file are filled with 0
     Block* block = new Block(filename, id);
+    memset(block->content, 0, BLOCK_SIZE);
     FILE* file = fopen(("data/" + string(filename) + ".mdb").c_str(), "rb");
     fseek(file, id*BLOCK_SIZE, SEEK_SET);
     fread(block->content, BLOCK_SIZE, 1, file);
@@ -1,6 +1,7 @@
 #ifndef _BUFFER_MANAGER_H
 #define _BUFFER_MANAGER_H
 
+#include <mutex>
 #include <string>
 #include <unordered_map>
 
@@ -32,6 +33,8 @@ struct BlockNode
     ~BlockNode() { remove();}
 };
 
+// Blocks are looked up and replaced under a latch, so the buffer can be shared by threads
+// A block returned unpinned may be replaced by another thread. Shared blocks should be pinned
 class BufferManager
 {
 public:
@@ -39,6 +42,10 @@ public:
     // Max number of block
     static const int MAX_BLOCK_COUNT;
 
+    // Milliseconds to wait for an unpinned block when all blocks are pinned
+    // Blocks pinned for longer are taken as leaked pins, which abort the program
+    static const int PIN_WAIT_TIME;
+
     // Constructor
     BufferManager();
 
@@ -48,9 +55,15 @@ public:
     // Get the id-th block in file
     Block* getBlock(const char* filename, int id);
 
+    // Get the id-th block in file and pin it. It stays in memory until unpinned
+    Block* pinBlock(const char* filename, int id);
+
     // Remove all block with filename(used when delete file)
     void removeBlockByFilename(const char* filename);
 
+    // Write all dirty blocks back to file. Blocks stay in memory
+    void flush();
+
 #ifdef DEBUG
     // Print block filename and id
     void debugPrint() const;
@@ -68,6 +81,14 @@ private:
     // Block node map
     unordered_map<string, BlockNode*> nodeMap;
 
+    // Latch of block list and map
+    mutex latch;
+
+    // Get the id-th block in file. Latch should be held by lock
+    // If all blocks are pinned, wait with latch released until one is unpinned
+    // Abort if none is unpinned in PIN_WAIT_TIME
+    Block* fetchBlock(const char* filename, int id, unique_lock<mutex>* lock);
+
     // Delete node and its block from memory
     void deleteNodeBlock(BlockNode* node, bool write = true);
 
@@ -8,17 +8,23 @@
 
 using namespace std;
 
+// Length of each record in statistics file
+// Summary comes first, followed by one record for each histogram bucket
+const int CatalogManager::STATS_RECORD_LENGTH = MAX_VALUE_LENGTH + 8;
+
 // Constructor
 CatalogManager::CatalogManager()
 {
     // Load catalog file
     tableNameFile = new HeapFile("catalog/tables");
     indexMetaFile = new HeapFile("catalog/indices");
+    if (indexMetaFile->getRecordLength() < MAX_NAME_LENGTH*3 + 2)
+        upgradeIndexMetaFile();
 
     // Read catalog file
     int id;
     char tableData[MAX_NAME_LENGTH*2];
-    char indexData[MAX_NAME_LENGTH*3];
+    char indexData[MAX_NAME_LENGTH*3 + 2] = {0};
     while ((id = tableNameFile->getNextRecord(tableData)) >= 0)
     {
         Table* table = new Table(tableData);
@@ -36,6 +42,8 @@ CatalogManager::CatalogManager()
 // Destructor
 CatalogManager::~CatalogManager()
 {
+    flushStats();
+
     // Clean up table and index pointers
     for (auto table : tableMap)
         delete table.second;
@@ -154,6 +162,13 @@ Index* CatalogManager::getIndex(const char* indexName) const
     return indexMap.at(indexName);
 }
 
+// Get all indices
+void CatalogManager::getAllIndices(vector<Index*>* vec)
+{
+    for (auto item : indexMap)
+        vec->push_back(item.second);
+}
+
 // Get all indices by table name
 void CatalogManager::getIndexByTable(const char* tableName, vector<Index*>* vec)
 {
@@ -165,23 +180,31 @@ void CatalogManager::getIndexByTable(const char* tableName, vector<Index*>* vec)
     }
 }
 
-// Get index by table name and column name
+// Get index by table name and its first column name
+// Index with fewest columns is preferred. Hash index is considered only on a single column
 Index* CatalogManager::getIndexByTableCol(const char* tableName, const char* colName)
 {
+    Index* ret = NULL;
     for (auto item : indexMap)
     {
         Index* index = item.second;
         if (
             strcmp(index->getTableName(), tableName) == 0 &&
-            strcmp(index->getColName(), colName) == 0
+            strcmp(index->getColName(), colName) == 0 &&
+            (index->getType() != INDEX_HASH || index->getKeyColCount() == 1) &&
+            (ret == NULL || index->getColCount() < ret->getColCount())
         )
-            return index;
+            ret = index;
     }
-    return NULL;
+    return ret;
 }
 
-// Create index. Return true if success
-bool CatalogManager::createIndex(const char* indexName, const char* tableName, const char* colName)
+// Create index of type on columns. Included columns are stored after key columns
+// Return true if success
+bool CatalogManager::createIndex(
+    const char* indexName, const char* tableName,
+    const vector<string>* colName, const vector<string>* includeColName, int type
+)
 {
     if (indexMap.find(indexName) != indexMap.end())
     {
@@ -195,29 +218,81 @@ bool CatalogManager::createIndex(const char* indexName, const char* tableName, c
         return false;
     }
 
-    // Check if colName exists, and if column is unique
+    // Check if each column exists and appears once. Index on non-unique column keeps duplicate keys
     Table* table = tableMap[tableName];
-    char isUnique = table->getUnique(colName);
-    if (isUnique == 0)
-        cerr << "ERROR: [CatalogManager::createIndex] Column `" << colName << "` is not unique!" << endl;
-    if (isUnique != 1)
+    vector<string> allColName(*colName);
+    allColName.insert(allColName.end(), includeColName->begin(), includeColName->end());
+    unordered_set<string> colNameSet;
+    int keyLength = 0;
+    for (auto name : allColName)
+    {
+        if (table->getUnique(name.c_str()) < 0)
+            return false;
+        if (colNameSet.find(name) != colNameSet.end())
+        {
+            cerr << "ERROR: [CatalogManager::createIndex] Duplicate column name `" << name << "`!" << endl;
+            return false;
+        }
+        colNameSet.insert(name);
+        keyLength += Utils::getTypeSize(table->getType(name.c_str()));
+    }
+
+    if (keyLength > MAX_KEY_LENGTH)
+    {
+        cerr << "ERROR: [CatalogManager::createIndex] Total length of columns " << keyLength << " exceeds " << MAX_KEY_LENGTH << "!" << endl;
         return false;
+    }
 
-    // Check if there is already an index with same table name and column name
-    Index* exist = getIndexByTableCol(tableName, colName);
-    if (exist != NULL)
+    // Bitmap index keeps one bitmap for each value of a single column
+    if (type == INDEX_BITMAP && (colName->size() != 1 || !includeColName->empty()))
     {
-        cerr << "ERROR: [CatalogManager::createIndex] Index with table name `" << tableName << "` and column name `" << colName << "` already exists(Index name `" << exist->getName() << "`)!" << endl;
+        cerr << "ERROR: [CatalogManager::createIndex] Bitmap index must have exactly one column and no included columns!" << endl;
         return false;
     }
 
-    // Write index data to catalog file
-    char indexData[MAX_NAME_LENGTH*3];
+    // Check if there is already an index with same table name, type and column names
+    for (auto item : indexMap)
+    {
+        Index* exist = item.second;
+        if (
+            strcmp(exist->getTableName(), tableName) != 0 ||
+            exist->getType() != type ||
+            exist->getColCount() != (int)allColName.size() ||
+            exist->getKeyColCount() != (int)colName->size()
+        )
+            continue;
+
+        int i = 0;
+        while (i < (int)allColName.size() && allColName[i] == exist->getColName(i))
+            i++;
+        if (i == (int)allColName.size())
+        {
+            cerr << "ERROR: [CatalogManager::createIndex] Index with table name `" << tableName << "` and same type and columns already exists(Index name `" << exist->getName() << "`)!" << endl;
+            return false;
+        }
+    }
+
+    // Write index data to catalog file. Record keeps the first column
+    char indexData[MAX_NAME_LENGTH*3 + 2];
     memcpy(indexData, indexName, MAX_NAME_LENGTH);
     memcpy(indexData + MAX_NAME_LENGTH, tableName, MAX_NAME_LENGTH);
-    memcpy(indexData + MAX_NAME_LENGTH*2, colName, MAX_NAME_LENGTH);
+    memcpy(indexData + MAX_NAME_LENGTH*2, colName->at(0).c_str(), MAX_NAME_LENGTH);
+    indexData[MAX_NAME_LENGTH*3] = type;
+    indexData[MAX_NAME_LENGTH*3 + 1] = includeColName->size();
     int id = indexMetaFile->addRecord(indexData);
 
+    // Create index column data file
+    HeapFile::createFile(("catalog/index_" + string(indexName)).c_str(), MAX_NAME_LENGTH);
+    HeapFile* indexDataFile = new HeapFile(("catalog/index_" + string(indexName)).c_str());
+
+    for (auto name : allColName)
+    {
+        char colData[MAX_NAME_LENGTH];
+        memcpy(colData, name.c_str(), MAX_NAME_LENGTH);
+        indexDataFile->addRecord(colData);
+    }
+    delete indexDataFile;
+
     // Record index into map
     indexIdMap[indexName] = id;
     indexMap[indexName] = new Index(indexData);
@@ -240,6 +315,11 @@ bool CatalogManager::dropIndex(const char* indexName)
     indexIdMap.erase(indexName);
     indexMap.erase(indexName);
 
+    // Delete index column data file and statistics file
+    Utils::deleteFile(("catalog/index_" + string(indexName)).c_str());
+    if (Utils::fileExists(("catalog/stats_" + string(indexName)).c_str()))
+        Utils::deleteFile(("catalog/stats_" + string(indexName)).c_str());
+
     return true;
 }
 
@@ -272,6 +352,108 @@ int CatalogManager::loadTableColInfo(
     return colCount;
 }
 
+// Load index column info. Returns column number, or 0 if index has no column file
+int CatalogManager::loadIndexColInfo(const char* indexName, vector<string>* colName)
+{
+    if (!Utils::fileExists(("catalog/index_" + string(indexName)).c_str()))
+        return 0;
+    HeapFile* colFile = new HeapFile(("catalog/index_" + string(indexName)).c_str());
+
+    int colCount = colFile->getRecordCount();
+    char colData[MAX_NAME_LENGTH];
+    for (int i = 0; i < colCount; i++)
+    {
+        colFile->getNextRecord(colData);
+        colName->push_back(colData);
+    }
+
+    delete colFile;
+    return colCount;
+}
+
+// Save statistics of index. Return true if success
+bool CatalogManager::setIndexStats(const char* indexName, const IndexStats* stats)
+{
+    Index* index = getIndex(indexName);
+    if (index == NULL)
+        return false;
+
+    // Summary holds tree figures, bound length, distinct counts of column prefixes and modification count
+    string filename = "catalog/stats_" + string(indexName);
+    if (Utils::fileExists(filename.c_str()))
+        Utils::deleteFile(filename.c_str());
+    HeapFile::createFile(filename.c_str(), STATS_RECORD_LENGTH);
+    HeapFile* statsFile = new HeapFile(filename.c_str());
+
+    char data[STATS_RECORD_LENGTH] = {0};
+    int* summary = reinterpret_cast<int*>(data);
+    summary[0] = stats->height;
+    summary[1] = stats->nodeCount;
+    summary[2] = stats->leafCount;
+    summary[3] = stats->leafFill;
+    summary[4] = stats->entryCount;
+    summary[5] = stats->bound.empty() ? 0 : stats->bound[0].size();
+    summary[6] = stats->distinct.size();
+    for (int i = 0; i < (int)stats->distinct.size(); i++)
+        summary[7 + i] = stats->distinct[i];
+    summary[7 + stats->distinct.size()] = stats->modifiedCount;
+    statsFile->addRecord(data);
+
+    // Each bucket holds number of entries and distinct values, followed by its bound
+    for (int i = 0; i < (int)stats->bound.size(); i++)
+    {
+        memset(data, 0, STATS_RECORD_LENGTH);
+        memcpy(data, &stats->bucketCount[i], 4);
+        memcpy(data + 4, &stats->bucketDistinct[i], 4);
+        memcpy(data + 8, stats->bound[i].data(), stats->bound[i].size());
+        statsFile->addRecord(data);
+    }
+    delete statsFile;
+
+    index->setStats(stats);
+    return true;
+}
+
+// Load statistics of index. Return false if index is not analyzed
+bool CatalogManager::loadIndexStats(const char* indexName, IndexStats* stats)
+{
+    if (!Utils::fileExists(("catalog/stats_" + string(indexName)).c_str()))
+        return false;
+    HeapFile* statsFile = new HeapFile(("catalog/stats_" + string(indexName)).c_str());
+
+    char data[STATS_RECORD_LENGTH];
+    statsFile->getNextRecord(data);
+    const int* summary = reinterpret_cast<const int*>(data);
+    stats->height = summary[0];
+    stats->nodeCount = summary[1];
+    stats->leafCount = summary[2];
+    stats->leafFill = summary[3];
+    stats->entryCount = summary[4];
+    int boundLength = summary[5];
+    stats->distinct.assign(summary + 7, summary + 7 + summary[6]);
+    stats->modifiedCount = summary[7 + summary[6]];
+
+    stats->bound.clear();
+    stats->bucketCount.clear();
+    stats->bucketDistinct.clear();
+    while (statsFile->getNextRecord(data) >= 0)
+    {
+        stats->bucketCount.push_back(*(reinterpret_cast<int*>(data)));
+        stats->bucketDistinct.push_back(*(reinterpret_cast<int*>(data + 4)));
+        stats->bound.push_back(string(data + 8, boundLength));
+    }
+
+    delete statsFile;
+    return true;
+}
+
+// Write modification counts of analyzed indices back to their statistics files
+void CatalogManager::flushStats()
+{
+    for (auto index : indexMap)
+        index.second->flushStats();
+}
+
 #ifdef DEBUG
 // Print all tables and indices info
 void CatalogManager::debugPrint() const
@@ -284,3 +466,28 @@ void CatalogManager::debugPrint() const
     cerr << "DEBUG: [CatalogManager::debugPrint] debugPrint end" << endl;
 }
 #endif
+
+// Rewrite index meta data file whose records are shorter than index type and included column count need
+// Indices of such file are B+ trees without included columns
+void CatalogManager::upgradeIndexMetaFile()
+{
+    int oldLength = indexMetaFile->getRecordLength();
+    vector<string> records;
+    char* data = new char[oldLength];
+    while (indexMetaFile->getNextRecord(data) >= 0)
+        records.push_back(string(data, oldLength));
+    delete[] data;
+    delete indexMetaFile;
+
+    // Missing bytes are 0, which is INDEX_BPTREE and no included column
+    Utils::deleteFile("catalog/indices");
+    HeapFile::createFile("catalog/indices", MAX_NAME_LENGTH*3 + 2);
+    indexMetaFile = new HeapFile("catalog/indices");
+    for (auto& record : records)
+    {
+        char indexData[MAX_NAME_LENGTH*3 + 2] = {0};
+        memcpy(indexData, record.data(), record.size());
+        indexMetaFile->addRecord(indexData);
+    }
+    indexMetaFile->moveTo(HeapFile::FILE_BEGIN);
+}
@@ -36,14 +36,22 @@ public:
     // Get index by name
     Index* getIndex(const char* indexName) const;
 
+    // Get all indices
+    void getAllIndices(vector<Index*>* vec);
+
     // Get all indices by table name
     void getIndexByTable(const char* tableName, vector<Index*>* vec);
 
-    // Get index by table name and column name
+    // Get index by table name and its first column name
+    // Index with fewest columns is preferred. Hash index is considered only on a single column
     Index* getIndexByTableCol(const char* tableName, const char* colName);
 
-    // Create index. Return true if success
-    bool createIndex(const char* indexName, const char* tableName, const char* colName);
+    // Create index of type on columns. Included columns are stored after key columns
+    // Return true if success
+    bool createIndex(
+        const char* indexName, const char* tableName,
+        const vector<string>* colName, const vector<string>* includeColName, int type
+    );
 
     // Drop index. Return true if success
     bool dropIndex(const char* indexName);
@@ -54,6 +62,18 @@ public:
         vector<short>* colType, vector<char>* colUnique
     );
 
+    // Load index column info. Returns column number, or 0 if index has no column file
+    int loadIndexColInfo(const char* indexName, vector<string>* colName);
+
+    // Save statistics of index. Return true if success
+    bool setIndexStats(const char* indexName, const IndexStats* stats);
+
+    // Load statistics of index. Return false if index is not analyzed
+    bool loadIndexStats(const char* indexName, IndexStats* stats);
+
+    // Write modification counts of analyzed indices back to their statistics files
+    void flushStats();
+
 #ifdef DEBUG
     // Print all tables and indices info
     void debugPrint() const;
@@ -61,6 +81,10 @@ public:
 
 private:
 
+    // Length of each record in statistics file
+    // Summary comes first, followed by one record for each histogram bucket
+    static const int STATS_RECORD_LENGTH;
+
     // Table map
     unordered_map<string, Table*> tableMap;
     unordered_map<string, int> tableIdMap;
@@ -74,6 +98,10 @@ private:
 
     // Index meta data file
     HeapFile* indexMetaFile;
+
+    // Rewrite index meta data file whose records are shorter than index type and included column count need
+    // Indices of such file are B+ trees without included columns
+    void upgradeIndexMetaFile();
 };
 
 #endif
@@ -0,0 +1,130 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "buffer/bufferManager.h"
+#include "minisql.h"
+#include "file/bloomFilter.h"
+
+using namespace std;
+
+// Number of counters for each key
+const int BloomFilter::COUNTER_PER_KEY = 10;
+
+// Number of counters set by each key
+const int BloomFilter::HASH_COUNT = 7;
+
+// Number of counters in a block. Each counter takes 4 bits
+const int BloomFilter::COUNTER_BLOCK_COUNT = BLOCK_SIZE * 2;
+
+// Create bloom filter file
+void BloomFilter::createFile(const char* _filename, int _filterCount, int _keyCapacity)
+{
+    int blockCount = (_keyCapacity * COUNTER_PER_KEY + COUNTER_BLOCK_COUNT - 1) / COUNTER_BLOCK_COUNT;
+    if (blockCount < 1)
+        blockCount = 1;
+
+    // Write header and all-zero counters
+    FILE* file = fopen(("data/" + string(_filename) + ".mdb").c_str(), "wb");
+    char data[BLOCK_SIZE] = {0};
+    int header[] = {_filterCount, blockCount};
+    memcpy(data, header, sizeof(header));
+    fwrite(data, BLOCK_SIZE, 1, file);
+    memset(data, 0, BLOCK_SIZE);
+    for (int i = 0; i < _filterCount * blockCount; i++)
+        fwrite(data, BLOCK_SIZE, 1, file);
+    fclose(file);
+}
+
+// Constructor
+BloomFilter::BloomFilter(const char* _filename): filename(_filename)
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* header = manager->getBlock(_filename, 0);
+
+    filterCount = *(reinterpret_cast<int*>(header->content));
+    filterBlockCount = *(reinterpret_cast<int*>(header->content + 4));
+}
+
+// Get number of keys the filters are sized for
+int BloomFilter::getKeyCapacity() const
+{
+    return filterBlockCount * COUNTER_BLOCK_COUNT / COUNTER_PER_KEY;
+}
+
+// Add key into the id-th filter
+void BloomFilter::add(int id, const char* key, int length)
+{
+    int pos[HASH_COUNT];
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* block = manager->getBlock(filename.c_str(), hash(id, key, length, pos));
+
+    for (int i = 0; i < HASH_COUNT; i++)
+    {
+        unsigned char* byte = reinterpret_cast<unsigned char*>(block->content + pos[i] / 2);
+        int shift = pos[i] % 2 * 4;
+        // Saturated counter stays saturated
+        if ((*byte >> shift & 15) < 15)
+            *byte += 1 << shift;
+    }
+    block->dirty = true;
+}
+
+// Remove key from the id-th filter
+void BloomFilter::remove(int id, const char* key, int length)
+{
+    int pos[HASH_COUNT];
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* block = manager->getBlock(filename.c_str(), hash(id, key, length, pos));
+
+    for (int i = 0; i < HASH_COUNT; i++)
+    {
+        unsigned char* byte = reinterpret_cast<unsigned char*>(block->content + pos[i] / 2);
+        int shift = pos[i] % 2 * 4;
+        int counter = *byte >> shift & 15;
+        if (counter > 0 && counter < 15)
+            *byte -= 1 << shift;
+    }
+    block->dirty = true;
+}
+
+// Check if key may exist in the id-th filter
+bool BloomFilter::mayContain(int id, const char* key, int length)
+{
+    int pos[HASH_COUNT];
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* block = manager->getBlock(filename.c_str(), hash(id, key, length, pos));
+
+    for (int i = 0; i < HASH_COUNT; i++)
+    {
+        unsigned char byte = block->content[pos[i] / 2];
+        if ((byte >> (pos[i] % 2 * 4) & 15) == 0)
+            return false;
+    }
+    return true;
+}
+
+// Hash key. Return block id and set counter positions
+int BloomFilter::hash(int id, const char* key, int length, int* pos)
+{
+    // FNV-1a followed by a 64-bit finalizer
+    unsigned long long h = 14695981039346656037ULL;
+    for (int i = 0; i < length; i++)
+    {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    // Double hashing inside the chosen block
+    unsigned int a = (unsigned int)(h >> 32);
+    unsigned int b = (unsigned int)h | 1;
+    for (int i = 0; i < HASH_COUNT; i++)
+        pos[i] = (a + i * b) % COUNTER_BLOCK_COUNT;
+
+    return 1 + id * filterBlockCount + (int)(h % filterBlockCount);
+}
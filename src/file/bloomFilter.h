@@ -0,0 +1,58 @@
+#ifndef _BLOOM_FILTER_H
+#define _BLOOM_FILTER_H
+
+#include <string>
+
+#include "global.h"
+
+using namespace std;
+
+// Counting bloom filters of a table, one for each unique column
+// All counters of a key lie in one block, so each probe loads one block
+class BloomFilter
+{
+public:
+
+    // Number of counters for each key
+    static const int COUNTER_PER_KEY;
+
+    // Number of counters set by each key
+    static const int HASH_COUNT;
+
+    // Create bloom filter file
+    static void createFile(const char* _filename, int _filterCount, int _keyCapacity);
+
+    // Constructor
+    BloomFilter(const char* _filename);
+
+    // Get number of keys the filters are sized for
+    int getKeyCapacity() const;
+
+    // Add key into the id-th filter
+    void add(int id, const char* key, int length);
+
+    // Remove key from the id-th filter
+    void remove(int id, const char* key, int length);
+
+    // Check if key may exist in the id-th filter
+    bool mayContain(int id, const char* key, int length);
+
+private:
+
+    // Number of counters in a block
+    static const int COUNTER_BLOCK_COUNT;
+
+    // Filename
+    string filename;
+
+    // Number of filters
+    int filterCount;
+
+    // Number of blocks of each filter
+    int filterBlockCount;
+
+    // Hash key. Return block id and set counter positions
+    int hash(int id, const char* key, int length, int* pos);
+};
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
@@ -11,6 +12,9 @@ using namespace std;
 // File begin indicator
 const int HeapFile::FILE_BEGIN = -1;
 
+// Version of file header. Files of version 0 have no live record count
+const int HeapFile::FORMAT_VERSION = 1;
+
 // Create heap file
 void HeapFile::createFile(const char* _filename, int _recordLength)
 {
@@ -24,6 +28,10 @@ void HeapFile::createFile(const char* _filename, int _recordLength)
     memset(data + 4, 0, 4);
     // Set first empty record to -1
     memset(data + 8, 0xFF, 4);
+    // Set live record count to 0
+    memset(data + 12, 0, 4);
+    // Set header version
+    memcpy(data + 16, &FORMAT_VERSION, 4);
     fwrite(data, BLOCK_SIZE, 1, file);
     fclose(file);
 }
@@ -38,10 +46,26 @@ HeapFile::HeapFile(const char* _filename): filename(_filename)
     recordLength = *(reinterpret_cast<int*>(block->content));
     recordCount = *(reinterpret_cast<int*>(block->content + 4));
     firstEmpty = *(reinterpret_cast<int*>(block->content + 8));
+    liveCount = *(reinterpret_cast<int*>(block->content + 12));
+    int version = *(reinterpret_cast<int*>(block->content + 16));
 
     // Calculate extra information
     recordBlockCount = BLOCK_SIZE / recordLength;
     ptr = -1;
+
+    // File of an older version is counted by scanning once, and its header is upgraded
+    if (version != FORMAT_VERSION)
+    {
+        liveCount = countLiveRecords();
+        updateHeader();
+        ptr = -1;
+    }
+}
+
+// Get length of a record, without validity byte
+int HeapFile::getRecordLength() const
+{
+    return recordLength - 1;
 }
 
 // Get record number
@@ -50,8 +74,51 @@ int HeapFile::getRecordCount() const
     return recordCount;
 }
 
+// Get number of valid(not deleted) records
+int HeapFile::getLiveCount() const
+{
+    return liveCount;
+}
+
+// Get number of records in a block
+int HeapFile::getRecordBlockCount() const
+{
+    return recordBlockCount;
+}
+
+// Get number of data blocks
+int HeapFile::getBlockCount() const
+{
+    return (recordCount + recordBlockCount - 1) / recordBlockCount;
+}
+
+// Copy valid records of the id-th data block into data one after another, and their ids into ids
+// Block is pinned while copied, so several threads may read one file at once
+// Return number of records copied
+int HeapFile::getBlockRecords(int id, char* data, int* ids) const
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* dataBlock = manager->pinBlock(filename.c_str(), id + 1);
+
+    int copyCount = 0;
+    int first = id * recordBlockCount;
+    int last = min(first + recordBlockCount, recordCount);
+    for (int i = first; i < last; i++)
+    {
+        const char* record = dataBlock->content + (i - first) * recordLength;
+        if (record[recordLength - 1])
+            continue;
+        memcpy(data + copyCount * (recordLength - 1), record, recordLength - 1);
+        ids[copyCount++] = i;
+    }
+
+    dataBlock->pin--;
+    return copyCount;
+}
+
 // Read next record. Return id of the record
-int HeapFile::getNextRecord(char* data)
+// Blocks marked 0 in block mask are skipped without being loaded
+int HeapFile::getNextRecord(char* data, const vector<char>* blockMask)
 {
     bool invalid = true;
 
@@ -65,6 +132,14 @@ int HeapFile::getNextRecord(char* data)
             return -1;
         }
 
+        int blockId = (ptr + 1) / recordBlockCount;
+        if (blockMask != NULL && blockId < (int)blockMask->size() && !(*blockMask)[blockId])
+        {
+            // Skip whole block
+            ptr = (blockId + 1) * recordBlockCount - 1;
+            continue;
+        }
+
         loadRecord(ptr + 1);
         invalid = *(reinterpret_cast<char*>(block->content + bias + recordLength - 1));
     }
@@ -99,6 +174,7 @@ int HeapFile::addRecord(const char* data)
     else
         // Update total number of records
         recordCount++;
+    liveCount++;
 
     // Update data
     memcpy(block->content + bias, data, recordLength-1);
@@ -109,6 +185,30 @@ int HeapFile::addRecord(const char* data)
     return ptr;
 }
 
+// Overwrite the id-th record in place. Return true if success
+bool HeapFile::updateRecord(int id, const char* data)
+{
+    if (id >= recordCount)
+    {
+        cerr << "ERROR: [HeapFile::updateRecord] Index out of range!" << endl;
+        return false;
+    }
+
+    // Check record validity
+    loadRecord(id);
+    bool invalid = *(reinterpret_cast<char*>(block->content + bias + recordLength - 1));
+    if (invalid)
+    {
+        cerr << "ERROR: [HeapFile::updateRecord] Record already deleted!" << endl;
+        return false;
+    }
+
+    // Update data
+    memcpy(block->content + bias, data, recordLength-1);
+    block->dirty = true;
+    return true;
+}
+
 // Delete the id-th record. Return true if success
 bool HeapFile::deleteRecord(int id)
 {
@@ -133,6 +233,7 @@ bool HeapFile::deleteRecord(int id)
     block->dirty = true;
 
     firstEmpty = ptr;
+    liveCount--;
     updateHeader();
     return true;
 }
@@ -150,9 +251,24 @@ void HeapFile::updateHeader()
     Block* header = manager->getBlock(filename.c_str(), 0);
     memcpy(header->content + 4, &recordCount, 4);
     memcpy(header->content + 8, &firstEmpty, 4);
+    memcpy(header->content + 12, &liveCount, 4);
+    memcpy(header->content + 16, &FORMAT_VERSION, 4);
     header->dirty = true;
 }
 
+// Count valid(not deleted) records by scanning all records
+int HeapFile::countLiveRecords()
+{
+    int count = 0;
+    for (int i = 0; i < recordCount; i++)
+    {
+        loadRecord(i);
+        if (!*(reinterpret_cast<char*>(block->content + bias + recordLength - 1)))
+            count++;
+    }
+    return count;
+}
+
 // Load id-th record to block
 void HeapFile::loadRecord(int id)
 {
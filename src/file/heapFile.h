@@ -2,6 +2,7 @@
 #define _HEAP_FILE_H
 
 #include <string>
+#include <vector>
 #include "global.h"
 
 using namespace std;
@@ -13,17 +14,38 @@ public:
     // File beginning indicator
     static const int FILE_BEGIN;
 
+    // Version of file header. Files of version 0 have no live record count
+    static const int FORMAT_VERSION;
+
     // Create heap file
     static void createFile(const char* _filename, int _recordLength);
 
     // Constructor
     HeapFile(const char* _filename);
 
+    // Get length of a record, without validity byte
+    int getRecordLength() const;
+
     // Get record number
     int getRecordCount() const;
 
+    // Get number of valid(not deleted) records
+    int getLiveCount() const;
+
+    // Get number of records in a block
+    int getRecordBlockCount() const;
+
+    // Get number of data blocks
+    int getBlockCount() const;
+
+    // Copy valid records of the id-th data block into data one after another, and their ids into ids
+    // Block is pinned while copied, so several threads may read one file at once
+    // Return number of records copied
+    int getBlockRecords(int id, char* data, int* ids) const;
+
     // Read next record. Return id of the record
-    int getNextRecord(char* data);
+    // Blocks marked 0 in block mask are skipped without being loaded
+    int getNextRecord(char* data, const vector<char>* blockMask = NULL);
 
     // Read id-th record
     const char* getRecordById(int id);
@@ -31,6 +53,9 @@ public:
     // Add record into file. Return id of the record
     int addRecord(const char* data);
 
+    // Overwrite the id-th record in place. Return true if success
+    bool updateRecord(int id, const char* data);
+
     // Delete the id-th record. Return true if success
     bool deleteRecord(int id);
 
@@ -51,6 +76,9 @@ private:
     // First empty record
     int firstEmpty;
 
+    // Number of valid(not deleted) records
+    int liveCount;
+
     // Number of records in a block
     int recordBlockCount;
 
@@ -66,6 +94,9 @@ private:
     // Update file header
     void updateHeader();
 
+    // Count valid(not deleted) records by scanning all records
+    int countLiveRecords();
+
     // Load id-th record to block
     void loadRecord(int id);
 };
@@ -0,0 +1,190 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "buffer/bufferManager.h"
+#include "utils/utils.h"
+#include "minisql.h"
+#include "file/zoneMap.h"
+
+using namespace std;
+
+// Max bytes of char value kept in summary
+const int ZoneMap::CHAR_PREFIX_LENGTH = 16;
+
+// Create zone map file
+void ZoneMap::createFile(const char* _filename)
+{
+    FILE* file = fopen(("data/" + string(_filename) + ".mdb").c_str(), "wb");
+    char data[BLOCK_SIZE] = {0};
+    fwrite(data, BLOCK_SIZE, 1, file);
+    fclose(file);
+}
+
+// Constructor
+ZoneMap::ZoneMap(const char* _filename, Table* _table): filename(_filename), table(_table)
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* header = manager->getBlock(_filename, 0);
+    blockCount = *(reinterpret_cast<int*>(header->content));
+
+    // Summary begins with a byte indicating if block has ever held a record
+    // Then min and max value of each column follows
+    entryLength = 1;
+    for (int i = 0; i < table->getColCount(); i++)
+    {
+        short type = table->getColType(i);
+        int length = Utils::getTypeSize(type);
+        if (type <= TYPE_CHAR && length > CHAR_PREFIX_LENGTH)
+            length = CHAR_PREFIX_LENGTH;
+
+        valueLength.push_back(length);
+        valueStart.push_back(entryLength);
+        entryLength += length * 2;
+    }
+    entryBlockCount = BLOCK_SIZE / entryLength;
+}
+
+// Widen summary of the id-th block of record file by record
+void ZoneMap::add(int id, const char* record)
+{
+    if (id >= blockCount)
+    {
+        // Initialize summaries of new blocks
+        for (; blockCount <= id; blockCount++)
+            getEntry(blockCount, true)[0] = 0;
+        updateHeader();
+    }
+
+    char* entry = getEntry(id, true);
+    for (int i = 0; i < (int)valueLength.size(); i++)
+    {
+        short type = table->getColType(i);
+        const char* value = record + table->getColStart(i);
+        char* minValue = entry + valueStart[i];
+        char* maxValue = minValue + valueLength[i];
+
+        if (entry[0] == 0 || compare(type, value, minValue, valueLength[i]) < 0)
+            memcpy(minValue, value, valueLength[i]);
+        if (entry[0] == 0 || compare(type, value, maxValue, valueLength[i]) > 0)
+            memcpy(maxValue, value, valueLength[i]);
+    }
+    entry[0] = 1;
+}
+
+// Mark blocks which may contain records satisfying predicate
+void ZoneMap::prune(const Predicate* pred, vector<char>* blockMask)
+{
+    blockMask->assign(blockCount, 1);
+
+    for (int id = 0; id < blockCount; id++)
+    {
+        const char* entry = getEntry(id);
+        if (entry[0] == 0)
+        {
+            // Block has never held a record
+            (*blockMask)[id] = 0;
+            continue;
+        }
+
+        for (int i = 0; i < pred->getCount(); i++)
+        {
+            int col = pred->getColId(i);
+            short type = pred->getType(i);
+            const char* minValue = entry + valueStart[col];
+            const char* maxValue = minValue + valueLength[col];
+
+            // Condition in skips block only if every value is out of range
+            bool skip = true;
+            for (int j = 0; j < pred->getOperandCount(i) && skip; j++)
+                skip = skipBlock(type, pred->getCond(i), pred->getOperand(i, j), minValue, maxValue, valueLength[col]);
+
+            if (skip)
+            {
+                (*blockMask)[id] = 0;
+                break;
+            }
+        }
+    }
+}
+
+// Check if block with summary values cannot satisfy condition
+bool ZoneMap::skipBlock(
+    short type, int op, const char* operand,
+    const char* minValue, const char* maxValue, int length
+) const
+{
+    int minCmp = compare(type, minValue, operand, length);
+    int maxCmp = compare(type, maxValue, operand, length);
+
+    if (op == COND_IN)
+        op = COND_EQ;
+
+    bool skip;
+    if (type <= TYPE_CHAR)
+    {
+        // Only prefix of char value is summarized. Bounds are not strict
+        if (op == COND_EQ)
+            skip = minCmp > 0 || maxCmp < 0;
+        else if (op == COND_LT || op == COND_LE)
+            skip = minCmp > 0;
+        else if (op == COND_GT || op == COND_GE)
+            skip = maxCmp < 0;
+        else
+            skip = false;
+    }
+    else
+    {
+        if (op == COND_EQ)
+            skip = minCmp > 0 || maxCmp < 0;
+        else if (op == COND_LT)
+            skip = minCmp >= 0;
+        else if (op == COND_LE)
+            skip = minCmp > 0;
+        else if (op == COND_GT)
+            skip = maxCmp <= 0;
+        else if (op == COND_GE)
+            skip = maxCmp < 0;
+        else
+            skip = false;
+    }
+    return skip;
+}
+
+// Get summary of the id-th block of record file
+char* ZoneMap::getEntry(int id, bool write)
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* block = manager->getBlock(filename.c_str(), id / entryBlockCount + 1);
+    if (write)
+        block->dirty = true;
+    return block->content + id % entryBlockCount * entryLength;
+}
+
+// Compare column value with summary value
+int ZoneMap::compare(short type, const char* a, const char* b, int length) const
+{
+    if (type <= TYPE_CHAR)
+        return strncmp(a, b, length);
+    else if (type == TYPE_INT)
+    {
+        int x = *(reinterpret_cast<const int*>(a));
+        int y = *(reinterpret_cast<const int*>(b));
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    else
+    {
+        float x = *(reinterpret_cast<const float*>(a));
+        float y = *(reinterpret_cast<const float*>(b));
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+}
+
+// Update file header
+void ZoneMap::updateHeader()
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* header = manager->getBlock(filename.c_str(), 0);
+    memcpy(header->content, &blockCount, 4);
+    header->dirty = true;
+}
@@ -0,0 +1,72 @@
+#ifndef _ZONE_MAP_H
+#define _ZONE_MAP_H
+
+#include <vector>
+#include <string>
+
+#include "global.h"
+#include "struct/table.h"
+#include "struct/predicate.h"
+
+using namespace std;
+
+// Min/max summary of each column for every block of a record file
+class ZoneMap
+{
+public:
+
+    // Max bytes of char value kept in summary
+    static const int CHAR_PREFIX_LENGTH;
+
+    // Create zone map file
+    static void createFile(const char* _filename);
+
+    // Constructor
+    ZoneMap(const char* _filename, Table* _table);
+
+    // Widen summary of the id-th block of record file by record
+    void add(int id, const char* record);
+
+    // Mark blocks which may contain records satisfying predicate
+    void prune(const Predicate* pred, vector<char>* blockMask);
+
+private:
+
+    // Filename
+    string filename;
+
+    // Table of record file
+    Table* table;
+
+    // Number of summarized blocks of record file
+    int blockCount;
+
+    // Length of summary of a block
+    int entryLength;
+
+    // Number of summaries in a block
+    int entryBlockCount;
+
+    // Length of min/max value of each column
+    vector<int> valueLength;
+
+    // Starting position of min value of each column in summary
+    vector<int> valueStart;
+
+    // Get summary of the id-th block of record file
+    char* getEntry(int id, bool write = false);
+
+    // Compare column value with summary value
+    int compare(short type, const char* a, const char* b, int length) const;
+
+    // Check if block with summary values cannot satisfy condition
+    bool skipBlock(
+        short type, int op, const char* operand,
+        const char* minValue, const char* maxValue, int length
+    ) const;
+
+    // Update file header
+    void updateHeader();
+};
+
+#endif
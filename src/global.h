@@ -1,6 +1,7 @@
 #ifndef _GLOBAL_H
 #define _GLOBAL_H
 
+#include <atomic>
 #include <string>
 
 using namespace std;
@@ -16,6 +17,15 @@ using namespace std;
 // Max length of table/index/column name
 #define MAX_NAME_LENGTH 31
 
+// Max total length of columns in an index
+#define MAX_KEY_LENGTH 512
+
+// Index types
+#define INDEX_BPTREE 0
+#define INDEX_HASH 1
+#define INDEX_BUFFERED 2
+#define INDEX_BITMAP 3
+
 // Data types
 #define TYPE_NULL 0
 #define TYPE_CHAR 255
@@ -29,6 +39,17 @@ using namespace std;
 #define COND_GT 3
 #define COND_LE 4
 #define COND_GE 5
+#define COND_IN 6
+
+// Values in operand of COND_IN are separated by this character
+#define LIST_SEPARATOR '\0'
+
+// Aggregate functions
+#define AGG_COUNT 0
+#define AGG_SUM 1
+#define AGG_MIN 2
+#define AGG_MAX 3
+#define AGG_AVG 4
 
 // A data block
 struct Block
@@ -37,7 +58,13 @@ struct Block
     int id;
 
     bool dirty;
-    bool pin;
+
+    // Number of users holding the block in memory
+    atomic<int> pin;
+
+    // Version latch of the content. It is odd while a writer holds the block
+    // Optimistic readers remember the version and check it again after reading
+    atomic<unsigned int> version;
 
     char content[BLOCK_SIZE];
 
@@ -45,7 +72,8 @@ struct Block
     Block(const char* _filename, int _id): filename(_filename), id(_id)
     {
         dirty = false;
-        pin = false;
+        pin = 0;
+        version = 0;
     }
 };
 
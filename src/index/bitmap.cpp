@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "index/bitmap.h"
+
+using namespace std;
+
+// Max number of ids kept in an array container
+// Beyond it an array takes more bytes than a bitset
+const int Bitmap::MAX_ARRAY_SIZE = 4096;
+
+// Number of words in a bitset container
+const int Bitmap::WORD_COUNT = 1024;
+
+// Add id. Return false if id is already in bitmap
+bool Bitmap::add(int id)
+{
+    int key = id >> 16, low = id & 0xffff;
+    int pos = findContainer(key);
+    if (pos == (int)containers.size() || containers[pos].key != key)
+    {
+        Container container;
+        container.key = key;
+        container.count = 0;
+        containers.insert(containers.begin() + pos, container);
+    }
+
+    Container* container = &containers[pos];
+    if (!container->words.empty())
+    {
+        unsigned long long bit = 1ULL << (low & 63);
+        if (container->words[low >> 6] & bit)
+            return false;
+        container->words[low >> 6] |= bit;
+    }
+    else
+    {
+        // Ids usually come in ascending order, so appending is tried first
+        vector<unsigned short>& lows = container->lows;
+        if (lows.empty() || lows.back() < low)
+            lows.push_back(low);
+        else
+        {
+            vector<unsigned short>::iterator it = lower_bound(lows.begin(), lows.end(), low);
+            if (*it == low)
+                return false;
+            lows.insert(it, low);
+        }
+    }
+    container->count++;
+    normalize(container);
+    return true;
+}
+
+// Remove id. Return false if id is not in bitmap
+bool Bitmap::remove(int id)
+{
+    int key = id >> 16, low = id & 0xffff;
+    int pos = findContainer(key);
+    if (pos == (int)containers.size() || containers[pos].key != key)
+        return false;
+
+    Container* container = &containers[pos];
+    if (!container->words.empty())
+    {
+        unsigned long long bit = 1ULL << (low & 63);
+        if (!(container->words[low >> 6] & bit))
+            return false;
+        container->words[low >> 6] &= ~bit;
+    }
+    else
+    {
+        vector<unsigned short>& lows = container->lows;
+        vector<unsigned short>::iterator it = lower_bound(lows.begin(), lows.end(), low);
+        if (it == lows.end() || *it != low)
+            return false;
+        lows.erase(it);
+    }
+    container->count--;
+    if (container->count == 0)
+        containers.erase(containers.begin() + pos);
+    else
+        normalize(container);
+    return true;
+}
+
+// If id is in bitmap
+bool Bitmap::contains(int id) const
+{
+    int key = id >> 16;
+    int pos = findContainer(key);
+    return pos < (int)containers.size() && containers[pos].key == key && contains(&containers[pos], id & 0xffff);
+}
+
+// Get number of ids
+int Bitmap::getCount() const
+{
+    int count = 0;
+    for (int i = 0; i < (int)containers.size(); i++)
+        count += containers[i].count;
+    return count;
+}
+
+// If bitmap holds no id
+bool Bitmap::isEmpty() const
+{
+    return containers.empty();
+}
+
+// Keep only ids also in other bitmap
+void Bitmap::intersect(const Bitmap* other)
+{
+    // Containers are matched by key like a merge join, and emptied ones are dropped
+    vector<Container> result;
+    int i = 0, j = 0;
+    while (i < (int)containers.size() && j < (int)other->containers.size())
+    {
+        if (containers[i].key < other->containers[j].key)
+            i++;
+        else if (containers[i].key > other->containers[j].key)
+            j++;
+        else
+        {
+            intersect(&containers[i], &other->containers[j]);
+            if (containers[i].count > 0)
+            {
+                result.push_back(Container());
+                swap(result.back(), containers[i]);
+            }
+            i++;
+            j++;
+        }
+    }
+    containers.swap(result);
+}
+
+// Add all ids of other bitmap
+void Bitmap::unite(const Bitmap* other)
+{
+    vector<Container> result;
+    int i = 0, j = 0;
+    while (i < (int)containers.size() || j < (int)other->containers.size())
+    {
+        if (j == (int)other->containers.size() || (i < (int)containers.size() && containers[i].key < other->containers[j].key))
+        {
+            result.push_back(Container());
+            swap(result.back(), containers[i++]);
+        }
+        else if (i == (int)containers.size() || containers[i].key > other->containers[j].key)
+            result.push_back(other->containers[j++]);
+        else
+        {
+            unite(&containers[i], &other->containers[j++]);
+            result.push_back(Container());
+            swap(result.back(), containers[i++]);
+        }
+    }
+    containers.swap(result);
+}
+
+// Append all ids in ascending order
+void Bitmap::getIds(vector<int>* ids) const
+{
+    for (int i = 0; i < (int)containers.size(); i++)
+    {
+        const Container* container = &containers[i];
+        int base = container->key << 16;
+        if (container->words.empty())
+        {
+            for (int j = 0; j < container->count; j++)
+                ids->push_back(base | container->lows[j]);
+            continue;
+        }
+        for (int w = 0; w < WORD_COUNT; w++)
+            for (unsigned long long word = container->words[w]; word != 0; word &= word - 1)
+            {
+                // Lowest set bit is isolated and counted by the bits below it
+                unsigned long long bit = word & (~word + 1);
+                ids->push_back(base | w << 6 | (int)bitset<64>(bit - 1).count());
+            }
+    }
+}
+
+// Append serialized bitmap to data
+void Bitmap::save(string* data) const
+{
+    int containerCount = containers.size();
+    data->append(reinterpret_cast<const char*>(&containerCount), 4);
+    for (int i = 0; i < containerCount; i++)
+    {
+        const Container* container = &containers[i];
+        data->append(reinterpret_cast<const char*>(&container->key), 4);
+        data->append(reinterpret_cast<const char*>(&container->count), 4);
+        if (container->words.empty())
+            data->append(reinterpret_cast<const char*>(container->lows.data()), container->count * 2);
+        else
+            data->append(reinterpret_cast<const char*>(container->words.data()), WORD_COUNT * 8);
+    }
+}
+
+// Replace bitmap with one serialized at data. Return number of bytes read
+int Bitmap::load(const char* data)
+{
+    const char* cur = data;
+    int containerCount;
+    memcpy(&containerCount, cur, 4);
+    cur += 4;
+    containers.assign(containerCount, Container());
+    for (int i = 0; i < containerCount; i++)
+    {
+        Container* container = &containers[i];
+        memcpy(&container->key, cur, 4);
+        memcpy(&container->count, cur + 4, 4);
+        cur += 8;
+        if (container->count <= MAX_ARRAY_SIZE)
+        {
+            container->lows.resize(container->count);
+            memcpy(container->lows.data(), cur, container->count * 2);
+            cur += container->count * 2;
+        }
+        else
+        {
+            container->words.resize(WORD_COUNT);
+            memcpy(container->words.data(), cur, WORD_COUNT * 8);
+            cur += WORD_COUNT * 8;
+        }
+    }
+    return cur - data;
+}
+
+// Get position of container of key, or where it would be inserted
+int Bitmap::findContainer(int key) const
+{
+    // Appending ids hit the last container, so it is checked before binary search
+    int size = containers.size();
+    if (size == 0 || containers[size - 1].key < key)
+        return size;
+    if (containers[size - 1].key == key)
+        return size - 1;
+
+    int low = 0, high = size - 1;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (containers[mid].key < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// Turn container into array or bitset, whichever suits its count
+void Bitmap::normalize(Container* container)
+{
+    if (container->words.empty() && container->count > MAX_ARRAY_SIZE)
+    {
+        container->words.assign(WORD_COUNT, 0);
+        for (int i = 0; i < container->count; i++)
+            container->words[container->lows[i] >> 6] |= 1ULL << (container->lows[i] & 63);
+        vector<unsigned short>().swap(container->lows);
+    }
+    else if (!container->words.empty() && container->count <= MAX_ARRAY_SIZE)
+    {
+        container->lows.reserve(container->count);
+        for (int w = 0; w < WORD_COUNT; w++)
+            for (int b = 0; b < 64; b++)
+                if (container->words[w] >> b & 1)
+                    container->lows.push_back(w << 6 | b);
+        vector<unsigned long long>().swap(container->words);
+    }
+}
+
+// Keep only low bits of container also in other container
+void Bitmap::intersect(Container* container, const Container* other)
+{
+    if (!container->words.empty() && !other->words.empty())
+    {
+        // Bitsets are combined word by word
+        int count = 0;
+        for (int w = 0; w < WORD_COUNT; w++)
+        {
+            container->words[w] &= other->words[w];
+            count += bitset<64>(container->words[w]).count();
+        }
+        container->count = count;
+    }
+    else if (container->words.empty() && other->words.empty())
+    {
+        vector<unsigned short> lows;
+        set_intersection(container->lows.begin(), container->lows.end(), other->lows.begin(), other->lows.end(), back_inserter(lows));
+        container->lows.swap(lows);
+        container->count = container->lows.size();
+    }
+    else
+    {
+        // Array is filtered by probing bitset, so result is always an array
+        const Container* array = container->words.empty() ? container : other;
+        const Container* bits = container->words.empty() ? other : container;
+        vector<unsigned short> lows;
+        for (int i = 0; i < array->count; i++)
+            if (contains(bits, array->lows[i]))
+                lows.push_back(array->lows[i]);
+        container->lows.swap(lows);
+        vector<unsigned long long>().swap(container->words);
+        container->count = container->lows.size();
+    }
+    normalize(container);
+}
+
+// Add low bits of other container into container
+void Bitmap::unite(Container* container, const Container* other)
+{
+    if (container->words.empty() && other->words.empty())
+    {
+        vector<unsigned short> lows;
+        set_union(container->lows.begin(), container->lows.end(), other->lows.begin(), other->lows.end(), back_inserter(lows));
+        container->lows.swap(lows);
+        container->count = container->lows.size();
+        normalize(container);
+        return;
+    }
+
+    // Result is a bitset if either side is one
+    if (container->words.empty())
+    {
+        container->words.assign(WORD_COUNT, 0);
+        for (int i = 0; i < container->count; i++)
+            container->words[container->lows[i] >> 6] |= 1ULL << (container->lows[i] & 63);
+        vector<unsigned short>().swap(container->lows);
+    }
+    if (other->words.empty())
+    {
+        for (int i = 0; i < other->count; i++)
+            container->words[other->lows[i] >> 6] |= 1ULL << (other->lows[i] & 63);
+    }
+    else
+    {
+        for (int w = 0; w < WORD_COUNT; w++)
+            container->words[w] |= other->words[w];
+    }
+
+    int count = 0;
+    for (int w = 0; w < WORD_COUNT; w++)
+        count += bitset<64>(container->words[w]).count();
+    container->count = count;
+    normalize(container);
+}
+
+// If container holds low bits
+bool Bitmap::contains(const Container* container, int low)
+{
+    if (!container->words.empty())
+        return container->words[low >> 6] >> (low & 63) & 1;
+    return binary_search(container->lows.begin(), container->lows.end(), (unsigned short)low);
+}
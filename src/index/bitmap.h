@@ -0,0 +1,89 @@
+#ifndef _BITMAP_H
+#define _BITMAP_H
+
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Compressed set of non-negative record ids, split into containers of 65536 ids by their high 16 bits
+// A container keeps a sorted array of low 16 bits while it holds few ids, and a bitset of 1024 words otherwise
+// Serialized layout: [containerCount][key1][count1][lows or words of container 1]...
+class Bitmap
+{
+public:
+
+    // Max number of ids kept in an array container
+    static const int MAX_ARRAY_SIZE;
+
+    // Add id. Return false if id is already in bitmap
+    bool add(int id);
+
+    // Remove id. Return false if id is not in bitmap
+    bool remove(int id);
+
+    // If id is in bitmap
+    bool contains(int id) const;
+
+    // Get number of ids
+    int getCount() const;
+
+    // If bitmap holds no id
+    bool isEmpty() const;
+
+    // Keep only ids also in other bitmap
+    void intersect(const Bitmap* other);
+
+    // Add all ids of other bitmap
+    void unite(const Bitmap* other);
+
+    // Append all ids in ascending order
+    void getIds(vector<int>* ids) const;
+
+    // Append serialized bitmap to data
+    void save(string* data) const;
+
+    // Replace bitmap with one serialized at data. Return number of bytes read
+    int load(const char* data);
+
+private:
+
+    // Ids sharing high 16 bits
+    struct Container
+    {
+        // High 16 bits of ids
+        int key;
+
+        // Number of ids
+        int count;
+
+        // Sorted low 16 bits if count is at most MAX_ARRAY_SIZE, otherwise empty
+        vector<unsigned short> lows;
+
+        // Bitset of low 16 bits if count exceeds MAX_ARRAY_SIZE, otherwise empty
+        vector<unsigned long long> words;
+    };
+
+    // Number of words in a bitset container
+    static const int WORD_COUNT;
+
+    // Containers in ascending order of key
+    vector<Container> containers;
+
+    // Get position of container of key, or where it would be inserted
+    int findContainer(int key) const;
+
+    // Turn container into array or bitset, whichever suits its count
+    static void normalize(Container* container);
+
+    // Keep only low bits of container also in other container
+    static void intersect(Container* container, const Container* other);
+
+    // Add low bits of other container into container
+    static void unite(Container* container, const Container* other);
+
+    // If container holds low bits
+    static bool contains(const Container* container, int low);
+};
+
+#endif
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "global.h"
+#include "minisql.h"
+#include "buffer/bufferManager.h"
+#include "index/bitmapIndex.h"
+
+using namespace std;
+
+// Bytes of header in file
+const int BitmapIndex::HEADER_SIZE = 24;
+
+// Bytes before data in a chain block
+const int BitmapIndex::CHAIN_HEADER_SIZE = 4;
+
+// Create bitmap index file
+void BitmapIndex::createFile(const char* _filename, int _keyLength)
+{
+    FILE* file = fopen(("data/" + string(_filename) + ".mdb").c_str(), "wb");
+    int header[] = {_keyLength, 0, -1, 0, 0, -1};
+    fwrite(header, 4, 6, file);
+    fclose(file);
+}
+
+// Constructor
+BitmapIndex::BitmapIndex(const char* _filename): filename(_filename)
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* header = manager->getBlock(_filename, 0);
+
+    // Get header information. Header block may be replaced once chains are read
+    keyLength = *(reinterpret_cast<int*>(header->content));
+    int keyCount = *(reinterpret_cast<int*>(header->content + 4));
+    directory.first = *(reinterpret_cast<int*>(header->content + 8));
+    directory.length = *(reinterpret_cast<int*>(header->content + 12));
+    nodeCount = *(reinterpret_cast<int*>(header->content + 16));
+    firstEmpty = *(reinterpret_cast<int*>(header->content + 20));
+
+    // Load bitmap of each key from its chain
+    string data = readChain(&directory);
+    const char* cur = data.data();
+    for (int i = 0; i < keyCount; i++)
+    {
+        string key(cur, keyLength);
+        Chain chain;
+        memcpy(&chain.first, cur + keyLength, 4);
+        memcpy(&chain.length, cur + keyLength + 4, 4);
+        cur += keyLength + 8;
+
+        Bitmap* bitmap = new Bitmap();
+        bitmap->load(readChain(&chain).data());
+        bitmaps[key] = bitmap;
+        chains[key] = chain;
+    }
+}
+
+// Destructor
+BitmapIndex::~BitmapIndex()
+{
+    for (auto it = bitmaps.begin(); it != bitmaps.end(); it++)
+        delete it->second;
+}
+
+// Get bitmap of key, or NULL if no record has key
+const Bitmap* BitmapIndex::find(const char* _key) const
+{
+    auto it = bitmaps.find(string(_key, keyLength));
+    return it == bitmaps.end() ? NULL : it->second;
+}
+
+// Find keys between lower and upper in ascending order, with their bitmaps
+// A NULL bound leaves that side open. Return number of keys found
+int BitmapIndex::findRange(const char* lower, bool lowerInclusive, const char* upper, bool upperInclusive,
+    vector<string>* keys, vector<const Bitmap*>* found) const
+{
+    auto it = bitmaps.begin();
+    if (lower != NULL)
+    {
+        string key(lower, keyLength);
+        it = lowerInclusive ? bitmaps.lower_bound(key) : bitmaps.upper_bound(key);
+    }
+
+    int findCount = 0;
+    string last = upper == NULL ? string() : string(upper, keyLength);
+    for (; it != bitmaps.end(); it++)
+    {
+        if (upper != NULL && (upperInclusive ? it->first > last : it->first >= last))
+            break;
+        if (keys != NULL)
+            keys->push_back(it->first);
+        found->push_back(it->second);
+        findCount++;
+    }
+    return findCount;
+}
+
+// Add record id to bitmap of key. Return true if success
+bool BitmapIndex::add(const char* _key, int _value)
+{
+    Bitmap*& bitmap = bitmaps[string(_key, keyLength)];
+    if (bitmap == NULL)
+        bitmap = new Bitmap();
+    if (!bitmap->add(_value))
+        return false;
+    dirtyKeys.insert(string(_key, keyLength));
+    return true;
+}
+
+// Remove record id from bitmap of key. Return true if success
+bool BitmapIndex::remove(const char* _key, int _value)
+{
+    auto it = bitmaps.find(string(_key, keyLength));
+    if (it == bitmaps.end() || !it->second->remove(_value))
+        return false;
+
+    // Key without records is dropped, so every key kept has a record
+    dirtyKeys.insert(it->first);
+    if (it->second->isEmpty())
+    {
+        delete it->second;
+        bitmaps.erase(it);
+    }
+    return true;
+}
+
+// Get length of each key
+int BitmapIndex::getKeyLength() const
+{
+    return keyLength;
+}
+
+// Write modified bitmaps and directory back to buffer
+void BitmapIndex::flushHeader()
+{
+    if (dirtyKeys.empty())
+        return;
+
+    // Chain of a dropped key is emptied and forgotten
+    for (auto& key : dirtyKeys)
+    {
+        auto it = bitmaps.find(key);
+        Chain* chain = &chains.insert(make_pair(key, Chain{-1, 0})).first->second;
+        string data;
+        if (it != bitmaps.end())
+            it->second->save(&data);
+        writeChain(chain, data);
+        if (it == bitmaps.end())
+            chains.erase(key);
+    }
+    dirtyKeys.clear();
+
+    string data;
+    for (auto& item : chains)
+    {
+        data.append(item.first);
+        data.append(reinterpret_cast<const char*>(&item.second.first), 4);
+        data.append(reinterpret_cast<const char*>(&item.second.length), 4);
+    }
+    writeChain(&directory, data);
+
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* block = manager->getBlock(filename.c_str(), 0);
+    int header[] = {keyLength, (int)chains.size(), directory.first, directory.length, nodeCount, firstEmpty};
+    if (memcmp(block->content, header, HEADER_SIZE) != 0)
+    {
+        memcpy(block->content, header, HEADER_SIZE);
+        block->dirty = true;
+    }
+}
+
+// Read data of chain
+string BitmapIndex::readChain(const Chain* chain)
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    string data;
+    data.reserve(chain->length);
+    for (int id = chain->first; (int)data.size() < chain->length; )
+    {
+        Block* block = manager->getBlock(filename.c_str(), id);
+        int length = min(chain->length - (int)data.size(), BLOCK_SIZE - CHAIN_HEADER_SIZE);
+        data.append(block->content + CHAIN_HEADER_SIZE, length);
+        id = *(reinterpret_cast<int*>(block->content));
+    }
+    return data;
+}
+
+// Write data over chain, which is resized by adding empty blocks or removing blocks left over
+// Blocks whose bytes are unchanged stay clean
+void BitmapIndex::writeChain(Chain* chain, const string& data)
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    vector<int> ids;
+    for (int id = chain->first; id >= 0; id = *(reinterpret_cast<int*>(manager->getBlock(filename.c_str(), id)->content)))
+        ids.push_back(id);
+
+    int dataSize = BLOCK_SIZE - CHAIN_HEADER_SIZE;
+    int count = (data.size() + dataSize - 1) / dataSize;
+    for (; (int)ids.size() > count; ids.pop_back())
+        removeBlock(ids.back());
+    while ((int)ids.size() < count)
+        ids.push_back(getFirstEmpty());
+
+    char content[BLOCK_SIZE];
+    for (int i = 0; i < count; i++)
+    {
+        int next = i + 1 < count ? ids[i + 1] : -1;
+        int length = min((int)data.size() - i * dataSize, dataSize);
+        memset(content, 0, BLOCK_SIZE);
+        memcpy(content, &next, 4);
+        memcpy(content + CHAIN_HEADER_SIZE, data.data() + i * dataSize, length);
+
+        Block* block = manager->getBlock(filename.c_str(), ids[i]);
+        if (memcmp(block->content, content, BLOCK_SIZE) != 0)
+        {
+            memcpy(block->content, content, BLOCK_SIZE);
+            block->dirty = true;
+        }
+    }
+    chain->first = count > 0 ? ids[0] : -1;
+    chain->length = data.size();
+}
+
+// Get first empty block id
+int BitmapIndex::getFirstEmpty()
+{
+    if (firstEmpty < 0)
+        return ++nodeCount;
+
+    int ret = firstEmpty;
+    Block* block = MiniSQL::getBufferManager()->getBlock(filename.c_str(), firstEmpty);
+    firstEmpty = *(reinterpret_cast<int*>(block->content));
+    return ret;
+}
+
+// Remove block in file
+void BitmapIndex::removeBlock(int id)
+{
+    Block* block = MiniSQL::getBufferManager()->getBlock(filename.c_str(), id);
+    memcpy(block->content, &firstEmpty, 4);
+    block->dirty = true;
+    firstEmpty = id;
+}
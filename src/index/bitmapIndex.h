@@ -0,0 +1,106 @@
+#ifndef _BITMAP_INDEX_H
+#define _BITMAP_INDEX_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+
+#include "index/bitmap.h"
+
+using namespace std;
+
+// Bitmap index for columns with few distinct values. Each key keeps a compressed bitmap of its record ids
+// Keys are compared by their first keyLength bytes, so record ids appended to keys are ignored
+// All bitmaps are kept in memory and written back lazily. Each bitmap is stored in its own chain of blocks,
+// so only bitmaps modified since last write are written again, and only in blocks whose bytes change
+// Header layout: [keyLength][keyCount][directory][directoryLength][nodeCount][firstEmpty]
+// Directory is a chain holding [key1][chain1][length1][key2][chain2][length2]...
+// Chain block layout: [next][data]. Blocks left over when a chain shrinks are reused
+class BitmapIndex
+{
+public:
+
+    // Create bitmap index file
+    static void createFile(const char* _filename, int _keyLength);
+
+    // Constructor
+    BitmapIndex(const char* _filename);
+
+    // Destructor
+    ~BitmapIndex();
+
+    // Get bitmap of key, or NULL if no record has key
+    const Bitmap* find(const char* _key) const;
+
+    // Find keys between lower and upper in ascending order, with their bitmaps
+    // A NULL bound leaves that side open. Return number of keys found
+    int findRange(const char* lower, bool lowerInclusive, const char* upper, bool upperInclusive,
+        vector<string>* keys, vector<const Bitmap*>* bitmaps) const;
+
+    // Add record id to bitmap of key. Return true if success
+    bool add(const char* _key, int _value);
+
+    // Remove record id from bitmap of key. Return true if success
+    bool remove(const char* _key, int _value);
+
+    // Get length of each key
+    int getKeyLength() const;
+
+    // Write modified bitmaps and directory back to buffer
+    void flushHeader();
+
+private:
+
+    // Bytes of header in file
+    static const int HEADER_SIZE;
+
+    // Bytes before data in a chain block
+    static const int CHAIN_HEADER_SIZE;
+
+    // First block and bytes of data of a chain
+    struct Chain
+    {
+        int first;
+        int length;
+    };
+
+    // Binary file name
+    string filename;
+
+    // Length of each key
+    int keyLength;
+
+    // Bitmap of each key
+    map<string, Bitmap*> bitmaps;
+
+    // Chain of each key written back. Keys whose bitmaps are dropped keep their chains until next write
+    map<string, Chain> chains;
+
+    // Chain of directory
+    Chain directory;
+
+    // Keys whose bitmaps are modified but not written back
+    set<string> dirtyKeys;
+
+    // Total number of blocks
+    int nodeCount;
+
+    // First empty block in file
+    int firstEmpty;
+
+    // Read data of chain
+    string readChain(const Chain* chain);
+
+    // Write data over chain, which is resized by adding empty blocks or removing blocks left over
+    // Blocks whose bytes are unchanged stay clean
+    void writeChain(Chain* chain, const string& data);
+
+    // Get first empty block id
+    int getFirstEmpty();
+
+    // Remove block in file
+    void removeBlock(int id);
+};
+
+#endif
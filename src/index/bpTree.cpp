@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
@@ -7,31 +8,46 @@
 #include "minisql.h"
 #include "buffer/bufferManager.h"
 #include "index/bpTreeNode.h"
+#include "index/keySorter.h"
 #include "index/bpTree.h"
 
 using namespace std;
 
 // States
 const int BPTree::BPTREE_FAILED = -1;
-const int BPTree::BPTREE_NORMAL = 0;
-const int BPTree::BPTREE_ADD = 1;
-const int BPTree::BPTREE_REMOVE = 2;
-const int BPTree::BPTREE_CHANGE = 3;
 
-// Create B+ Tree file
-void BPTree::createFile(const char* _filename, int _keyLength, int _order)
-{
-    // Calculate order if not provided
-    if (_order < 0)
-        _order = (BLOCK_SIZE - 8) / (_keyLength + 4) + 1;
+// Tag written before format version in header
+const int BPTree::FILE_TAG = 0x54504d42;
+
+// Version of file format. Files of an older version are laid out differently and must be rebuilt
+const int BPTree::FORMAT_VERSION = 1;
+
+// Percentage of key-pointers kept by a node on the right edge when an append splits it
+const int BPTree::APPEND_SPLIT_PERCENT = 90;
+
+// Bytes of keys and values of pending messages kept by a buffered tree before they are applied
+const int BPTree::MESSAGE_BUFFER_SIZE = 1 << 20;
 
-    // Create file
+// Create B+ tree file. Inserts and deletes are buffered if buffered is true
+void BPTree::createFile(const char* _filename, int _keyLength, bool _buffered)
+{
+    // Create file. Fanout of each node depends on its keys, so no order is stored
     FILE* file = fopen(("data/" + string(_filename) + ".mdb").c_str(), "wb");
-    int header[] = {_order, _keyLength, 0, -1, -1};
-    fwrite(header, 4, 5, file);
+    int header[] = {_keyLength, 0, -1, -1, _buffered ? 1 : 0, FILE_TAG, FORMAT_VERSION};
+    fwrite(header, 4, 7, file);
     fclose(file);
 }
 
+// Get format version of B+ tree file. Files without file tag are written before versioning, and are of version 0
+int BPTree::getFileVersion(const char* _filename)
+{
+    // Header of older files ends earlier, and the rest of its block may hold anything
+    Block* header = MiniSQL::getBufferManager()->getBlock(_filename, 0);
+    if (*(reinterpret_cast<int*>(header->content + 20)) != FILE_TAG)
+        return 0;
+    return *(reinterpret_cast<int*>(header->content + 24));
+}
+
 // Constructor
 BPTree::BPTree(const char* _filename): filename(_filename)
 {
@@ -39,56 +55,447 @@ BPTree::BPTree(const char* _filename): filename(_filename)
     Block* header = manager->getBlock(_filename, 0);
 
     // Get header information
-    order = *(reinterpret_cast<int*>(header->content));
-    keyLength = *(reinterpret_cast<int*>(header->content + 4));
-    nodeCount = *(reinterpret_cast<int*>(header->content + 8));
-    root = *(reinterpret_cast<int*>(header->content + 12));
-    firstEmpty = *(reinterpret_cast<int*>(header->content + 16));
-
-    key = new char[keyLength];
+    keyLength = *(reinterpret_cast<int*>(header->content));
+    nodeCount = *(reinterpret_cast<int*>(header->content + 4));
+    root = *(reinterpret_cast<int*>(header->content + 8));
+    firstEmpty = *(reinterpret_cast<int*>(header->content + 12));
+    buffered = *(reinterpret_cast<int*>(header->content + 16)) != 0;
+
+    rightLeaf = -1;
+    cursor = NULL;
+    message = messages.end();
+    cursorOpen = false;
+    headerDirty = false;
 }
 
 // Destructor
 BPTree::~BPTree()
 {
-    delete[] key;
+    closeCursor();
 }
 
 // Find value of key
 int BPTree::find(const char* _key)
 {
-    memcpy(key, _key, keyLength);
-    return root < 0 ? BPTREE_FAILED : find(root);
+    // Newer messages override older ones, which override leaves
+    if (buffered)
+    {
+        string key(_key, keyLength);
+        lock_guard<mutex> guard(bufferLatch);
+        auto it = messages.find(key);
+        if (it != messages.end())
+            return it->second.value;
+        it = flushing.find(key);
+        if (it != flushing.end())
+            return it->second.value;
+    }
+    return findDirect(_key);
 }
 
 // Add key-value pair. Return true if success
+// A buffered tree only rejects keys pending insertion. Keys in leaves are rejected when messages are applied
 bool BPTree::add(const char* _key, int _value)
 {
-    memcpy(key, _key, keyLength);
-    value = _value;
-    int res = root < 0 ? BPTREE_ADD : add(root);
+    if (buffered)
+        return addMessage(_key, _value);
+    return addDirect(_key, _value);
+}
+
+// Remove key-value pair. Return true if success
+// A buffered tree records removal without looking for key, and always succeeds
+bool BPTree::remove(const char* _key)
+{
+    if (buffered)
+        return addMessage(_key, BPTREE_FAILED);
+    return removeDirect(_key);
+}
+
+// Apply pending messages of buffered tree to leaves in key order
+void BPTree::flushMessages()
+{
+    if (!buffered)
+        return;
+
+    // Messages stay visible to finding in flushing until all of them are applied
+    lock_guard<mutex> guard(flushLatch);
+    bufferLatch.lock();
+    flushing.swap(messages);
+    bufferLatch.unlock();
+
+    // Insertion of a key in leaves is a duplicate unless it follows removal of the key
+    // Duplicates are dropped like in unbuffered tree, and removal of missing key is ignored
+    int duplicateCount = 0;
+    for (auto& item : flushing)
+    {
+        const char* key = item.first.data();
+        int value = item.second.value;
+        if (value == BPTREE_FAILED)
+            removeDirect(key);
+        else if (!addDirect(key, value))
+        {
+            if (item.second.replace)
+            {
+                removeDirect(key);
+                addDirect(key, value);
+            }
+            else
+                duplicateCount++;
+        }
+    }
+    if (duplicateCount > 0)
+        cerr << "ERROR: [BPTree::flushMessages] " << duplicateCount << " duplicate key(s) dropped from tree `"
+            << filename << "`!" << endl;
+
+    {
+        lock_guard<mutex> bufferGuard(bufferLatch);
+        flushing.clear();
+    }
+    reseek();
+}
+
+// Find value of key in leaves
+int BPTree::findDirect(const char* _key)
+{
+    // Restart from root until the leaf is read unchanged
+    while (root >= 0)
+    {
+        unsigned int version;
+        BPTreeNode* leaf = findLeaf(_key, &version);
+        if (leaf == NULL)
+            continue;
+
+        int value;
+        bool found;
+        bool valid = leaf->probe(_key, &value, &found) >= 0 && leaf->validate(version);
+        delete leaf;
+        if (valid)
+            return found ? value : BPTREE_FAILED;
+    }
+    return BPTREE_FAILED;
+}
+
+// Add key-value pair into leaves. Return true if success
+bool BPTree::addDirect(const char* _key, int _value)
+{
+    if (append(_key, _value))
+        return true;
+
+    // Key is added into leaf directly if it fits. Otherwise leaf splits with structure latch held
+    while (root >= 0)
+    {
+        unsigned int version;
+        BPTreeNode* leaf = findLeaf(_key, &version);
+        if (leaf == NULL)
+            continue;
+        if (!leaf->upgradeLock(version))
+        {
+            delete leaf;
+            continue;
+        }
+
+        // Check for duplicate
+        int pos = leaf->findPosition(_key);
+        bool duplicate = pos > 0 && memcmp(_key, leaf->getKey(pos), keyLength) == 0;
+        bool added = !duplicate && leaf->insert(pos, _key, _value);
+        leaf->writeUnlock();
+        delete leaf;
+
+        if (duplicate || added)
+            return added;
+        break;
+    }
+    return addLocked(_key, _value);
+}
+
+// Remove key-value pair from leaves. Return true if success
+bool BPTree::removeDirect(const char* _key)
+{
+    // Key is removed from leaf directly. Underfull leaf is merged with structure latch held
+    while (root >= 0)
+    {
+        unsigned int version;
+        BPTreeNode* leaf = findLeaf(_key, &version);
+        if (leaf == NULL)
+            continue;
+        if (!leaf->upgradeLock(version))
+        {
+            delete leaf;
+            continue;
+        }
+
+        // Check if key is found
+        int pos = leaf->findPosition(_key);
+        bool found = pos > 0 && memcmp(_key, leaf->getKey(pos), keyLength) == 0;
+        if (found)
+            leaf->remove(pos);
+        bool underfull = leaf->getUsedSize() * 2 < BLOCK_SIZE;
+        leaf->writeUnlock();
+        delete leaf;
+
+        if (found && underfull)
+            removeLocked(_key, true);
+        return found;
+    }
+    return false;
+}
+
+// Get length of each key
+int BPTree::getKeyLength() const
+{
+    return keyLength;
+}
+
+// If inserts and deletes are buffered
+bool BPTree::isBuffered() const
+{
+    return buffered;
+}
 
-    if (res == BPTREE_ADD)
+// Get number of levels, nodes and leaves, and bytes used by all leaves
+// Pending messages are applied first
+void BPTree::analyze(int* height, int* nodes, int* leaves, long long* leafBytes)
+{
+    flushMessages();
+    *height = 0;
+    *nodes = nodeCount;
+    *leaves = 0;
+    *leafBytes = 0;
+    if (root < 0)
+        return;
+
+    // Go down the leftmost path, then walk along the leaves
+    int id = root;
+    while (true)
     {
-        // Create new root
-        int newRoot = getFirstEmpty();
-        BPTreeNode* node = new BPTreeNode(filename.c_str(), newRoot, keyLength, root < 0, root < 0 ? -1 : root);
-        node->insert(0, key, value);
+        BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength);
+        bool leaf = node->isLeaf();
+        if (!leaf)
+            id = node->getPointer(0);
         delete node;
-        root = newRoot;
+        (*height)++;
+        if (leaf)
+            break;
     }
-    updateHeader();
 
-    return res != BPTREE_FAILED;
+    while (id >= 0)
+    {
+        BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength);
+        (*leaves)++;
+        *leafBytes += node->getUsedSize();
+        id = node->getNext();
+        delete node;
+    }
 }
 
-// Remove key-value pair. Return true if success
-bool BPTree::remove(const char* _key)
+// Load sorted keys into empty tree bottom-up
+// Each node is filled to fillFactor percent of a block. Return true if success
+bool BPTree::bulkLoad(KeySorter* sorter, int fillFactor)
 {
-    memcpy(key, _key, keyLength);
-    int res = root < 0 ? false : remove(root, 0, true, NULL);
+    if (root >= 0)
+    {
+        cerr << "ERROR: [BPTree::bulkLoad] Tree `" << filename << "` is not empty!" << endl;
+        return false;
+    }
+
+    int count = sorter->getCount();
+    if (count == 0)
+        return true;
+    int limit = BLOCK_SIZE * fillFactor / 100;
+    lock_guard<mutex> guard(structureLatch);
+
+    // Fill leaves in key order up to fill factor of block, and link each leaf to the next
+    // Keys of a leaf are collected first so that their common prefix is stored once
+    vector<int> ids;
+    vector<string> firstKeys;
+    string keys;
+    vector<int> values;
+    bool ok = true;
+
+    string key(keyLength, 0);
+    int id = getFirstEmpty();
+    for (int j = 0; j < count; j++)
+    {
+        int value = sorter->next(&key[0]);
+        int size = values.size();
+        if (size > 0 && memcmp(&keys[(size - 1) * keyLength], key.data(), keyLength) >= 0)
+            ok = false;
+
+        // Write leaf out if key does not fit. Every leaf keeps at least two keys
+        if (size >= 2 && BPTreeNode::getPackedSize(keys.data(), key.data(), size + 1, keyLength) > limit)
+        {
+            int nextId = getFirstEmpty();
+            firstKeys.push_back(keys.substr(0, keyLength));
+            BPTreeNode* leaf = createNode(id, -1, &keys, &values);
+            leaf->setNext(nextId);
+            delete leaf;
+
+            ids.push_back(id);
+            id = nextId;
+        }
+        keys.append(key);
+        values.push_back(value);
+    }
+    firstKeys.push_back(keys.substr(0, keyLength));
+    delete createNode(id, -1, &keys, &values);
+    ids.push_back(id);
+    int lastLeaf = id;
+
+    // Build internal levels until a single root is left
+    while (ok && ids.size() > 1)
+        ids = buildLevel(&ids, &firstKeys, limit);
+
+    if (!ok)
+    {
+        cerr << "ERROR: [BPTree::bulkLoad] Keys of tree `" << filename << "` are not unique!" << endl;
+        return false;
+    }
+
+    root = ids[0];
+    rightLeaf = lastLeaf;
     updateHeader();
-    return res != BPTREE_FAILED;
+    return true;
+}
+
+// Move cursor to the first key not less than lower(greater than lower if not inclusive)
+// Cursor starts from the smallest key if lower is NULL
+void BPTree::seek(const char* lower, bool inclusive)
+{
+    closeCursor();
+    cursorOpen = true;
+    cursorKey = lower == NULL ? string() : string(lower, keyLength);
+    cursorInclusive = inclusive;
+    if (lower == NULL)
+        message = messages.begin();
+    else if (inclusive)
+        message = messages.lower_bound(string(lower, keyLength));
+    else
+        message = messages.upper_bound(string(lower, keyLength));
+    if (root < 0)
+        return;
+
+    // Go down to the leaf which may contain lower
+    int id = root;
+    while (true)
+    {
+        cursor = new BPTreeNode(filename.c_str(), id, keyLength);
+        cursorPos = lower == NULL ? 0 : cursor->findPosition(lower);
+        if (cursor->isLeaf())
+            break;
+        id = cursor->getPointer(cursorPos);
+        delete cursor;
+    }
+
+    // Keys before cursorPos are not greater than lower
+    if (
+        cursorPos > 0 && inclusive &&
+        memcmp(cursor->getKey(cursorPos), lower, keyLength) == 0
+    )
+        return;
+    cursorPos++;
+}
+
+// Move cursor forward to the first key not less than lower, which is greater than keys already read
+// Cursor stays in its leaf if lower is not beyond its last key, and descends from root otherwise
+void BPTree::skip(const char* lower)
+{
+    if (cursorKey.empty() || memcmp(lower, cursorKey.data(), keyLength) > 0)
+    {
+        cursorKey.assign(lower, keyLength);
+        cursorInclusive = true;
+    }
+    if (message != messages.end() && memcmp(message->first.data(), lower, keyLength) < 0)
+        message = messages.lower_bound(string(lower, keyLength));
+    if (cursor == NULL)
+        return;
+
+    int size = cursor->getSize();
+    if (size == 0 || memcmp(cursor->getKey(size), lower, keyLength) < 0)
+    {
+        seek(lower, true);
+        return;
+    }
+
+    // Keys up to position are not greater than lower
+    int pos = cursor->findPosition(lower);
+    if (pos == 0 || memcmp(cursor->getKey(pos), lower, keyLength) != 0)
+        pos++;
+    cursorPos = max(cursorPos, pos);
+}
+
+// Get key at cursor and move cursor to the next key along the leaves
+// Return value, or BPTREE_FAILED if cursor reaches the end
+int BPTree::next(char* _key)
+{
+    while (true)
+    {
+        // Skip to next leaf
+        while (cursor != NULL && cursorPos > cursor->getSize())
+        {
+            int nxt = cursor->getNext();
+            delete cursor;
+            cursor = NULL;
+            if (nxt >= 0)
+            {
+                cursor = new BPTreeNode(filename.c_str(), nxt, keyLength);
+                cursorPos = 1;
+            }
+        }
+
+        // Pending message of a key not after key at cursor overrides it
+        int cmp = -1;
+        if (message == messages.end())
+            cmp = 1;
+        else if (cursor != NULL)
+            cmp = memcmp(message->first.data(), cursor->getKey(cursorPos), keyLength);
+        if (cmp > 0)
+        {
+            if (cursor == NULL)
+                return BPTREE_FAILED;
+            memcpy(_key, cursor->getKey(cursorPos), keyLength);
+            cursorKey.assign(_key, keyLength);
+            cursorInclusive = false;
+            return cursor->getPointer(cursorPos++);
+        }
+
+        if (cmp == 0)
+            cursorPos++;
+        int value = message->second.value;
+        memcpy(_key, message->first.data(), keyLength);
+        cursorKey.assign(_key, keyLength);
+        cursorInclusive = false;
+        message++;
+        if (value != BPTREE_FAILED)
+            return value;
+    }
+}
+
+// Release leaf held by cursor
+void BPTree::closeCursor()
+{
+    if (cursor != NULL)
+        delete cursor;
+    cursor = NULL;
+    message = messages.end();
+    cursorOpen = false;
+}
+
+// Apply pending messages, and write header information back to buffer if it is modified
+void BPTree::flushHeader()
+{
+    flushMessages();
+    if (!headerDirty)
+        return;
+
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* block = manager->getBlock(filename.c_str(), 0);
+
+    int rootId = root;
+    memcpy(block->content + 4, &nodeCount, 4);
+    memcpy(block->content + 8, &rootId, 4);
+    memcpy(block->content + 12, &firstEmpty, 4);
+
+    block->dirty = true;
+    headerDirty = false;
 }
 
 #ifdef DEBUG
@@ -108,195 +515,388 @@ void BPTree::debugPrint()
 }
 #endif
 
-// Recursive function for finding value
-int BPTree::find(int id)
+// Descend optimistically to the leaf which may contain key
+// Return pinned leaf and set its version, or NULL if tree is empty or a node changes on the way
+BPTreeNode* BPTree::findLeaf(const char* _key, unsigned int* version)
 {
+    // Node is checked to be root after its version is got, as root may be replaced
+    int id = root;
+    if (id < 0)
+        return NULL;
     BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength);
-    int pos = node->findPosition(key);
+    if (!node->readLock(version) || root != id)
+    {
+        delete node;
+        return NULL;
+    }
 
-    int ret = BPTREE_FAILED;
-    if (node->isLeaf())
+    while (!node->isLeaf())
     {
-        // Check if key is found
-        if (pos > 0)
+        // Child pointer is used only after node is validated
+        int childId;
+        bool found;
+        if (node->probe(_key, &childId, &found) < 0 || !node->validate(*version))
+        {
+            delete node;
+            return NULL;
+        }
+
+        // Node is validated again, so child is unchanged since it was pointed by node
+        BPTreeNode* child = new BPTreeNode(filename.c_str(), childId, keyLength);
+        unsigned int childVersion;
+        bool valid = child->readLock(&childVersion) && node->validate(*version);
+        delete node;
+        node = child;
+        *version = childVersion;
+        if (!valid)
         {
-            const char* k = node->getKey(pos);
-            if (memcmp(key, k, keyLength) == 0)
-                ret = node->getPointer(pos);
+            delete node;
+            return NULL;
         }
     }
-    else
-        ret = find(node->getPointer(pos));
+    return node;
+}
 
-    delete node;
-    return ret;
+// Move open cursor again to where it stopped
+void BPTree::reseek()
+{
+    if (!cursorOpen)
+        return;
+    string key = cursorKey;
+    seek(key.empty() ? NULL : key.data(), cursorInclusive);
 }
 
-// Recursive function for adding key-value pair
-int BPTree::add(int id)
+// Record pending message of key, which is a removal if value is BPTREE_FAILED
+// Messages are applied if buffer is full. Return false if key is already pending insertion
+bool BPTree::addMessage(const char* _key, int _value)
 {
-    BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength);
-    int pos = node->findPosition(key);
+    string key(_key, keyLength);
+    bool full;
+    {
+        // Newest pending message of key is checked. Insertion after a pending removal replaces key in leaves
+        lock_guard<mutex> guard(bufferLatch);
+        auto it = messages.find(key);
+        bool pending = it != messages.end();
+        if (!pending)
+        {
+            it = flushing.find(key);
+            pending = it != flushing.end();
+        }
+        if (_value != BPTREE_FAILED && pending && it->second.value != BPTREE_FAILED)
+            return false;
+
+        Message item = {_value, pending};
+        messages[key] = item;
+        full = (long long)messages.size() * (keyLength + 4) >= MESSAGE_BUFFER_SIZE;
+    }
+
+    if (full)
+        flushMessages();
+    return true;
+}
 
-    int res = node->isLeaf() ? BPTREE_ADD : add(node->getPointer(pos));
-    int ret = BPTREE_NORMAL;
+// Append key-value pair to rightmost leaf if key is beyond its last key and fits
+// Return false if key is not appended
+bool BPTree::append(const char* _key, int _value)
+{
+    int id = rightLeaf;
+    if (id < 0)
+        return false;
+
+    // Leaf is checked to be cached after its version is got, as a removed block is uncached first
+    BPTreeNode* leaf = new BPTreeNode(filename.c_str(), id, keyLength);
+    unsigned int version;
+    if (!leaf->readLock(&version) || rightLeaf != id || !leaf->upgradeLock(version))
+    {
+        delete leaf;
+        return false;
+    }
 
-    if (node->isLeaf() && pos > 0)
+    // Split leaf is no longer rightmost. Keys beyond the last key of rightmost leaf belong to it
+    int size = leaf->getSize();
+    bool added =
+        leaf->getNext() < 0 && size > 0 &&
+        memcmp(_key, leaf->getKey(size), keyLength) > 0 &&
+        leaf->insert(size, _key, _value);
+    leaf->writeUnlock();
+    delete leaf;
+    return added;
+}
+
+// Add key-value pair while holding every node which may split. Return true if success
+// Nodes on the right edge split unevenly when key goes after all their keys
+bool BPTree::addLocked(const char* _key, int _value)
+{
+    lock_guard<mutex> guard(structureLatch);
+    updateHeader();
+
+    if (root < 0)
     {
-        // Check for duplicate
-        const char* k = node->getKey(pos);
-        if (memcmp(key, k, keyLength) == 0)
-            res = BPTREE_FAILED;
+        // Create leaf as root
+        int id = getFirstEmpty();
+        BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength, -1);
+        node->insert(0, _key, _value);
+        delete node;
+        root = id;
+        rightLeaf = id;
+        return true;
     }
 
-    if (res == BPTREE_FAILED)
-        // Duplicate key
-        ret = BPTREE_FAILED;
-    else if (res == BPTREE_ADD)
+    // Hold nodes from root down. A node with room for any key stops splits, so its ancestors are released
+    // A node is on the right edge if it is reached by the last pointer of each ancestor
+    vector<BPTreeNode*> path;
+    vector<int> positions;
+    vector<bool> edges;
+    bool edge = true;
+    for (int id = root; ; )
     {
-        // Add new key-value
-        node->insert(pos, key, value);
+        BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength);
+        node->writeLock();
+        if (node->hasRoom())
+        {
+            for (auto ancestor : path)
+            {
+                ancestor->writeUnlock();
+                delete ancestor;
+            }
+            path.clear();
+            positions.clear();
+            edges.clear();
+        }
 
-        if (node->getSize() >= order)
+        int pos = node->findPosition(_key);
+        path.push_back(node);
+        positions.push_back(pos);
+        edges.push_back(edge);
+        if (node->isLeaf())
         {
-            // Node full. Split
-            int newId = getFirstEmpty();
-            BPTreeNode* newNode = node->split(newId, key);
-            value = newId;
+            if (edge)
+                rightLeaf = id;
+            break;
+        }
+        edge = edge && pos == node->getSize();
+        id = node->getPointer(pos);
+    }
+
+    // Check for duplicate
+    BPTreeNode* leaf = path.back();
+    int pos = positions.back();
+    bool ret = !(pos > 0 && memcmp(_key, leaf->getKey(pos), keyLength) == 0);
 
-            delete newNode;
-            ret = BPTREE_ADD;
+    // Add key-pointer from leaf upward, and split node if it does not fit
+    // Only root may split at the top of path, then a new root is created
+    string key(_key, keyLength);
+    int ptr = _value;
+    for (int level = path.size() - 1; ret && level >= 0; level--)
+    {
+        BPTreeNode* node = path[level];
+        if (node->insert(positions[level], key.data(), ptr))
+            break;
+
+        // Appending keys leave left node nearly full, as few keys will come before the new one
+        bool appending = edges[level] && positions[level] == node->getSize();
+        int newId = getFirstEmpty();
+        BPTreeNode* newNode = node->split(
+            newId, positions[level], key.data(), ptr, &key[0], appending ? APPEND_SPLIT_PERCENT : 50
+        );
+        if (newNode == NULL)
+        {
+            // Node is unchanged, so key is rejected. Keys up to MAX_KEY_LENGTH always split
+            removeBlock(newId);
+            ret = false;
+            break;
+        }
+        delete newNode;
+        if (edges[level] && node->isLeaf())
+            rightLeaf = newId;
+        ptr = newId;
+
+        if (level == 0)
+        {
+            int newRoot = getFirstEmpty();
+            BPTreeNode* rootNode = new BPTreeNode(filename.c_str(), newRoot, keyLength, root);
+            rootNode->insert(0, key.data(), ptr);
+            delete rootNode;
+            root = newRoot;
         }
     }
 
-    delete node;
+    // Root is replaced before old root is released
+    for (auto node : path)
+    {
+        node->writeUnlock();
+        delete node;
+    }
     return ret;
 }
 
-// Recursive function for deleting key-value pair
-int BPTree::remove(int id, int sibId, bool leftSib, const char* parentKey)
+// Remove key-value pair while holding the path from root, and merge or rebalance underfull nodes
+// Key is only looked for merging if it is already removed. Return true if success
+bool BPTree::removeLocked(const char* _key, bool removed)
 {
-    BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength);
-    BPTreeNode* sib = NULL;
-    if (id != root)
-        sib = new BPTreeNode(filename.c_str(), sibId, keyLength);
-    int pos = node->findPosition(key);
-
-    int res;
-    if (node->isLeaf())
-        res = BPTREE_FAILED;
-    else
+    lock_guard<mutex> guard(structureLatch);
+    updateHeader();
+    if (root < 0)
+        return removed;
+
+    // Hold nodes from root down, as merges may reach root
+    vector<BPTreeNode*> path;
+    vector<int> ids, positions;
+    for (int id = root; ; )
     {
-        int nxtId = node->getPointer(pos);
-        int nxtSib = node->getPointer(pos > 0 ? pos - 1 : pos + 1);
-        const char* nxtParentKey = node->getKey(pos > 0 ? pos : pos + 1);
-        res = remove(nxtId, nxtSib, pos > 0, nxtParentKey);
+        BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength);
+        node->writeLock();
+        int pos = node->findPosition(_key);
+        path.push_back(node);
+        ids.push_back(id);
+        positions.push_back(pos);
+        if (node->isLeaf())
+            break;
+        id = node->getPointer(pos);
     }
 
-    if (node->isLeaf())
+    // Check if key is found
+    BPTreeNode* leaf = path.back();
+    int pos = positions.back();
+    bool ret = removed;
+    if (!removed && pos > 0 && memcmp(_key, leaf->getKey(pos), keyLength) == 0)
     {
-        // Check if key is found
-        if (pos > 0)
-        {
-            const char* k = node->getKey(pos);
-            if (memcmp(key, k, keyLength) == 0)
-                res = BPTREE_REMOVE;
-        }
+        leaf->remove(pos);
+        ret = true;
     }
 
-    int ret = BPTREE_NORMAL;
-    if (res == BPTREE_FAILED)
-        // Key not found
-        ret = BPTREE_FAILED;
-    else if (res == BPTREE_CHANGE)
-        // Change key
-        node->setKey(pos > 0 ? pos : pos + 1, key);
-    else if (res == BPTREE_REMOVE)
+    // Merge node with its sibling from leaf upward if both fit in one block
+    // Separator of merged node is removed from parent. Otherwise both nodes share their key-pointers evenly
+    for (int level = path.size() - 1; ret && level >= 0; level--)
     {
-        // Delete key
-        node->remove(pos > 0 ? pos : pos + 1);
-
-        if (id == root)
+        BPTreeNode* node = path[level];
+        if (level == 0)
         {
+            // Empty root is replaced by its only child
             if (node->getSize() == 0)
             {
                 root = node->getPointer(0);
-                removeBlock(id);
-                node->setRemoved();
+                removeBlock(ids[0]);
             }
+            break;
         }
-        else
+
+        BPTreeNode* parent = path[level - 1];
+        int parentPos = positions[level - 1];
+        if (node->getUsedSize() * 2 >= BLOCK_SIZE || parent->getSize() == 0)
+            break;
+
+        bool leftSib = parentPos > 0;
+        int sibId = parent->getPointer(leftSib ? parentPos - 1 : parentPos + 1);
+        int keyPos = leftSib ? parentPos : parentPos + 1;
+        string parentKey(parent->getKey(keyPos), keyLength);
+
+        BPTreeNode* sib = new BPTreeNode(filename.c_str(), sibId, keyLength);
+        sib->writeLock();
+        BPTreeNode* left = leftSib ? sib : node;
+        BPTreeNode* right = leftSib ? node : sib;
+        bool merged = left->mergeRight(right, parentKey.data());
+        if (merged)
         {
-            int lim = (order+1)/2 - 1;
-            if (node->getSize() < lim)
-            {
-                if (sib->getSize() > lim)
-                {
-                    // Borrow key from sibling
-                    const char* k = node->borrow(sib, leftSib, parentKey);
-                    memcpy(key, k, keyLength);
-                    ret = BPTREE_CHANGE;
-                }
-                else
-                {
-                    // Merge sibling
-                    if (leftSib)
-                    {
-                        sib->mergeRight(node, parentKey);
-                        removeBlock(id);
-                        node->setRemoved();
-                    }
-                    else
-                    {
-                        node->mergeRight(sib, parentKey);
-                        removeBlock(sibId);
-                        sib->setRemoved();
-                    }
-                    ret = BPTREE_REMOVE;
-                }
-            }
+            removeBlock(leftSib ? ids[level] : sibId);
+            parent->remove(keyPos);
         }
+        else
+            left->redistribute(right, parent, keyPos);
+        sib->writeUnlock();
+        delete sib;
+
+        if (!merged)
+            break;
     }
 
-    delete node;
-    if (sib != NULL)
-        delete sib;
+    for (auto node : path)
+    {
+        node->writeUnlock();
+        delete node;
+    }
     return ret;
 }
 
+// Fill new nodes of a level from children up to limit bytes. Return block ids of new nodes
+// First keys of children are replaced by first keys of new nodes
+vector<int> BPTree::buildLevel(const vector<int>* children, vector<string>* firstKeys, int limit)
+{
+    int childCount = children->size();
+    vector<int> ids;
+    vector<string> nodeKeys;
+    string keys;
+    vector<int> ptrs;
+
+    // Separator of each child is its first key. First child of a node needs no separator
+    for (int first = 0, j = 1; j <= childCount; j++)
+    {
+        int size = ptrs.size();
+        if (
+            j == childCount || (size >= 1 &&
+            BPTreeNode::getPackedSize(keys.data(), firstKeys->at(j).data(), size + 1, keyLength) > limit)
+        )
+        {
+            int id = getFirstEmpty();
+            nodeKeys.push_back(firstKeys->at(first));
+            delete createNode(id, children->at(first), &keys, &ptrs);
+            ids.push_back(id);
+
+            first = j;
+            continue;
+        }
+        keys.append(firstKeys->at(j));
+        ptrs.push_back(children->at(j));
+    }
+
+    firstKeys->swap(nodeKeys);
+    return ids;
+}
+
+// Create node in block from sorted keys and pointers, then clear them. Return new node
+// Leaf is given by a negative first pointer
+BPTreeNode* BPTree::createNode(int id, int firstPtr, string* keys, vector<int>* ptrs)
+{
+    BPTreeNode* node = new BPTreeNode(filename.c_str(), id, keyLength, firstPtr);
+    node->assign(keys->data(), ptrs->data(), ptrs->size());
+    keys->clear();
+    ptrs->clear();
+    return node;
+}
+
 // Get first empty block id
 int BPTree::getFirstEmpty()
 {
     if (firstEmpty < 0)
         return ++nodeCount;
 
+    // Block is pinned while it is read, as other threads may replace blocks
     int ret = firstEmpty;
     BufferManager* manager = MiniSQL::getBufferManager();
-    Block* block = manager->getBlock(filename.c_str(), firstEmpty);
+    Block* block = manager->pinBlock(filename.c_str(), firstEmpty);
     firstEmpty = *(reinterpret_cast<int*>(block->content));
+    block->pin--;
     return ret;
 }
 
 // Remove block in file
 void BPTree::removeBlock(int id)
 {
+    // Block may be cached as rightmost leaf. It is uncached while still held by remover
+    rightLeaf = -1;
+
     BufferManager* manager = MiniSQL::getBufferManager();
-    Block* block = manager->getBlock(filename.c_str(), id);
+    Block* block = manager->pinBlock(filename.c_str(), id);
     memcpy(block->content, &firstEmpty, 4);
+    block->dirty = true;
+    block->pin--;
     firstEmpty = id;
 }
 
-// Update header information
+// Mark header information as modified. It is written back by flushHeader
 void BPTree::updateHeader()
 {
-    BufferManager* manager = MiniSQL::getBufferManager();
-    Block* block = manager->getBlock(filename.c_str(), 0);
-
-    memcpy(block->content + 8, &nodeCount, 4);
-    memcpy(block->content + 12, &root, 4);
-    memcpy(block->content + 16, &firstEmpty, 4);
-
-    block->dirty = true;
+    headerDirty = true;
 }
 
 #ifdef DEBUG
@@ -1,17 +1,36 @@
 #ifndef _BPTREE_H
 #define _BPTREE_H
 
+#include <atomic>
+#include <map>
+#include <mutex>
 #include <vector>
 #include <string>
 
 using namespace std;
 
+class BPTreeNode;
+class KeySorter;
+
+// Finding, adding and removing keys may run in several threads at once
+// They descend optimistically with optimistic lock coupling, and restart if a node changes on the way
+// Splits and merges hold the structure latch and every node they may change
+// Keys beyond the last key are appended to the cached rightmost leaf without descent
+// Cursor and bulk loading are not safe against concurrent writers
+// A buffered tree keeps inserts and deletes as pending messages, and applies them to leaves in key order
+// when the buffer fills or header is flushed. Finding and cursor merge pending messages with leaves
 class BPTree
 {
 public:
 
-    // Create B+ tree file
-    static void createFile(const char* _filename, int _keyLength, int _order = -1);
+    // Version of file format. Files of an older version are laid out differently and must be rebuilt
+    static const int FORMAT_VERSION;
+
+    // Create B+ tree file. Inserts and deletes are buffered if buffered is true
+    static void createFile(const char* _filename, int _keyLength, bool _buffered = false);
+
+    // Get format version of B+ tree file. Files without file tag are written before versioning, and are of version 0
+    static int getFileVersion(const char* _filename);
 
     // Constructor
     BPTree(const char* _filename);
@@ -23,11 +42,48 @@ public:
     int find(const char* _key);
 
     // Add key-value pair. Return true if success
+    // A buffered tree only rejects keys pending insertion. Keys in leaves are rejected when messages are applied
     bool add(const char* _key, int _value);
 
     // Remove key-value pair. Return true if success
+    // A buffered tree records removal without looking for key, and always succeeds
     bool remove(const char* _key);
 
+    // Apply pending messages of buffered tree to leaves in key order
+    void flushMessages();
+
+    // Get length of each key
+    int getKeyLength() const;
+
+    // If inserts and deletes are buffered
+    bool isBuffered() const;
+
+    // Get number of levels, nodes and leaves, and bytes used by all leaves
+    // Pending messages are applied first
+    void analyze(int* height, int* nodes, int* leaves, long long* leafBytes);
+
+    // Load sorted keys into empty tree bottom-up
+    // Each node is filled to fillFactor percent of a block. Return true if success
+    bool bulkLoad(KeySorter* sorter, int fillFactor);
+
+    // Move cursor to the first key not less than lower(greater than lower if not inclusive)
+    // Cursor starts from the smallest key if lower is NULL
+    void seek(const char* lower, bool inclusive);
+
+    // Move cursor forward to the first key not less than lower, which is greater than keys already read
+    // Cursor stays in its leaf if lower is not beyond its last key, and descends from root otherwise
+    void skip(const char* lower);
+
+    // Get key at cursor and move cursor to the next key along the leaves
+    // Return value, or BPTREE_FAILED if cursor reaches the end
+    int next(char* _key);
+
+    // Release leaf held by cursor
+    void closeCursor();
+
+    // Apply pending messages, and write header information back to buffer if it is modified
+    void flushHeader();
+
 #ifdef DEBUG
     // Print tree structure
     void debugPrint();
@@ -37,13 +93,15 @@ private:
 
     // States
     static const int BPTREE_FAILED;
-    static const int BPTREE_NORMAL;
-    static const int BPTREE_ADD;
-    static const int BPTREE_REMOVE;
-    static const int BPTREE_CHANGE;
 
-    // Order of tree
-    int order;
+    // Tag written before format version in header
+    static const int FILE_TAG;
+
+    // Percentage of key-pointers kept by a node on the right edge when an append splits it
+    static const int APPEND_SPLIT_PERCENT;
+
+    // Bytes of keys and values of pending messages kept by a buffered tree before they are applied
+    static const int MESSAGE_BUFFER_SIZE;
 
     // Length of each key
     int keyLength;
@@ -51,27 +109,102 @@ private:
     // Total number of nodes
     int nodeCount;
 
-    // Block id of root
-    int root;
+    // Block id of root. Read by optimistic readers without latch
+    atomic<int> root;
+
+    // Block id of rightmost leaf, or -1 if unknown. Reset before any block is removed
+    atomic<int> rightLeaf;
 
     // First empty block in file
     int firstEmpty;
 
+    // If header information is modified but not written back
+    bool headerDirty;
+
+    // Latch held while tree structure or header information is modified
+    mutex structureLatch;
+
+    // If inserts and deletes are buffered
+    bool buffered;
+
+    // Pending message of a key. Value is BPTREE_FAILED for removal
+    // Insertion replaces key in leaves only if it follows removal of the key
+    struct Message
+    {
+        int value;
+        bool replace;
+    };
+
+    // Pending messages by key
+    map<string, Message> messages;
+
+    // Messages being applied to leaves. They are older than messages
+    map<string, Message> flushing;
+
+    // Latch held while messages or flushing are accessed
+    mutex bufferLatch;
+
+    // Latch held while messages are applied
+    mutex flushLatch;
+
     // Binary file name
     string filename;
 
-    // Key-value to maintain
-    char* key;
-    int value;
+    // Leaf and position of cursor
+    BPTreeNode* cursor;
+    int cursorPos;
+
+    // First pending message not read by cursor
+    map<string, Message>::iterator message;
+
+    // If cursor is open. It is moved again after messages are applied, as they leave its leaf and message
+    bool cursorOpen;
+
+    // Last key read by cursor, or lower bound where it starts if none is read. Empty if it starts from the smallest key
+    string cursorKey;
+
+    // If key equal to cursorKey is still to be read
+    bool cursorInclusive;
+
+    // Descend optimistically to the leaf which may contain key
+    // Return pinned leaf and set its version, or NULL if tree is empty or a node changes on the way
+    BPTreeNode* findLeaf(const char* _key, unsigned int* version);
+
+    // Find value of key in leaves
+    int findDirect(const char* _key);
+
+    // Add key-value pair into leaves. Return true if success
+    bool addDirect(const char* _key, int _value);
+
+    // Remove key-value pair from leaves. Return true if success
+    bool removeDirect(const char* _key);
+
+    // Move open cursor again to where it stopped
+    void reseek();
+
+    // Record pending message of key, which is a removal if value is BPTREE_FAILED
+    // Messages are applied if buffer is full. Return false if key is already pending insertion
+    bool addMessage(const char* _key, int _value);
+
+    // Append key-value pair to rightmost leaf if key is beyond its last key and fits
+    // Return false if key is not appended
+    bool append(const char* _key, int _value);
+
+    // Add key-value pair while holding every node which may split. Return true if success
+    // Nodes on the right edge split unevenly when key goes after all their keys
+    bool addLocked(const char* _key, int _value);
 
-    // Recursive function for finding value
-    int find(int id);
+    // Remove key-value pair while holding the path from root, and merge or rebalance underfull nodes
+    // Key is only looked for merging if it is already removed. Return true if success
+    bool removeLocked(const char* _key, bool removed);
 
-    // Recursive function for adding key-value pair
-    int add(int id);
+    // Fill new nodes of a level from children up to limit bytes. Return block ids of new nodes
+    // First keys of children are replaced by first keys of new nodes
+    vector<int> buildLevel(const vector<int>* children, vector<string>* firstKeys, int limit);
 
-    // Recursive function for deleting key-value pair
-    int remove(int id, int sibId, bool leftSib, const char* parentKey);
+    // Create node in block from sorted keys and pointers, then clear them. Return new node
+    // Leaf is given by a negative first pointer
+    BPTreeNode* createNode(int id, int firstPtr, string* keys, vector<int>* ptrs);
 
     // Get first empty block id
     int getFirstEmpty();
@@ -79,7 +212,7 @@ private:
     // Remove block in file
     void removeBlock(int id);
 
-    // Update header information
+    // Mark header information as modified. It is written back by flushHeader
     void updateHeader();
 
 #ifdef DEBUG
@@ -1,6 +1,9 @@
 #include <cstring>
 #include <iostream>
-#include <algorithm>
+#include <thread>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "global.h"
 #include "minisql.h"
@@ -9,82 +12,67 @@
 
 using namespace std;
 
+// Bytes before the prefix
+const int BPTreeNode::HEADER_SIZE = 16;
+
+// Number of entries left by binary search for a linear scan
+const int BPTreeNode::LINEAR_SEARCH_SIZE = 16;
+
+// Get bytes used by count sorted keys from first to last
+// Common prefix of sorted keys is the common prefix of the first and the last
+int BPTreeNode::getPackedSize(const char* first, const char* last, int count, int keyLength)
+{
+    if (count == 0)
+        return HEADER_SIZE;
+    int prefixLength = getCommonLength(first, last, keyLength);
+    return HEADER_SIZE + prefixLength + count * (keyLength - prefixLength + 4);
+}
+
 // Constructor(from file)
 BPTreeNode::BPTreeNode(
     const char* _filename, int _id, int _keyLength
-): filename(_filename), id(_id), keyLength(_keyLength)
+): keyLength(_keyLength)
 {
     BufferManager* manager = MiniSQL::getBufferManager();
-    Block* block = manager->getBlock(_filename, id);
-    char* data = block->content;
-
-    size = *(reinterpret_cast<int*>(data));
-    keys.push_back(NULL);
-    ptrs.push_back(*(reinterpret_cast<int*>(data + 4)));
-    leaf = ptrs[0] < 0;
-    blockRemoved = false;
-
-    int bias = 8;
-    for (int i = 1; i <= size; i++)
-    {
-        char* k = new char[keyLength];
-        memcpy(k, data + bias, keyLength);
-        keys.push_back(k);
-        ptrs.push_back(*reinterpret_cast<int*>(data + bias + keyLength));
-        bias += keyLength + 4;
-    }
+    block = manager->pinBlock(_filename, _id);
+    keyBuffer = new char[keyLength];
 }
 
 // Constructor(construct an empty node)
 BPTreeNode::BPTreeNode(
-    const char* _filename, int _id, int _keyLength, bool _leaf, int firstPtr
-): filename(_filename), id(_id), keyLength(_keyLength), leaf(_leaf)
+    const char* _filename, int _id, int _keyLength, int firstPtr
+): keyLength(_keyLength)
 {
-    size = 0;
-    keys.push_back(NULL);
-    ptrs.push_back(firstPtr);
-    dirty = true;
-    blockRemoved = false;
+    BufferManager* manager = MiniSQL::getBufferManager();
+    block = manager->pinBlock(_filename, _id);
+    keyBuffer = new char[keyLength];
+
+    // Leaf is marked by a negative first pointer
+    int prefixLength = 0;
+    setSize(0);
+    memcpy(block->content + 4, &firstPtr, 4);
+    setNext(-1);
+    memcpy(block->content + 12, &prefixLength, 4);
 }
 
 // Destructor
 BPTreeNode::~BPTreeNode()
 {
-    // Write modification to block
-    if (dirty && !blockRemoved)
-    {
-        BufferManager* manager = MiniSQL::getBufferManager();
-        Block* block = manager->getBlock(filename.c_str(), id);
-        char* data = block->content;
-
-        // Update size
-        memcpy(data, &size, 4);
-
-        // Update first pointer
-        memcpy(data + 4, &ptrs[0], 4);
-
-        // Update key-pointer
-        int bias = 8;
-        for (int i = 1; i <= size; i++)
-        {
-            memcpy(data + bias, keys[i], keyLength);
-            memcpy(data + bias + keyLength, &ptrs[i], 4);
-            bias += keyLength + 4;
-        }
-
-        block->dirty = true;
-    }
-
-    // Clean up keys
-    for (auto k : keys)
-        if (k != NULL)
-            delete[] k;
+    block->pin--;
+    delete[] keyBuffer;
 }
 
 // Get node size
 int BPTreeNode::getSize() const
 {
-    return size;
+    return *(reinterpret_cast<int*>(block->content));
+}
+
+// Get bytes used in block
+int BPTreeNode::getUsedSize() const
+{
+    int prefixLength = getPrefixLength();
+    return HEADER_SIZE + prefixLength + getSize() * (keyLength - prefixLength + 4);
 }
 
 // Get key length
@@ -96,195 +84,520 @@ int BPTreeNode::getKeyLength() const
 // If node is leaf
 bool BPTreeNode::isLeaf() const
 {
-    return leaf;
+    return *(reinterpret_cast<int*>(block->content + 4)) < 0;
 }
 
-// Get key
+// Get key. Returned key is valid until next call
 const char* BPTreeNode::getKey(int pos) const
 {
-    if (pos > size || pos <= 0)
+    if (pos > getSize() || pos <= 0)
     {
         cerr << "ERROR: [BPTreeNode::getKey] Position " << pos << " out of range!" << endl;
         return NULL;
     }
 
-    return keys[pos];
+    // Prefix and suffix are joined into full key
+    int prefixLength = getPrefixLength();
+    memcpy(keyBuffer, block->content + HEADER_SIZE, prefixLength);
+    memcpy(keyBuffer + prefixLength, getEntry(pos), keyLength - prefixLength);
+    return keyBuffer;
 }
 
 // Get pointer
 int BPTreeNode::getPointer(int pos) const
 {
-    if (pos > size || pos < 0)
+    if (pos > getSize() || pos < 0)
     {
         cerr << "ERROR: [BPTreeNode::getKey] Position " << pos << " out of range!" << endl;
         return -1;
     }
-    return ptrs[pos];
+    if (pos == 0)
+        return *(reinterpret_cast<int*>(block->content + 4));
+    return *(reinterpret_cast<int*>(getEntry(pos) + keyLength - getPrefixLength()));
+}
+
+// Get block id of next leaf
+int BPTreeNode::getNext() const
+{
+    return *(reinterpret_cast<int*>(block->content + 8));
 }
 
 // Find key's position
 int BPTreeNode::findPosition(const char* key) const
 {
-    return upper_bound(
-        keys.begin() + 1, keys.end(), key,
-        [&](const char* a, const char* b) { return memcmp(a, b, keyLength) < 0;}
-    ) - (keys.begin() + 1);
+    // Key without the common prefix is before or after all keys
+    int prefixLength = getPrefixLength();
+    int res = memcmp(key, block->content + HEADER_SIZE, prefixLength);
+    if (res != 0)
+        return res < 0 ? 0 : getSize();
+
+    // Search for number of keys not greater than key by comparing suffixes
+    return countNotGreater(getEntry(1), getSize(), key + prefixLength, keyLength - prefixLength);
 }
 
-// Set key at position
-void BPTreeNode::setKey(int pos, const char* key)
+// Find key's position and the pointer at it without trusting node content
+// Used by optimistic readers, who validate node version afterwards
+// Return position, or -1 if node is seen being changed
+int BPTreeNode::probe(const char* key, int* ptr, bool* found) const
 {
-    if (pos > size || pos <= 0)
+    // Header is read once and checked, so entries are never read out of block
+    int size = getSize();
+    int prefixLength = getPrefixLength();
+    if (prefixLength < 0 || prefixLength > keyLength || size < 0)
+        return -1;
+    int suffixLength = keyLength - prefixLength;
+    if (size > (BLOCK_SIZE - HEADER_SIZE - prefixLength) / (suffixLength + 4))
+        return -1;
+
+    // Same search as findPosition
+    const char* entries = block->content + HEADER_SIZE + prefixLength;
+    int res = memcmp(key, block->content + HEADER_SIZE, prefixLength);
+    int pos = res < 0 ? 0 : size;
+    if (res == 0)
+        pos = countNotGreater(entries, size, key + prefixLength, suffixLength);
+
+    *found = false;
+    *ptr = *(reinterpret_cast<int*>(block->content + 4));
+    if (pos > 0)
     {
-        cerr << "ERROR: [BPTreeNode::setKey] Position " << pos << " out of range!" << endl;
-        return;
+        const char* entry = entries + (pos - 1) * (suffixLength + 4);
+        *found = res == 0 && memcmp(entry, key + prefixLength, suffixLength) == 0;
+        *ptr = *(reinterpret_cast<const int*>(entry + suffixLength));
+    }
+    return pos;
+}
+
+// If any key fits in node, however its prefix changes
+bool BPTreeNode::hasRoom() const
+{
+    return HEADER_SIZE + (getSize() + 1) * (keyLength + 4) <= BLOCK_SIZE;
+}
+
+// Get version of node. Return false if a writer holds the node
+bool BPTreeNode::readLock(unsigned int* version) const
+{
+    *version = block->version.load();
+    return (*version & 1) == 0;
+}
+
+// Check if node is unchanged since version was got
+bool BPTreeNode::validate(unsigned int version) const
+{
+    return block->version.load() == version;
+}
+
+// Hold node for writing if it is unchanged since version was got. Return true if success
+bool BPTreeNode::upgradeLock(unsigned int version)
+{
+    return block->version.compare_exchange_strong(version, version + 1);
+}
+
+// Hold node for writing. Wait until other writer releases it
+void BPTreeNode::writeLock()
+{
+    while (true)
+    {
+        unsigned int version = block->version.load();
+        if ((version & 1) == 0 && block->version.compare_exchange_weak(version, version + 1))
+            return;
+        this_thread::yield();
     }
+}
 
-    dirty = true;
-    memcpy(keys[pos], key, keyLength);
+// Release node held for writing. Its version is advanced
+void BPTreeNode::writeUnlock()
+{
+    block->version++;
 }
 
 // Set pointer at position
 void BPTreeNode::setPointer(int pos, int ptr)
 {
-    if (pos > size || pos < 0)
+    if (pos > getSize() || pos < 0)
     {
         cerr << "ERROR: [BPTreeNode::setPointer] Position " << pos << " out of range!" << endl;
         return;
     }
 
-    dirty = true;
-    ptrs[pos] = ptr;
+    block->dirty = true;
+    if (pos == 0)
+        memcpy(block->content + 4, &ptr, 4);
+    else
+        memcpy(getEntry(pos) + keyLength - getPrefixLength(), &ptr, 4);
+}
+
+// Replace key at position
+// Return false and keep node unchanged if it does not fit
+bool BPTreeNode::setKey(int pos, const char* key)
+{
+    int size = getSize();
+    if (pos > size || pos <= 0)
+    {
+        cerr << "ERROR: [BPTreeNode::setKey] Position " << pos << " out of range!" << endl;
+        return false;
+    }
+
+    // Node is rebuilt, as key may change the common prefix
+    char* keys = new char[size * keyLength];
+    int* ptrs = new int[size];
+    unpack(keys, ptrs);
+    memcpy(keys + (pos - 1) * keyLength, key, keyLength);
+    bool ret = assign(keys, ptrs, size);
+
+    delete[] keys;
+    delete[] ptrs;
+    return ret;
+}
+
+// Set block id of next leaf
+void BPTreeNode::setNext(int _next)
+{
+    block->dirty = true;
+    memcpy(block->content + 8, &_next, 4);
 }
 
-// Set block as removed
-void BPTreeNode::setRemoved()
+// Replace all key-pointers with sorted keys and their pointers
+// Return false and keep node unchanged if they do not fit
+bool BPTreeNode::assign(const char* keys, const int* ptrs, int count)
 {
-    blockRemoved = true;
+    const char* last = keys + (count - 1) * keyLength;
+    if (getPackedSize(keys, last, count, keyLength) > BLOCK_SIZE)
+        return false;
+
+    // Store common prefix once and suffixes in entries
+    int prefixLength = count == 0 ? 0 : getCommonLength(keys, last, keyLength);
+    memcpy(block->content + 12, &prefixLength, 4);
+    memcpy(block->content + HEADER_SIZE, keys, prefixLength);
+    setSize(count);
+
+    int suffixLength = keyLength - prefixLength;
+    char* entry = getEntry(1);
+    for (int i = 0; i < count; i++)
+    {
+        memcpy(entry, keys + i * keyLength + prefixLength, suffixLength);
+        memcpy(entry + suffixLength, &ptrs[i], 4);
+        entry += suffixLength + 4;
+    }
+    return true;
 }
 
 // Insert key-pointer after position
-void BPTreeNode::insert(int pos, const char* key, int ptr)
+// Return false and keep node unchanged if it does not fit
+bool BPTreeNode::insert(int pos, const char* key, int ptr)
 {
+    int size = getSize();
     if (pos > size || pos < 0)
     {
         cerr << "ERROR: [BPTreeNode::insert] Position " << pos << " out of range!" << endl;
-        return;
+        return false;
     }
 
-    dirty = true;
-    char* k = new char[keyLength];
-    memcpy(k, key, keyLength);
-    if (pos == size)
+    int prefixLength = getPrefixLength();
+    if (memcmp(key, block->content + HEADER_SIZE, prefixLength) == 0)
     {
-        keys.push_back(k);
-        ptrs.push_back(ptr);
+        // Key shares the common prefix. Shift latter key-pointers to make room
+        int suffixLength = keyLength - prefixLength;
+        if (getUsedSize() + suffixLength + 4 > BLOCK_SIZE)
+            return false;
+
+        char* entry = getEntry(pos + 1);
+        memmove(entry + suffixLength + 4, entry, (size - pos) * (suffixLength + 4));
+        memmove(entry, key + prefixLength, suffixLength);
+        memcpy(entry + suffixLength, &ptr, 4);
+        setSize(size + 1);
+        return true;
     }
-    else
-    {
-        keys.insert(keys.begin() + pos + 1, k);
-        ptrs.insert(ptrs.begin() + pos + 1, ptr);
-    }
-    size++;
+
+    // Rebuild node with shorter prefix
+    char* keys = new char[(size + 1) * keyLength];
+    int* ptrs = new int[size + 1];
+    unpack(keys, ptrs, pos, key, ptr);
+    bool ret = assign(keys, ptrs, size + 1);
+
+    delete[] keys;
+    delete[] ptrs;
+    return ret;
 }
 
 // Rmove key-pointer at position
 void BPTreeNode::remove(int pos)
 {
+    int size = getSize();
     if (pos > size || pos <= 0)
     {
         cerr << "ERROR: [BPTreeNode::insert] Position " << pos << " out of range!" << endl;
         return;
     }
 
-    dirty = true;
-    if (pos == size)
+    // Remaining keys still share the prefix
+    int entryLength = keyLength - getPrefixLength() + 4;
+    char* entry = getEntry(pos);
+    memmove(entry, entry + entryLength, (size - pos) * entryLength);
+    setSize(size - 1);
+}
+
+// Split into two nodes while inserting key-pointer after position
+// This node keeps about percent of key-pointers, as long as both nodes fit
+// Return new node, or NULL and keep node unchanged if no split fits
+BPTreeNode* BPTreeNode::split(int newId, int pos, const char* key, int ptr, char* newKey, int percent)
+{
+    int count = getSize() + 1;
+    bool leaf = isLeaf();
+    char* keys = new char[count * keyLength];
+    int* ptrs = new int[count];
+    unpack(keys, ptrs, pos, key, ptr);
+
+    int at = findSplit(keys, count, leaf, count * percent / 100);
+    if (at < 0)
     {
-        keys.pop_back();
-        ptrs.pop_back();
+        cerr << "ERROR: [BPTreeNode::split] Cannot split node!" << endl;
+        delete[] keys;
+        delete[] ptrs;
+        return NULL;
     }
-    else
+
+    // Copy latter keys-pointers to new node
+    int rightStart = leaf ? at : at + 1;
+    memcpy(newKey, keys + at * keyLength, keyLength);
+    BPTreeNode* ret = new BPTreeNode(
+        block->filename.c_str(), newId, keyLength, leaf ? -1 : ptrs[at]
+    );
+    ret->assign(keys + rightStart * keyLength, ptrs + rightStart, count - rightStart);
+    assign(keys, ptrs, at);
+
+    // New leaf follows this leaf
+    if (leaf)
     {
-        keys.erase(keys.begin() + pos);
-        ptrs.erase(ptrs.begin() + pos);
+        ret->setNext(getNext());
+        setNext(newId);
     }
-    size--;
+
+    delete[] keys;
+    delete[] ptrs;
+    return ret;
 }
 
-// Split into two nodes. Return new node
-BPTreeNode* BPTreeNode::split(int newId, char* newKey)
+// Merge right sibling. Return false and keep nodes unchanged if result does not fit
+bool BPTreeNode::mergeRight(BPTreeNode* sib, const char* parentKey)
 {
-    dirty = true;
+    bool leaf = isLeaf();
+    int size = getSize(), sibSize = sib->getSize();
+    int count = size + sibSize + (leaf ? 0 : 1);
+    char* keys = new char[count * keyLength];
+    int* ptrs = new int[count];
+
+    // Parent key leads first pointer of sibling in internal node
+    unpack(keys, ptrs);
+    if (!leaf)
+    {
+        memcpy(keys + size * keyLength, parentKey, keyLength);
+        ptrs[size++] = sib->getPointer(0);
+    }
+    sib->unpack(keys + size * keyLength, ptrs + size);
 
-    int pos = size/2 + (leaf ? 0 : 1);
-    memcpy(newKey, keys[size/2 + 1], keyLength);
-    BPTreeNode* ret = new BPTreeNode(filename.c_str(), newId, keyLength, leaf, leaf ? -1 : ptrs[pos]);
+    bool ret = assign(keys, ptrs, count);
+    if (ret && leaf)
+        setNext(sib->getNext());
 
-    // Copy former half of keys-pointers to new node
-    for (pos++; pos <= size; pos++)
-        ret->insert(ret->getSize(), keys[pos], ptrs[pos]);
+    delete[] keys;
+    delete[] ptrs;
+    return ret;
+}
 
-    size /= 2;
-    keys.resize(size + 1);
-    ptrs.resize(size + 1);
+// Share key-pointers evenly with right sibling, and replace their separator at position of parent
+// Return false and keep nodes unchanged if they do not fit
+bool BPTreeNode::redistribute(BPTreeNode* sib, BPTreeNode* parent, int keyPos)
+{
+    bool leaf = isLeaf();
+    int size = getSize(), sibSize = sib->getSize();
+    int count = size + sibSize + (leaf ? 0 : 1);
+    char* keys = new char[count * keyLength];
+    int* ptrs = new int[count];
+
+    // Key-pointers are joined as in mergeRight, then split again at the middle
+    unpack(keys, ptrs);
+    if (!leaf)
+    {
+        memcpy(keys + size * keyLength, parent->getKey(keyPos), keyLength);
+        ptrs[size++] = sib->getPointer(0);
+    }
+    sib->unpack(keys + size * keyLength, ptrs + size);
+
+    // Parent is changed first, as new separator may not share its prefix
+    int at = findSplit(keys, count, leaf, count / 2);
+    bool ret = at >= 0 && parent->setKey(keyPos, keys + at * keyLength);
+    if (ret)
+    {
+        int rightStart = leaf ? at : at + 1;
+        if (!leaf)
+            sib->setPointer(0, ptrs[at]);
+        sib->assign(keys + rightStart * keyLength, ptrs + rightStart, count - rightStart);
+        assign(keys, ptrs, at);
+    }
 
+    delete[] keys;
+    delete[] ptrs;
     return ret;
 }
 
-// Borrow a key from sibling. Return new parent key
-const char* BPTreeNode::borrow(BPTreeNode* sib, bool leftSib, const char* parentKey)
+// Get length of common prefix of two keys
+int BPTreeNode::getCommonLength(const char* a, const char* b, int length)
 {
-    dirty = true;
+    int i = 0;
+    while (i < length && a[i] == b[i])
+        i++;
+    return i;
+}
 
-    if (leftSib)
+// Count entries whose suffix is not greater than suffix
+// Suffixes up to 4 bytes are compared as integers. Binary search leaves a few of them to a linear scan,
+// which compares four at a time if SSE2 is available
+int BPTreeNode::countNotGreater(const char* entries, int size, const char* suffix, int suffixLength)
+{
+    int stride = suffixLength + 4;
+    int lo = 0, hi = size;
+    if (suffixLength > 4)
     {
-        // Borrow from left sibling
-        int sibSize = sib->getSize();
-        const char* sibKey = sib->getKey(sibSize);
-        int sibPtr = sib->getPointer(sibSize);
-        sib->remove(sibSize);
-
-        if (leaf)
-            insert(0, sibKey, sibPtr);
-        else
+        while (lo < hi)
         {
-            int ptr = ptrs[0];
-            ptrs[0] = sibPtr;
-            insert(0, parentKey, ptr);
+            int mid = (lo + hi) / 2;
+            if (memcmp(entries + mid * stride, suffix, suffixLength) <= 0)
+                lo = mid + 1;
+            else
+                hi = mid;
         }
-
-        return sibKey;
+        return lo;
     }
-    else
+
+    // Suffix followed by zeros compares like its bytes. Bytes of pointer after a short suffix are masked off
+    unsigned int mask = suffixLength == 0 ? 0 : 0xffffffffu << (32 - suffixLength * 8);
+    unsigned int target = 0;
+    for (int i = 0; i < 4; i++)
+        target = target << 8 | (i < suffixLength ? (unsigned char)suffix[i] : 0);
+
+    while (hi - lo > LINEAR_SEARCH_SIZE)
     {
-        // Borrow from right sibling
-        const char* sibKey = sib->getKey(1);
-        int sibPtr0 = sib->getPointer(0);
-        int sibPtr1 = sib->getPointer(1);
-        sib->remove(1);
+        int mid = (lo + hi) / 2;
+        if (readSuffix(entries + mid * stride, mask) <= target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
 
-        if (leaf)
+    // Entries are sorted, so the number not greater than target is added to lo
+    int count = lo;
+#ifdef __SSE2__
+    // Flipping sign bits lets signed compares of SSE2 order integers as unsigned
+    // Lanes greater than target are all ones, and are counted by subtracting them
+    const __m128i flip = _mm_set1_epi32(0x80000000);
+    const __m128i limit = _mm_set1_epi32(target ^ 0x80000000);
+    __m128i greater = _mm_setzero_si128();
+    int start = lo;
+    for (; lo + 4 <= hi; lo += 4)
+    {
+        const char* entry = entries + lo * stride;
+        __m128i words;
+        if (stride == 8)
         {
-            insert(size, sibKey, sibPtr1);
-            return sib->getKey(1);
+            // Suffixes of four 8-byte entries are gathered from two loads, and their bytes are reversed
+            __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(entry));
+            __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(entry + 16));
+            words = _mm_unpacklo_epi64(
+                _mm_shuffle_epi32(first, _MM_SHUFFLE(0, 0, 2, 0)),
+                _mm_shuffle_epi32(second, _MM_SHUFFLE(0, 0, 2, 0))
+            );
+            words = _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+            words = _mm_or_si128(_mm_slli_epi32(words, 16), _mm_srli_epi32(words, 16));
         }
         else
-        {
-            sib->setPointer(0, sibPtr1);
-            insert(size, parentKey, sibPtr0);
-            return sibKey;
-        }
+            words = _mm_setr_epi32(
+                readSuffix(entry, mask), readSuffix(entry + stride, mask),
+                readSuffix(entry + stride * 2, mask), readSuffix(entry + stride * 3, mask)
+            );
+        greater = _mm_sub_epi32(greater, _mm_cmpgt_epi32(_mm_xor_si128(words, flip), limit));
     }
+    int lanes[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), greater);
+    count += lo - start - (lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#endif
+    for (; lo < hi; lo++)
+        count += readSuffix(entries + lo * stride, mask) <= target;
+    return count;
 }
 
-// Merge right sibling
-void BPTreeNode::mergeRight(BPTreeNode* sib, const char* parentKey)
+// Read first 4 bytes of entry as a big-endian integer, and keep bits of mask
+unsigned int BPTreeNode::readSuffix(const char* entry, unsigned int mask)
 {
-    dirty = true;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(entry);
+    return ((unsigned int)bytes[0] << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3]) & mask;
+}
 
-    int sibSize = sib->getSize();
-    if (!leaf)
-        insert(size, parentKey, sib->getPointer(0));
-    for (int i = 1; i <= sibSize; i++)
-        insert(size, sib->getKey(i), sib->getPointer(i));
+// Get length of common prefix
+int BPTreeNode::getPrefixLength() const
+{
+    return *(reinterpret_cast<int*>(block->content + 12));
+}
+
+// Get start of key-pointer at position
+char* BPTreeNode::getEntry(int pos) const
+{
+    int prefixLength = getPrefixLength();
+    return block->content + HEADER_SIZE + prefixLength + (pos - 1) * (keyLength - prefixLength + 4);
+}
+
+// Set node size
+void BPTreeNode::setSize(int size)
+{
+    block->dirty = true;
+    memcpy(block->content, &size, 4);
+}
+
+// Find point nearest to target splitting sorted keys into two nodes that fit
+// Key at split point moves up if node is not leaf. Return -1 if no split fits
+int BPTreeNode::findSplit(const char* keys, int count, bool leaf, int target) const
+{
+    // A key outside the common prefix may need an uneven split
+    auto fits = [&](int at) -> bool
+    {
+        int rightStart = leaf ? at : at + 1;
+        if (at < (leaf ? 1 : 0) || rightStart >= count + (leaf ? 0 : 1))
+            return false;
+        return
+            getPackedSize(keys, keys + (at - 1) * keyLength, at, keyLength) <= BLOCK_SIZE &&
+            getPackedSize(
+                keys + rightStart * keyLength, keys + (count - 1) * keyLength,
+                count - rightStart, keyLength
+            ) <= BLOCK_SIZE;
+    };
+
+    for (int d = 0; d <= count; d++)
+    {
+        if (fits(target - d))
+            return target - d;
+        if (fits(target + d))
+            return target + d;
+    }
+    return -1;
+}
+
+// Copy all keys and their pointers out of node
+void BPTreeNode::unpack(char* keys, int* ptrs) const
+{
+    int size = getSize();
+    for (int i = 1; i <= size; i++)
+    {
+        memcpy(keys + (i - 1) * keyLength, getKey(i), keyLength);
+        ptrs[i - 1] = getPointer(i);
+    }
+}
+
+// Copy all keys and their pointers out of node with key-pointer inserted after position
+void BPTreeNode::unpack(char* keys, int* ptrs, int pos, const char* key, int ptr) const
+{
+    int size = getSize();
+    unpack(keys, ptrs);
+    memmove(keys + (pos + 1) * keyLength, keys + pos * keyLength, (size - pos) * keyLength);
+    memmove(ptrs + pos + 1, ptrs + pos, (size - pos) * 4);
+    memcpy(keys + pos * keyLength, key, keyLength);
+    ptrs[pos] = ptr;
 }
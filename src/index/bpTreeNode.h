@@ -1,18 +1,27 @@
 #ifndef _BPTREE_NODE_H
 #define _BPTREE_NODE_H
 
-#include <vector>
-#include <string>
+#include "global.h"
 
 using namespace std;
 
+// B+ tree node working directly on its pinned block
+// Block layout: [size][ptr0][next][prefixLength][prefix][suffix1][ptr1][suffix2][ptr2]...
+// Keys of a node share a common prefix which is stored once, so node fanout varies with keys
+// Version latch of the block guards the node. Writers hold it, while readers validate it
 class BPTreeNode
 {
 public:
 
+    // Bytes before the prefix
+    static const int HEADER_SIZE;
+
+    // Get bytes used by count sorted keys from first to last
+    static int getPackedSize(const char* first, const char* last, int count, int keyLength);
+
     // Constructor
     BPTreeNode(const char* _filename, int _id, int _keyLength);
-    BPTreeNode(const char* _filename, int _id, int _keyLength, bool _leaf, int firstPtr);
+    BPTreeNode(const char* _filename, int _id, int _keyLength, int firstPtr);
 
     // Destructor
     ~BPTreeNode();
@@ -20,74 +29,126 @@ public:
     // Get node size
     int getSize() const;
 
+    // Get bytes used in block
+    int getUsedSize() const;
+
     // Get key length
     int getKeyLength() const;
 
     // If node is leaf
     bool isLeaf() const;
 
-    // Get key
+    // Get key. Returned key is valid until next call
     const char* getKey(int pos) const;
 
     // Get pointer
     int getPointer(int pos) const;
 
+    // Get block id of next leaf
+    int getNext() const;
+
     // Find key's position
     int findPosition(const char* key) const;
 
-    // Set key at position
-    void setKey(int pos, const char* key);
+    // Find key's position and the pointer at it without trusting node content
+    // Used by optimistic readers, who validate node version afterwards
+    // Return position, or -1 if node is seen being changed
+    int probe(const char* key, int* ptr, bool* found) const;
+
+    // If any key fits in node, however its prefix changes
+    bool hasRoom() const;
+
+    // Get version of node. Return false if a writer holds the node
+    bool readLock(unsigned int* version) const;
+
+    // Check if node is unchanged since version was got
+    bool validate(unsigned int version) const;
+
+    // Hold node for writing if it is unchanged since version was got. Return true if success
+    bool upgradeLock(unsigned int version);
+
+    // Hold node for writing. Wait until other writer releases it
+    void writeLock();
+
+    // Release node held for writing. Its version is advanced
+    void writeUnlock();
 
     // Set pointer at position
     void setPointer(int pos, int ptr);
 
-    // Set the block as removed
-    void setRemoved();
+    // Replace key at position
+    // Return false and keep node unchanged if it does not fit
+    bool setKey(int pos, const char* key);
+
+    // Set block id of next leaf
+    void setNext(int _next);
+
+    // Replace all key-pointers with sorted keys and their pointers
+    // Return false and keep node unchanged if they do not fit
+    bool assign(const char* keys, const int* ptrs, int count);
 
     // Insert key-pointer after position
-    void insert(int pos, const char* key, int ptr);
+    // Return false and keep node unchanged if it does not fit
+    bool insert(int pos, const char* key, int ptr);
 
     // Remove key-pointer at position
     void remove(int pos);
 
-    // Split into two nodes. Return new node
-    BPTreeNode* split(int newId, char* newKey);
+    // Split into two nodes while inserting key-pointer after position
+    // This node keeps about percent of key-pointers, as long as both nodes fit
+    // Return new node, or NULL and keep node unchanged if no split fits
+    BPTreeNode* split(int newId, int pos, const char* key, int ptr, char* newKey, int percent = 50);
 
-    // Borrow a key from sibling. Return new parent key
-    const char* borrow(BPTreeNode* sib, bool leftSib, const char* parentKey);
+    // Merge right sibling. Return false and keep nodes unchanged if result does not fit
+    bool mergeRight(BPTreeNode* sib, const char* parentKey);
 
-    // Merge right sibling
-    void mergeRight(BPTreeNode* sib, const char* parentKey);
+    // Share key-pointers evenly with right sibling, and replace their separator at position of parent
+    // Return false and keep nodes unchanged if they do not fit
+    bool redistribute(BPTreeNode* sib, BPTreeNode* parent, int keyPos);
 
 private:
 
-    // Node filename
-    string filename;
+    // Number of entries left by binary search for a linear scan
+    static const int LINEAR_SEARCH_SIZE;
+
+    // Get length of common prefix of two keys
+    static int getCommonLength(const char* a, const char* b, int length);
 
-    // Block id in file
-    int id;
+    // Count entries whose suffix is not greater than suffix
+    // Suffixes up to 4 bytes are compared as integers. Binary search leaves a few of them to a linear scan,
+    // which compares four at a time if SSE2 is available
+    static int countNotGreater(const char* entries, int size, const char* suffix, int suffixLength);
 
-    // Node size
-    int size;
+    // Read first 4 bytes of entry as a big-endian integer, and keep bits of mask
+    static unsigned int readSuffix(const char* entry, unsigned int mask);
+
+    // Pinned block of node
+    Block* block;
 
     // Length of each key
     int keyLength;
 
-    // If node is leaf
-    bool leaf;
+    // Buffer of key returned by getKey
+    char* keyBuffer;
+
+    // Get length of common prefix
+    int getPrefixLength() const;
+
+    // Get start of key-pointer at position
+    char* getEntry(int pos) const;
 
-    // If node has been modified
-    bool dirty;
+    // Set node size
+    void setSize(int size);
 
-    // If block has been removed
-    bool blockRemoved;
-    
-    // Node keys
-    vector<char*> keys;
+    // Find point nearest to target splitting sorted keys into two nodes that fit
+    // Key at split point moves up if node is not leaf. Return -1 if no split fits
+    int findSplit(const char* keys, int count, bool leaf, int target) const;
 
-    // Node pointers
-    vector<int> ptrs;
+    // Copy all keys and their pointers out of node
+    void unpack(char* keys, int* ptrs) const;
 
+    // Copy all keys and their pointers out of node with key-pointer inserted after position
+    void unpack(char* keys, int* ptrs, int pos, const char* key, int ptr) const;
 };
 
 #endif
@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "global.h"
+#include "minisql.h"
+#include "buffer/bufferManager.h"
+#include "index/hashIndex.h"
+
+using namespace std;
+
+// Max number of hash bits used by directory
+// Ids of directory blocks must fit in file header
+const int HashIndex::MAX_GLOBAL_DEPTH = 18;
+
+// Bytes before the first entry of a bucket
+const int HashIndex::BUCKET_HEADER_SIZE = 12;
+
+// Bytes before directory block ids in file header
+const int HashIndex::HEADER_SIZE = 24;
+
+// Create hash index file
+void HashIndex::createFile(const char* _filename, int _keyLength, int _hashLength)
+{
+    // Header is followed by an empty bucket and a directory pointing to it
+    FILE* file = fopen(("data/" + string(_filename) + ".mdb").c_str(), "wb");
+    char data[BLOCK_SIZE] = {0};
+    int header[] = {_keyLength, _hashLength, 0, 2, -1, 1, 2};
+    memcpy(data, header, sizeof(header));
+    fwrite(data, BLOCK_SIZE, 1, file);
+
+    memset(data, 0, BLOCK_SIZE);
+    fwrite(data, BLOCK_SIZE, 1, file);
+
+    int firstBucket = 1;
+    memcpy(data, &firstBucket, 4);
+    fwrite(data, BLOCK_SIZE, 1, file);
+    fclose(file);
+}
+
+// Constructor
+HashIndex::HashIndex(const char* _filename): filename(_filename)
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    Block* header = manager->getBlock(_filename, 0);
+
+    // Get header information
+    keyLength = *(reinterpret_cast<int*>(header->content));
+    hashLength = *(reinterpret_cast<int*>(header->content + 4));
+    globalDepth = *(reinterpret_cast<int*>(header->content + 8));
+    nodeCount = *(reinterpret_cast<int*>(header->content + 12));
+    firstEmpty = *(reinterpret_cast<int*>(header->content + 16));
+    int dirBlockCount = *(reinterpret_cast<int*>(header->content + 20));
+    dirBlocks.resize(dirBlockCount);
+    memcpy(dirBlocks.data(), header->content + HEADER_SIZE, dirBlockCount * 4);
+
+    // Load directory
+    int slotCount = 1 << globalDepth;
+    int slotBlockCount = BLOCK_SIZE / 4;
+    directory.resize(slotCount);
+    for (int i = 0; i < slotCount; i += slotBlockCount)
+    {
+        Block* block = manager->getBlock(_filename, dirBlocks[i / slotBlockCount]);
+        memcpy(&directory[i], block->content, min(slotBlockCount, slotCount - i) * 4);
+    }
+    dirDirty.resize(dirBlockCount, 0);
+
+    bucketCapacity = (BLOCK_SIZE - BUCKET_HEADER_SIZE) / (keyLength + 4);
+    headerDirty = false;
+}
+
+// Find values of keys whose first hashLength bytes equal those of key
+// Keys found are also returned if keys is not NULL. Return number of values found
+int HashIndex::find(const char* _key, vector<int>* values, vector<string>* keys)
+{
+    int findCount = 0;
+    int id = getBucketId(hash(_key));
+
+    // Walk along bucket chain
+    while (id > 0)
+    {
+        Block* block = getBucket(id);
+        int* info = reinterpret_cast<int*>(block->content);
+        const char* entry = block->content + BUCKET_HEADER_SIZE;
+        for (int i = 0; i < info[0]; i++, entry += keyLength + 4)
+            if (memcmp(entry, _key, hashLength) == 0)
+            {
+                values->push_back(*(reinterpret_cast<const int*>(entry + keyLength)));
+                if (keys != NULL)
+                    keys->push_back(string(entry, keyLength));
+                findCount++;
+            }
+        id = info[2];
+    }
+    return findCount;
+}
+
+// Add key-value pair. Return true if success
+bool HashIndex::add(const char* _key, int _value)
+{
+    unsigned int h = hash(_key);
+    while (true)
+    {
+        // Check for duplicate and find the first bucket with room along chain
+        int first = getBucketId(h), last = first, room = -1;
+        for (int id = first; id > 0; )
+        {
+            Block* block = getBucket(id);
+            int* info = reinterpret_cast<int*>(block->content);
+            const char* entry = block->content + BUCKET_HEADER_SIZE;
+            for (int i = 0; i < info[0]; i++, entry += keyLength + 4)
+                if (memcmp(entry, _key, keyLength) == 0)
+                    return false;
+
+            if (room < 0 && info[0] < bucketCapacity)
+                room = id;
+            last = id;
+            id = info[2];
+        }
+
+        if (room < 0)
+        {
+            // Chain is full. Split it if its keys differ in hash
+            int depth = reinterpret_cast<int*>(getBucket(first)->content)[1];
+            if (depth < MAX_GLOBAL_DEPTH && !isSameHash(first, h))
+            {
+                split(first, h);
+                continue;
+            }
+
+            // Keys with equal hash go to a new overflow bucket
+            room = getFirstEmpty();
+            int info[] = {0, depth, 0};
+            Block* block = getBucket(room);
+            memcpy(block->content, info, BUCKET_HEADER_SIZE);
+            block->dirty = true;
+
+            block = getBucket(last);
+            memcpy(block->content + 8, &room, 4);
+            block->dirty = true;
+        }
+
+        // Append key-value to bucket
+        Block* block = getBucket(room);
+        int* info = reinterpret_cast<int*>(block->content);
+        char* entry = block->content + BUCKET_HEADER_SIZE + info[0] * (keyLength + 4);
+        memcpy(entry, _key, keyLength);
+        memcpy(entry + keyLength, &_value, 4);
+        info[0]++;
+        block->dirty = true;
+        return true;
+    }
+}
+
+// Remove key-value pair. Return true if success
+bool HashIndex::remove(const char* _key)
+{
+    int entryLength = keyLength + 4;
+    for (int id = getBucketId(hash(_key)), prev = -1; id > 0; )
+    {
+        Block* block = getBucket(id);
+        int* info = reinterpret_cast<int*>(block->content);
+        char* entry = block->content + BUCKET_HEADER_SIZE;
+        for (int i = 0; i < info[0]; i++, entry += entryLength)
+        {
+            if (memcmp(entry, _key, keyLength) != 0)
+                continue;
+
+            // Last entry of bucket takes place of removed one
+            info[0]--;
+            memmove(entry, block->content + BUCKET_HEADER_SIZE + info[0] * entryLength, entryLength);
+            block->dirty = true;
+
+            // Empty overflow bucket is unlinked from chain
+            if (info[0] == 0 && prev > 0)
+            {
+                int next = info[2];
+                Block* prevBlock = getBucket(prev);
+                memcpy(prevBlock->content + 8, &next, 4);
+                prevBlock->dirty = true;
+                removeBlock(id);
+            }
+            return true;
+        }
+        prev = id;
+        id = info[2];
+    }
+    return false;
+}
+
+// Get length of each key
+int HashIndex::getKeyLength() const
+{
+    return keyLength;
+}
+
+// Write header information and directory back to buffer if they are modified
+void HashIndex::flushHeader()
+{
+    if (!headerDirty)
+        return;
+
+    BufferManager* manager = MiniSQL::getBufferManager();
+
+    // Grown directory gets new blocks
+    while (dirBlocks.size() < dirDirty.size())
+        dirBlocks.push_back(getFirstEmpty());
+
+    int slotCount = directory.size();
+    int slotBlockCount = BLOCK_SIZE / 4;
+    for (int i = 0; i < (int)dirBlocks.size(); i++)
+    {
+        if (!dirDirty[i])
+            continue;
+        Block* block = manager->getBlock(filename.c_str(), dirBlocks[i]);
+        int start = i * slotBlockCount;
+        memcpy(block->content, &directory[start], min(slotBlockCount, slotCount - start) * 4);
+        block->dirty = true;
+        dirDirty[i] = 0;
+    }
+
+    Block* block = manager->getBlock(filename.c_str(), 0);
+    int header[] = {keyLength, hashLength, globalDepth, nodeCount, firstEmpty, (int)dirBlocks.size()};
+    memcpy(block->content, header, HEADER_SIZE);
+    memcpy(block->content + HEADER_SIZE, dirBlocks.data(), dirBlocks.size() * 4);
+
+    block->dirty = true;
+    headerDirty = false;
+}
+
+// Hash first hashLength bytes of key
+unsigned int HashIndex::hash(const char* _key) const
+{
+    // FNV-1a followed by a 32-bit finalizer, as directory uses the low bits
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < hashLength; i++)
+    {
+        h ^= (unsigned char)_key[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// Get bucket id of hash value
+int HashIndex::getBucketId(unsigned int h) const
+{
+    return directory[h & ((1u << globalDepth) - 1)];
+}
+
+// Get block of bucket
+Block* HashIndex::getBucket(int id)
+{
+    return MiniSQL::getBufferManager()->getBlock(filename.c_str(), id);
+}
+
+// Point directory slot to bucket
+void HashIndex::setSlot(int slot, int id)
+{
+    directory[slot] = id;
+    dirDirty[slot / (BLOCK_SIZE / 4)] = 1;
+    headerDirty = true;
+}
+
+// Check if all keys in bucket chain have hash value h
+bool HashIndex::isSameHash(int id, unsigned int h)
+{
+    while (id > 0)
+    {
+        Block* block = getBucket(id);
+        int* info = reinterpret_cast<int*>(block->content);
+        const char* entry = block->content + BUCKET_HEADER_SIZE;
+        for (int i = 0; i < info[0]; i++, entry += keyLength + 4)
+            if (hash(entry) != h)
+                return false;
+        id = info[2];
+    }
+    return true;
+}
+
+// Split bucket chain reached by hash value h into two by the next hash bit
+void HashIndex::split(int id, unsigned int h)
+{
+    // Collect entries of chain and free its overflow buckets
+    int entryLength = keyLength + 4;
+    int depth = reinterpret_cast<int*>(getBucket(id)->content)[1];
+    string entries;
+    for (int cur = id; cur > 0; )
+    {
+        Block* block = getBucket(cur);
+        int* info = reinterpret_cast<int*>(block->content);
+        entries.append(block->content + BUCKET_HEADER_SIZE, info[0] * entryLength);
+        int next = info[2];
+        if (cur != id)
+            removeBlock(cur);
+        cur = next;
+    }
+
+    // Double directory if bucket uses all hash bits
+    if (depth == globalDepth)
+    {
+        int slotCount = directory.size();
+        directory.resize(slotCount * 2);
+        copy(directory.begin(), directory.begin() + slotCount, directory.begin() + slotCount);
+        globalDepth++;
+        dirDirty.assign((slotCount * 2 * 4 + BLOCK_SIZE - 1) / BLOCK_SIZE, 1);
+        headerDirty = true;
+    }
+
+    // Slots of bucket with the next bit set point to new bucket
+    int newId = getFirstEmpty();
+    int slotCount = directory.size();
+    int low = h & ((1u << depth) - 1);
+    for (int slot = low | (1 << depth); slot < slotCount; slot += 2 << depth)
+        setSlot(slot, newId);
+
+    // Redistribute entries by the next bit
+    string left, right;
+    for (int i = 0; i < (int)entries.size(); i += entryLength)
+    {
+        if (hash(&entries[i]) >> depth & 1)
+            right.append(entries, i, entryLength);
+        else
+            left.append(entries, i, entryLength);
+    }
+    fill(id, depth + 1, &left);
+    fill(newId, depth + 1, &right);
+}
+
+// Write entries into bucket chain starting from bucket id
+void HashIndex::fill(int id, int depth, const string* entries)
+{
+    int entryLength = keyLength + 4;
+    int count = entries->size() / entryLength;
+    for (int pos = 0; ; )
+    {
+        int size = min(count - pos, bucketCapacity);
+        int info[] = {size, depth, 0};
+        Block* block = getBucket(id);
+        memcpy(block->content, info, BUCKET_HEADER_SIZE);
+        memcpy(block->content + BUCKET_HEADER_SIZE, entries->data() + pos * entryLength, size * entryLength);
+        block->dirty = true;
+
+        pos += size;
+        if (pos >= count)
+            return;
+
+        // Rest of entries go to overflow bucket
+        block->pin++;
+        int next = getFirstEmpty();
+        memcpy(block->content + 8, &next, 4);
+        block->pin--;
+        id = next;
+    }
+}
+
+// Get first empty block id
+int HashIndex::getFirstEmpty()
+{
+    headerDirty = true;
+    if (firstEmpty < 0)
+        return ++nodeCount;
+
+    int ret = firstEmpty;
+    Block* block = getBucket(firstEmpty);
+    firstEmpty = *(reinterpret_cast<int*>(block->content));
+    return ret;
+}
+
+// Remove block in file
+void HashIndex::removeBlock(int id)
+{
+    Block* block = getBucket(id);
+    memcpy(block->content, &firstEmpty, 4);
+    block->dirty = true;
+    firstEmpty = id;
+    headerDirty = true;
+}
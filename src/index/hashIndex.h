@@ -0,0 +1,113 @@
+#ifndef _HASH_INDEX_H
+#define _HASH_INDEX_H
+
+#include <vector>
+#include <string>
+
+#include "global.h"
+
+using namespace std;
+
+// Extendible hash index. Directory of bucket ids is kept in memory and written back lazily
+// Keys are hashed by their first hashLength bytes, so keys sharing them lie in one bucket
+// Bucket layout: [size][localDepth][overflow][key1][value1][key2][value2]...
+// Keys with equal hash which overflow a bucket are chained in overflow buckets
+class HashIndex
+{
+public:
+
+    // Max number of hash bits used by directory
+    static const int MAX_GLOBAL_DEPTH;
+
+    // Create hash index file
+    static void createFile(const char* _filename, int _keyLength, int _hashLength);
+
+    // Constructor
+    HashIndex(const char* _filename);
+
+    // Find values of keys whose first hashLength bytes equal those of key
+    // Keys found are also returned if keys is not NULL. Return number of values found
+    int find(const char* _key, vector<int>* values, vector<string>* keys = NULL);
+
+    // Add key-value pair. Return true if success
+    bool add(const char* _key, int _value);
+
+    // Remove key-value pair. Return true if success
+    bool remove(const char* _key);
+
+    // Get length of each key
+    int getKeyLength() const;
+
+    // Write header information and directory back to buffer if they are modified
+    void flushHeader();
+
+private:
+
+    // Bytes before the first entry of a bucket
+    static const int BUCKET_HEADER_SIZE;
+
+    // Bytes before directory block ids in file header
+    static const int HEADER_SIZE;
+
+    // Binary file name
+    string filename;
+
+    // Length of each key
+    int keyLength;
+
+    // Number of leading key bytes hashed
+    int hashLength;
+
+    // Number of entries in a bucket
+    int bucketCapacity;
+
+    // Number of hash bits used by directory
+    int globalDepth;
+
+    // Total number of blocks
+    int nodeCount;
+
+    // First empty block in file
+    int firstEmpty;
+
+    // Bucket id of each directory slot
+    vector<int> directory;
+
+    // Blocks holding directory
+    vector<int> dirBlocks;
+
+    // If each directory block is modified but not written back
+    vector<char> dirDirty;
+
+    // If header information is modified but not written back
+    bool headerDirty;
+
+    // Hash first hashLength bytes of key
+    unsigned int hash(const char* _key) const;
+
+    // Get bucket id of hash value
+    int getBucketId(unsigned int h) const;
+
+    // Get block of bucket
+    Block* getBucket(int id);
+
+    // Point directory slot to bucket
+    void setSlot(int slot, int id);
+
+    // Check if all keys in bucket chain have hash value h
+    bool isSameHash(int id, unsigned int h);
+
+    // Split bucket chain reached by hash value h into two by the next hash bit
+    void split(int id, unsigned int h);
+
+    // Write entries into bucket chain starting from bucket id
+    void fill(int id, int depth, const string* entries);
+
+    // Get first empty block id
+    int getFirstEmpty();
+
+    // Remove block in file
+    void removeBlock(int id);
+};
+
+#endif
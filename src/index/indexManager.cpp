@@ -1,5 +1,8 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <thread>
 
 #include "struct/index.h"
 #include "struct/table.h"
@@ -10,43 +13,432 @@
 #include "catalog/catalogManager.h"
 #include "index/indexManager.h"
 
-// Find key in index. Return record id
-int IndexManager::find(const char* indexName, const char* key)
+// Default percentage of each node filled by bulk loading
+// Some space is left so that following inserts do not split every leaf
+const int IndexManager::DEFAULT_FILL_FACTOR = 90;
+
+// Max number of open indices
+const int IndexManager::MAX_TREE_COUNT = 32;
+
+// Max number of threads building an index
+const int IndexManager::MAX_THREAD_COUNT = 64;
+
+// Number of buckets in histogram of analyzed index
+const int IndexManager::HISTOGRAM_SIZE = 32;
+
+// Max megabytes of memory taken by mirrors of all open indices
+const int IndexManager::MAX_CACHE_SIZE = 65536;
+
+// Constructor
+// Indices are built by one thread on each core by default
+IndexManager::IndexManager()
+{
+    fillFactor = DEFAULT_FILL_FACTOR;
+    threadCount = min(max((int)thread::hardware_concurrency(), 1), MAX_THREAD_COUNT);
+    useCount = 0;
+    cacheSize = 0;
+}
+
+// Destructor
+IndexManager::~IndexManager()
+{
+    checkpoint();
+    for (auto& item : handles)
+    {
+        delete item.second.tree;
+        delete item.second.hash;
+        delete item.second.bitmap;
+        delete item.second.mirror;
+    }
+}
+
+// Write headers of all open indices back to buffer
+void IndexManager::checkpoint()
 {
-    BPTree* tree = new BPTree(("index/" + string(indexName)).c_str());
-    int ret = tree->find(key);
-    delete tree;
-    return ret;
+    for (auto& item : handles)
+    {
+        if (item.second.tree != NULL)
+            item.second.tree->flushHeader();
+        else if (item.second.hash != NULL)
+            item.second.hash->flushHeader();
+        else
+            item.second.bitmap->flushHeader();
+    }
+}
+
+// Set percentage of each node filled by bulk loading
+void IndexManager::setFillFactor(int _fillFactor)
+{
+    fillFactor = _fillFactor;
+}
+
+// Get number of threads building an index
+int IndexManager::getThreadCount() const
+{
+    return threadCount;
+}
+
+// Set number of threads building an index
+void IndexManager::setThreadCount(int _threadCount)
+{
+    threadCount = _threadCount;
+}
+
+// Set megabytes of memory taken by mirrors of all open indices. Mirrors are disabled if it is 0
+// Existing mirrors are dropped and built again within new size
+void IndexManager::setCacheSize(int _cacheSize)
+{
+    cacheSize = (long long)_cacheSize << 20;
+    for (auto& item : handles)
+    {
+        delete item.second.mirror;
+        item.second.mirror = NULL;
+        item.second.noMirror = false;
+    }
+}
+
+// Find key by its first colCount columns, or all columns if colCount < 0
+// Return record id. The smallest one is returned if several keys match
+int IndexManager::find(const char* indexName, const char* key, int colCount)
+{
+    IndexHandle* handle = getHandle(indexName);
+    if (handle->tree != NULL && handle->unique && (colCount < 0 || colCount == (int)handle->types.size()))
+    {
+        RadixTree* mirror = getMirror(handle);
+        string encoded = encodeKey(handle, key, 0);
+        return mirror != NULL ? mirror->find(encoded.data()) : handle->tree->find(encoded.data());
+    }
+
+    vector<int> values;
+    findRange(indexName, key, true, key, true, &values, colCount, colCount);
+    return values.empty() ? -1 : *min_element(values.begin(), values.end());
+}
+
+// Find record ids of keys between lower and upper. NULL bound means unbounded
+// Bounds may cover only the first columns of index, given by their column counts
+// Binary data of all index columns is also returned if keys is not NULL
+// Return number of record ids found
+int IndexManager::findRange(
+    const char* indexName,
+    const char* lower, bool lowerInclusive,
+    const char* upper, bool upperInclusive,
+    vector<int>* values, int lowerColCount, int upperColCount,
+    vector<string>* keys
+)
+{
+    IndexHandle* handle = getHandle(indexName);
+    int dataLength = getPrefixLength(handle, -1);
+    if (handle->hash != NULL)
+    {
+        // Hash index answers only equality on all key columns
+        int colCount = handle->keyColCount;
+        if (
+            lower == NULL || upper == NULL || !lowerInclusive || !upperInclusive ||
+            (lowerColCount < 0 ? (int)handle->types.size() : lowerColCount) != colCount ||
+            (upperColCount < 0 ? (int)handle->types.size() : upperColCount) != colCount ||
+            memcmp(lower, upper, getPrefixLength(handle, colCount)) != 0
+        )
+        {
+            cerr << "ERROR: [IndexManager::findRange] Hash index `" << indexName << "` only supports equality on all key columns!" << endl;
+            return 0;
+        }
+
+        vector<string> found;
+        int findCount = handle->hash->find(encodeBound(handle, lower, colCount, 0).data(), values, keys == NULL ? NULL : &found);
+        for (auto& key : found)
+        {
+            keys->push_back(string(dataLength, 0));
+            Utils::decodeKey(key.data(), &handle->types, &keys->back()[0]);
+        }
+        return findCount;
+    }
+
+    if (handle->bitmap != NULL)
+    {
+        // Bitmap index has one key column, so a bound without columns is open
+        string lowerKey = lower == NULL || lowerColCount == 0 ? "" : encodeBound(handle, lower, -1, 0);
+        string upperKey = upper == NULL || upperColCount == 0 ? "" : encodeBound(handle, upper, -1, 0);
+        vector<string> found;
+        vector<const Bitmap*> bitmaps;
+        handle->bitmap->findRange(
+            lowerKey.empty() ? NULL : lowerKey.data(), lowerInclusive,
+            upperKey.empty() ? NULL : upperKey.data(), upperInclusive,
+            keys == NULL ? NULL : &found, &bitmaps
+        );
+        return collectBitmaps(handle, &bitmaps, &found, values, keys);
+    }
+
+    // Equality on all columns of unique index is a point lookup, answered by mirror if there is one
+    int colCount = handle->types.size();
+    if (
+        handle->unique && lower != NULL && upper != NULL && lowerInclusive && upperInclusive &&
+        (lowerColCount < 0 ? colCount : lowerColCount) == colCount &&
+        (upperColCount < 0 ? colCount : upperColCount) == colCount &&
+        memcmp(lower, upper, dataLength) == 0 && getMirror(handle) != NULL
+    )
+    {
+        string encoded = encodeKey(handle, lower, 0);
+        int value = handle->mirror->find(encoded.data());
+        if (value < 0)
+            return 0;
+        values->push_back(value);
+        if (keys != NULL)
+        {
+            keys->push_back(string(dataLength, 0));
+            Utils::decodeKey(encoded.data(), &handle->types, &keys->back()[0]);
+        }
+        return 1;
+    }
+
+    BPTree* tree = handle->tree;
+    char* key = new char[tree->getKeyLength()];
+
+    // Filling the rest of lower key with the smallest or largest bytes places cursor
+    // before or after all keys sharing its columns, including record ids of non-unique index
+    // Only the covered columns are compared with upper key
+    string lowerKey = lower == NULL ? "" : encodeBound(handle, lower, lowerColCount, lowerInclusive ? 0 : -1);
+    string upperKey = upper == NULL ? "" : encodeBound(handle, upper, upperColCount, 0);
+    int valueLength = getPrefixLength(handle, upperColCount);
+
+    // Walk along the leaves until upper bound is passed
+    int value, findCount = 0;
+    tree->seek(lower == NULL ? NULL : lowerKey.data(), lowerInclusive);
+    while ((value = tree->next(key)) >= 0)
+    {
+        if (upper != NULL)
+        {
+            int res = memcmp(key, upperKey.data(), valueLength);
+            if (res > 0 || (res == 0 && !upperInclusive))
+                break;
+        }
+        values->push_back(value);
+        if (keys != NULL)
+        {
+            keys->push_back(string(dataLength, 0));
+            Utils::decodeKey(key, &handle->types, &keys->back()[0]);
+        }
+        findCount++;
+    }
+    tree->closeCursor();
+
+    delete[] key;
+    return findCount;
+}
+
+// Find record ids of keys whose first colCount columns equal any of probes
+// Probes are sorted, so B+ tree leaves are walked once from left to right
+// Binary data of all index columns is also returned if keys is not NULL
+// Return number of record ids found
+int IndexManager::findBatch(
+    const char* indexName, const vector<string>* probes, int colCount,
+    vector<int>* values, vector<string>* keys
+)
+{
+    IndexHandle* handle = getHandle(indexName);
+    if ((handle->hash != NULL || handle->bitmap != NULL) && colCount != handle->keyColCount)
+    {
+        cerr << "ERROR: [IndexManager::findBatch] Index `" << indexName << "` only supports equality on all key columns!" << endl;
+        return 0;
+    }
+
+    // Encode and sort probes. Equal probes are looked up once
+    vector<string> bounds;
+    for (auto& probe : *probes)
+        bounds.push_back(encodeBound(handle, probe.data(), colCount, 0));
+    sort(bounds.begin(), bounds.end());
+    bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+    if (bounds.empty())
+        return 0;
+
+    int dataLength = getPrefixLength(handle, -1);
+    int findCount = 0;
+    if (handle->hash != NULL)
+    {
+        vector<string> found;
+        for (auto& bound : bounds)
+            findCount += handle->hash->find(bound.data(), values, keys == NULL ? NULL : &found);
+        for (auto& key : found)
+        {
+            keys->push_back(string(dataLength, 0));
+            Utils::decodeKey(key.data(), &handle->types, &keys->back()[0]);
+        }
+        return findCount;
+    }
+
+    if (handle->bitmap != NULL)
+    {
+        vector<string> found;
+        vector<const Bitmap*> bitmaps;
+        for (auto& bound : bounds)
+        {
+            const Bitmap* bitmap = handle->bitmap->find(bound.data());
+            if (bitmap == NULL)
+                continue;
+            found.push_back(bound);
+            bitmaps.push_back(bitmap);
+        }
+        return collectBitmaps(handle, &bitmaps, &found, values, keys);
+    }
+
+    // Probes of all columns of unique index are point lookups, answered by mirror if there is one
+    if (handle->unique && colCount == (int)handle->types.size() && getMirror(handle) != NULL)
+    {
+        for (auto& bound : bounds)
+        {
+            int value = handle->mirror->find(bound.data());
+            if (value < 0)
+                continue;
+            values->push_back(value);
+            if (keys != NULL)
+            {
+                keys->push_back(string(dataLength, 0));
+                Utils::decodeKey(bound.data(), &handle->types, &keys->back()[0]);
+            }
+            findCount++;
+        }
+        return findCount;
+    }
+
+    // Cursor skips forward to the next probe after passing keys of the current one
+    // It stays in the pinned leaf while the next probe lies there
+    BPTree* tree = handle->tree;
+    char* key = new char[tree->getKeyLength()];
+    int length = getPrefixLength(handle, colCount);
+    int value, i = 0;
+    tree->seek(bounds[0].data(), true);
+    while ((value = tree->next(key)) >= 0)
+    {
+        int res = memcmp(key, bounds[i].data(), length);
+        if (res > 0)
+        {
+            while (i < (int)bounds.size() && memcmp(bounds[i].data(), key, length) < 0)
+                i++;
+            if (i == (int)bounds.size())
+                break;
+            res = memcmp(key, bounds[i].data(), length);
+            if (res < 0)
+            {
+                tree->skip(bounds[i].data());
+                continue;
+            }
+        }
+
+        values->push_back(value);
+        if (keys != NULL)
+        {
+            keys->push_back(string(dataLength, 0));
+            Utils::decodeKey(key, &handle->types, &keys->back()[0]);
+        }
+        findCount++;
+    }
+    tree->closeCursor();
+
+    delete[] key;
+    return findCount;
+}
+
+// Unite bitmaps of keys between lower and upper of bitmap index into result. NULL bound means unbounded
+// Return false if index is not a bitmap index
+bool IndexManager::findBitmap(
+    const char* indexName,
+    const char* lower, bool lowerInclusive,
+    const char* upper, bool upperInclusive,
+    Bitmap* result
+)
+{
+    IndexHandle* handle = getHandle(indexName);
+    if (handle->bitmap == NULL)
+    {
+        cerr << "ERROR: [IndexManager::findBitmap] Index `" << indexName << "` is not a bitmap index!" << endl;
+        return false;
+    }
+
+    string lowerKey = lower == NULL ? "" : encodeBound(handle, lower, -1, 0);
+    string upperKey = upper == NULL ? "" : encodeBound(handle, upper, -1, 0);
+    vector<const Bitmap*> bitmaps;
+    handle->bitmap->findRange(
+        lower == NULL ? NULL : lowerKey.data(), lowerInclusive,
+        upper == NULL ? NULL : upperKey.data(), upperInclusive,
+        NULL, &bitmaps
+    );
+    for (auto bitmap : bitmaps)
+        result->unite(bitmap);
+    return true;
 }
 
 // Insert key into index. Return true if success
 bool IndexManager::insert(const char* indexName, const char* key, int value)
 {
-    BPTree* tree = new BPTree(("index/" + string(indexName)).c_str());
-    if (!tree->add(key, value))
+    IndexHandle* handle = getHandle(indexName);
+    string encoded = encodeKey(handle, key, value);
+    bool added =
+        handle->tree != NULL ? handle->tree->add(encoded.data(), value) :
+        handle->hash != NULL ? handle->hash->add(encoded.data(), value) :
+        handle->bitmap->add(encoded.data(), value);
+    if (!added)
     {
         cerr << "ERROR: [IndexManager::insert] Duplicate key in index `" << indexName << "`." << endl;
-        delete tree;
         return false;
     }
-    delete tree;
+
+    if (handle->mirror != NULL)
+    {
+        handle->mirror->add(encoded.data(), value);
+        checkCache(handle);
+    }
     return true;
 }
 
-// Delete key from index. Return true if success
-bool IndexManager::remove(const char* indexName, const char* key)
+// Delete key with its record id from index. Return true if success
+bool IndexManager::remove(const char* indexName, const char* key, int value)
 {
-    BPTree* tree = new BPTree(("index/" + string(indexName)).c_str());
-    if (!tree->remove(key))
+    IndexHandle* handle = getHandle(indexName);
+    string encoded = encodeKey(handle, key, value);
+    bool removed =
+        handle->tree != NULL ? handle->tree->remove(encoded.data()) :
+        handle->hash != NULL ? handle->hash->remove(encoded.data()) :
+        handle->bitmap->remove(encoded.data(), value);
+    if (!removed)
     {
         cerr << "ERROR: [IndexManager::remove] Cannot find key in index `" << indexName << "`." << endl;
-        delete tree;
         return false;
     }
-    delete tree;
+
+    if (handle->mirror != NULL)
+        handle->mirror->remove(encoded.data());
     return true;
 }
 
+// Delete keys with their record ids from index in sorted order
+// Return number of keys deleted
+int IndexManager::removeBatch(const char* indexName, vector<string>* keys, const vector<int>* values)
+{
+    // Sorted keys visit leaves from left to right, so each leaf is loaded once
+    // Bitmaps are held in memory, so their keys are removed in given order along with record ids
+    IndexHandle* handle = getHandle(indexName);
+    for (int i = 0; i < (int)keys->size(); i++)
+        keys->at(i) = encodeKey(handle, keys->at(i).data(), values->at(i));
+    if (handle->bitmap == NULL)
+        sort(keys->begin(), keys->end());
+
+    int removeCount = 0;
+    for (int i = 0; i < (int)keys->size(); i++)
+    {
+        const char* key = keys->at(i).data();
+        bool removed =
+            handle->tree != NULL ? handle->tree->remove(key) :
+            handle->hash != NULL ? handle->hash->remove(key) :
+            handle->bitmap->remove(key, values->at(i));
+        if (removed && handle->mirror != NULL)
+            handle->mirror->remove(key);
+        if (removed)
+            removeCount++;
+        else
+            cerr << "ERROR: [IndexManager::removeBatch] Cannot find key in index `" << indexName << "`." << endl;
+    }
+    return removeCount;
+}
+
 // Create index. Return true if success
 bool IndexManager::createIndex(const char* indexName)
 {
@@ -57,15 +449,343 @@ bool IndexManager::createIndex(const char* indexName)
     Table* table = manager->getTable(index->getTableName());
     if (table == NULL)
         return false;
-    int keyLength = Utils::getTypeSize(table->getType(index->getColName()));
+    int keyLength = 0, hashLength = 0;
+    bool unique = false;
+    for (int i = 0; i < index->getColCount(); i++)
+    {
+        keyLength += Utils::getTypeSize(table->getType(index->getColName(i)));
+        if (i < index->getKeyColCount())
+        {
+            hashLength = keyLength;
+            if (table->getUnique(index->getColName(i)) == 1)
+                unique = true;
+        }
+    }
 
-    BPTree::createFile(("index/" + string(indexName)).c_str(), keyLength);
+    // Hash index hashes key columns only, so keys of a non-unique index with equal columns share a bucket
+    // Bitmap index keeps record ids in bitmaps, so its keys hold the column only
+    if (index->getType() == INDEX_HASH)
+        HashIndex::createFile(("index/" + string(indexName)).c_str(), keyLength + (unique ? 0 : 4), hashLength);
+    else if (index->getType() == INDEX_BITMAP)
+        BitmapIndex::createFile(("index/" + string(indexName)).c_str(), keyLength);
+    else
+        BPTree::createFile(
+            ("index/" + string(indexName)).c_str(), keyLength + (unique ? 0 : 4),
+            index->getType() == INDEX_BUFFERED
+        );
+    return true;
+}
+
+// Load keys of sorted sorter into new index. Return true if success
+// B+ tree is built bottom-up, while keys are added one by one into hash or bitmap index
+bool IndexManager::bulkLoad(const char* indexName, KeySorter* sorter)
+{
+    IndexHandle* handle = getHandle(indexName);
+    if (handle->tree != NULL)
+    {
+        // Mirror of the empty tree is dropped, and built again from loaded leaves on next use
+        delete handle->mirror;
+        handle->mirror = NULL;
+        return handle->tree->bulkLoad(sorter, fillFactor);
+    }
+
+    string key(sorter->getKeyLength(), 0);
+    int value;
+    while ((value = sorter->next(&key[0])) >= 0)
+        if (!(handle->hash != NULL ? handle->hash->add(key.data(), value) : handle->bitmap->add(key.data(), value)))
+        {
+            cerr << "ERROR: [IndexManager::bulkLoad] Keys of index `" << indexName << "` are not unique!" << endl;
+            return false;
+        }
     return true;
 }
 
 // Drop index. Return true if success
 bool IndexManager::dropIndex(const char* indexName)
 {
+    closeHandle(indexName, false);
     Utils::deleteFile(("index/" + string(indexName)).c_str());
     return true;
 }
+
+// If index is a B+ tree whose file is in an older format. It must be rebuilt before it is opened
+bool IndexManager::isOutdated(const char* indexName)
+{
+    Index* index = MiniSQL::getCatalogManager()->getIndex(indexName);
+    if (index == NULL || index->getType() == INDEX_HASH || index->getType() == INDEX_BITMAP)
+        return false;
+    return BPTree::getFileVersion(("index/" + string(indexName)).c_str()) != BPTree::FORMAT_VERSION;
+}
+
+// Collect statistics of B+ tree index by walking all its leaves. Return true if success
+bool IndexManager::analyze(const char* indexName, IndexStats* stats)
+{
+    IndexHandle* handle = getHandle(indexName);
+    if (handle->tree == NULL)
+    {
+        cerr << "ERROR: [IndexManager::analyze] Index `" << indexName << "` is not a B+ tree and cannot be analyzed!" << endl;
+        return false;
+    }
+
+    BPTree* tree = handle->tree;
+    long long leafBytes;
+    tree->analyze(&stats->height, &stats->nodeCount, &stats->leafCount, &leafBytes);
+    stats->leafFill = stats->leafCount == 0 ? 0 : leafBytes * 100 / ((long long)stats->leafCount * BLOCK_SIZE);
+
+    // Count entries first, so that histogram buckets get equal depth
+    int keyLength = tree->getKeyLength();
+    char* key = new char[keyLength];
+    stats->entryCount = 0;
+    stats->modifiedCount = 0;
+    tree->seek(NULL, true);
+    while (tree->next(key) >= 0)
+        stats->entryCount++;
+    int depth = max((stats->entryCount + HISTOGRAM_SIZE - 1) / HISTOGRAM_SIZE, 1);
+
+    // Keys are sorted, so a column prefix differing from the previous key is a new distinct value
+    // A bucket is closed at a new first column value once it holds enough entries
+    int colCount = handle->types.size();
+    vector<int> prefixLength;
+    for (int c = 0; c < colCount; c++)
+        prefixLength.push_back(getPrefixLength(handle, c + 1));
+    stats->distinct.assign(colCount, 0);
+    stats->bound.clear();
+    stats->bucketCount.clear();
+    stats->bucketDistinct.clear();
+
+    string previous;
+    int count = 0, distinct = 0;
+    tree->seek(NULL, true);
+    while (tree->next(key) >= 0)
+    {
+        int c = 0;
+        if (!previous.empty())
+            while (c < colCount && memcmp(key, previous.data(), prefixLength[c]) == 0)
+                c++;
+        for (int i = c; i < colCount; i++)
+            stats->distinct[i]++;
+
+        if (c == 0 && count >= depth)
+        {
+            stats->bound.push_back(previous.substr(0, prefixLength[0]));
+            stats->bucketCount.push_back(count);
+            stats->bucketDistinct.push_back(distinct);
+            count = distinct = 0;
+        }
+        count++;
+        if (c == 0)
+            distinct++;
+        previous.assign(key, keyLength);
+    }
+    tree->closeCursor();
+
+    if (count > 0)
+    {
+        stats->bound.push_back(previous.substr(0, prefixLength[0]));
+        stats->bucketCount.push_back(count);
+        stats->bucketDistinct.push_back(distinct);
+    }
+
+    delete[] key;
+    return true;
+}
+
+// Get handle of index. Index is opened if it is not open
+IndexHandle* IndexManager::getHandle(const char* indexName)
+{
+    auto it = handles.find(indexName);
+    if (it == handles.end())
+    {
+        // Close least recently used tree if too many are open
+        if ((int)handles.size() >= MAX_TREE_COUNT)
+        {
+            auto lru = handles.begin();
+            for (auto jt = handles.begin(); jt != handles.end(); jt++)
+                if (jt->second.lastUse < lru->second.lastUse)
+                    lru = jt;
+            closeHandle(lru->first.c_str(), true);
+        }
+
+        CatalogManager* manager = MiniSQL::getCatalogManager();
+        Index* index = manager->getIndex(indexName);
+
+        IndexHandle handle;
+        handle.tree = NULL;
+        handle.hash = NULL;
+        handle.bitmap = NULL;
+        handle.mirror = NULL;
+        handle.noMirror = false;
+        if (index->getType() == INDEX_HASH)
+            handle.hash = new HashIndex(("index/" + string(indexName)).c_str());
+        else if (index->getType() == INDEX_BITMAP)
+            handle.bitmap = new BitmapIndex(("index/" + string(indexName)).c_str());
+        else
+            handle.tree = new BPTree(("index/" + string(indexName)).c_str());
+        Table* table = manager->getTable(index->getTableName());
+        handle.keyColCount = index->getKeyColCount();
+        handle.unique = false;
+        for (int i = 0; i < index->getColCount(); i++)
+        {
+            handle.types.push_back(table->getType(index->getColName(i)));
+            if (i < handle.keyColCount && table->getUnique(index->getColName(i)) == 1)
+                handle.unique = true;
+        }
+        it = handles.insert(make_pair(string(indexName), handle)).first;
+    }
+
+    it->second.lastUse = ++useCount;
+    return &it->second;
+}
+
+// Close index. Header is written back if write is true
+void IndexManager::closeHandle(const char* indexName, bool write)
+{
+    auto it = handles.find(indexName);
+    if (it == handles.end())
+        return;
+
+    if (write && it->second.tree != NULL)
+        it->second.tree->flushHeader();
+    else if (write && it->second.hash != NULL)
+        it->second.hash->flushHeader();
+    else if (write)
+        it->second.bitmap->flushHeader();
+    delete it->second.tree;
+    delete it->second.hash;
+    delete it->second.bitmap;
+    delete it->second.mirror;
+    handles.erase(it);
+}
+
+// Get mirror of B+ tree, which is built by walking its leaves on first use
+// Return NULL if cache is disabled or mirror does not fit in it
+// Buffered tree has no mirror, as it drops duplicate insertions only when messages are applied
+RadixTree* IndexManager::getMirror(IndexHandle* handle)
+{
+    if (
+        handle->mirror != NULL || handle->tree == NULL || handle->tree->isBuffered() ||
+        handle->noMirror || cacheSize == 0
+    )
+        return handle->mirror;
+
+    // Building stops as soon as mirror outgrows the room left by other mirrors
+    BPTree* tree = handle->tree;
+    long long room = cacheSize - getCacheUsage();
+    RadixTree* mirror = new RadixTree(tree->getKeyLength());
+    char* key = new char[tree->getKeyLength()];
+    int value;
+    tree->seek(NULL, true);
+    while ((value = tree->next(key)) >= 0)
+    {
+        mirror->add(key, value);
+        if (mirror->getMemoryUsage() > room)
+        {
+            delete mirror;
+            mirror = NULL;
+            break;
+        }
+    }
+    tree->closeCursor();
+    delete[] key;
+
+    handle->mirror = mirror;
+    handle->noMirror = mirror == NULL;
+    return mirror;
+}
+
+// Drop mirror of index if mirrors of all open indices no longer fit in cache
+void IndexManager::checkCache(IndexHandle* handle)
+{
+    if (getCacheUsage() <= cacheSize)
+        return;
+    delete handle->mirror;
+    handle->mirror = NULL;
+    handle->noMirror = true;
+}
+
+// Get bytes of memory taken by mirrors of all open indices
+long long IndexManager::getCacheUsage()
+{
+    long long usage = 0;
+    for (auto& item : handles)
+        if (item.second.mirror != NULL)
+            usage += item.second.mirror->getMemoryUsage();
+    return usage;
+}
+
+// Get length of first colCount columns, or all columns if colCount < 0
+int IndexManager::getPrefixLength(IndexHandle* handle, int colCount)
+{
+    if (colCount < 0)
+        colCount = handle->types.size();
+
+    int length = 0;
+    for (int i = 0; i < colCount; i++)
+        length += Utils::getTypeSize(handle->types[i]);
+    return length;
+}
+
+// Append record ids of bitmaps found in bitmap index to values. Return number of record ids
+// They are united in ascending order if keys is NULL, and listed with binary data of found keys otherwise
+int IndexManager::collectBitmaps(
+    IndexHandle* handle, const vector<const Bitmap*>* bitmaps, const vector<string>* found,
+    vector<int>* values, vector<string>* keys
+)
+{
+    int size = values->size();
+    if (keys == NULL)
+    {
+        Bitmap united;
+        for (auto bitmap : *bitmaps)
+            united.unite(bitmap);
+        united.getIds(values);
+        return values->size() - size;
+    }
+
+    int dataLength = getPrefixLength(handle, -1);
+    for (int i = 0; i < (int)bitmaps->size(); i++)
+    {
+        int start = values->size();
+        bitmaps->at(i)->getIds(values);
+        for (int j = start; j < (int)values->size(); j++)
+        {
+            keys->push_back(string(dataLength, 0));
+            Utils::decodeKey(found->at(i).data(), &handle->types, &keys->back()[0]);
+        }
+    }
+    return values->size() - size;
+}
+
+// Encode binary data and record id to key of index. Return encoded key
+string IndexManager::encodeKey(IndexHandle* handle, const char* data, int value)
+{
+    int length = getPrefixLength(handle, -1);
+    string key(length + (handle->unique ? 0 : 4), 0);
+    Utils::encodeKey(data, &handle->types, &key[0]);
+
+    // Record id is stored big-endian so that equal keys are ordered by it
+    if (!handle->unique)
+        for (int i = 0; i < 4; i++)
+            key[length + i] = (char)((unsigned int)value >> (24 - i * 8));
+    return key;
+}
+
+// Encode first colCount columns of data to bound of index
+// Rest of key is filled with fill byte. Return encoded bound
+string IndexManager::encodeBound(IndexHandle* handle, const char* data, int colCount, char fill)
+{
+    if (colCount < 0)
+        colCount = handle->types.size();
+
+    int keyLength =
+        handle->tree != NULL ? handle->tree->getKeyLength() :
+        handle->hash != NULL ? handle->hash->getKeyLength() :
+        handle->bitmap->getKeyLength();
+    string key(keyLength, fill);
+    for (int i = 0, pos = 0; i < colCount; i++)
+    {
+        Utils::encodeKey(data + pos, handle->types[i], &key[pos]);
+        pos += Utils::getTypeSize(handle->types[i]);
+    }
+    return key;
+}
@@ -1,24 +1,207 @@
 #ifndef _INDEX_MANAGER_H
 #define _INDEX_MANAGER_H
 
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include "index/bitmap.h"
+#include "index/bitmapIndex.h"
+#include "index/bpTree.h"
+#include "index/hashIndex.h"
+#include "index/keySorter.h"
+#include "index/radixTree.h"
+#include "struct/index.h"
+
+using namespace std;
+
+// Open B+ tree, hash or bitmap index of an index with cached metadata
+// Exactly one of tree, hash and bitmap is not NULL
+struct IndexHandle
+{
+    BPTree* tree;
+    HashIndex* hash;
+    BitmapIndex* bitmap;
+
+    // In-memory radix tree mirror of B+ tree, or NULL if it is not built
+    RadixTree* mirror;
+
+    // If mirror does not fit in cache. It is not built again until index is reopened
+    bool noMirror;
+
+    // Types of index columns, with included columns after key columns
+    vector<short> types;
+
+    // Number of key columns
+    int keyColCount;
+
+    // If index is unique, which holds if any of its key columns is unique
+    // Keys of non-unique index are followed by record id so that every key is distinct
+    bool unique;
+
+    // Time of last use. Used for eviction
+    int lastUse;
+};
+
+// Keys are passed as concatenated binary data of index columns
+// They are encoded to bytewise ordered keys before reaching B+ tree, hash or bitmap index
+// Hash index answers only lookups on all of its key columns
+// Bitmap index has a single key column, and returns record ids of a range in ascending order
+// Included columns are stored after key columns, and are only returned with keys
+// Indices are kept open between calls, and their headers are written back lazily
+// If cache is enabled, a B+ tree gets a radix tree mirror in memory on first point lookup
+// Mirror is kept in sync by inserts and deletes, and answers lookups of whole keys of unique indices
 class IndexManager
 {
 public:
 
-    // Find key in index. Return record id
-    int find(const char* indexName, const char* key);
+    // Default percentage of each node filled by bulk loading
+    static const int DEFAULT_FILL_FACTOR;
+
+    // Max number of open indices
+    static const int MAX_TREE_COUNT;
+
+    // Max number of threads building an index
+    static const int MAX_THREAD_COUNT;
+
+    // Number of buckets in histogram of analyzed index
+    static const int HISTOGRAM_SIZE;
+
+    // Max megabytes of memory taken by mirrors of all open indices
+    static const int MAX_CACHE_SIZE;
+
+    // Constructor
+    IndexManager();
+
+    // Destructor
+    ~IndexManager();
+
+    // Write headers of all open indices back to buffer
+    void checkpoint();
+
+    // Set percentage of each node filled by bulk loading
+    void setFillFactor(int _fillFactor);
+
+    // Get number of threads building an index
+    int getThreadCount() const;
+
+    // Set number of threads building an index
+    void setThreadCount(int _threadCount);
+
+    // Set megabytes of memory taken by mirrors of all open indices. Mirrors are disabled if it is 0
+    // Existing mirrors are dropped and built again within new size
+    void setCacheSize(int _cacheSize);
+
+    // Find key by its first colCount columns, or all columns if colCount < 0
+    // Return record id. The smallest one is returned if several keys match
+    int find(const char* indexName, const char* key, int colCount = -1);
+
+    // Find record ids of keys between lower and upper. NULL bound means unbounded
+    // Bounds may cover only the first columns of index, given by their column counts
+    // Binary data of all index columns is also returned if keys is not NULL
+    // Return number of record ids found
+    int findRange(
+        const char* indexName,
+        const char* lower, bool lowerInclusive,
+        const char* upper, bool upperInclusive,
+        vector<int>* values, int lowerColCount = -1, int upperColCount = -1,
+        vector<string>* keys = NULL
+    );
+
+    // Find record ids of keys whose first colCount columns equal any of probes
+    // Probes are sorted, so B+ tree leaves are walked once from left to right
+    // Binary data of all index columns is also returned if keys is not NULL
+    // Return number of record ids found
+    int findBatch(
+        const char* indexName, const vector<string>* probes, int colCount,
+        vector<int>* values, vector<string>* keys = NULL
+    );
+
+    // Unite bitmaps of keys between lower and upper of bitmap index into result. NULL bound means unbounded
+    // Return false if index is not a bitmap index
+    bool findBitmap(
+        const char* indexName,
+        const char* lower, bool lowerInclusive,
+        const char* upper, bool upperInclusive,
+        Bitmap* result
+    );
 
     // Insert key into index. Return true if success
     bool insert(const char* indexName, const char* key, int value);
 
-    // Delete key from index. Return true if success
-    bool remove(const char* indexName, const char* key);
+    // Delete key with its record id from index. Return true if success
+    bool remove(const char* indexName, const char* key, int value);
+
+    // Delete keys with their record ids from index in sorted order
+    // Return number of keys deleted
+    int removeBatch(const char* indexName, vector<string>* keys, const vector<int>* values);
 
     // Create index. Return true if success
     bool createIndex(const char* indexName);
 
+    // Load keys of sorted sorter into new index. Return true if success
+    // B+ tree is built bottom-up, while keys are added one by one into hash or bitmap index
+    bool bulkLoad(const char* indexName, KeySorter* sorter);
+
     // Drop index. Return true if success
     bool dropIndex(const char* indexName);
+
+    // If index is a B+ tree whose file is in an older format. It must be rebuilt before it is opened
+    bool isOutdated(const char* indexName);
+
+    // Collect statistics of B+ tree index by walking all its leaves. Return true if success
+    bool analyze(const char* indexName, IndexStats* stats);
+
+private:
+
+    // Percentage of each node filled by bulk loading
+    int fillFactor;
+
+    // Number of threads building an index
+    int threadCount;
+
+    // Bytes of memory taken by mirrors of all open indices
+    long long cacheSize;
+
+    // Open indices by index name
+    unordered_map<string, IndexHandle> handles;
+
+    // Number of handle uses so far
+    int useCount;
+
+    // Get handle of index. Index is opened if it is not open
+    IndexHandle* getHandle(const char* indexName);
+
+    // Close index. Header is written back if write is true
+    void closeHandle(const char* indexName, bool write);
+
+    // Get mirror of B+ tree, which is built by walking its leaves on first use
+    // Return NULL if cache is disabled or mirror does not fit in it
+    // Buffered tree has no mirror, as it drops duplicate insertions only when messages are applied
+    RadixTree* getMirror(IndexHandle* handle);
+
+    // Drop mirror of index if mirrors of all open indices no longer fit in cache
+    void checkCache(IndexHandle* handle);
+
+    // Get bytes of memory taken by mirrors of all open indices
+    long long getCacheUsage();
+
+    // Get length of first colCount columns, or all columns if colCount < 0
+    int getPrefixLength(IndexHandle* handle, int colCount);
+
+    // Append record ids of bitmaps found in bitmap index to values. Return number of record ids
+    // They are united in ascending order if keys is NULL, and listed with binary data of found keys otherwise
+    int collectBitmaps(
+        IndexHandle* handle, const vector<const Bitmap*>* bitmaps, const vector<string>* found,
+        vector<int>* values, vector<string>* keys
+    );
+
+    // Encode binary data and record id to key of index. Return encoded key
+    string encodeKey(IndexHandle* handle, const char* data, int value);
+
+    // Encode first colCount columns of data to bound of index
+    // Rest of key is filled with fill byte. Return encoded bound
+    string encodeBound(IndexHandle* handle, const char* data, int colCount, char fill);
 };
 
 #endif
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "global.h"
+#include "utils/utils.h"
+#include "index/keySorter.h"
+
+using namespace std;
+
+// Default max bytes of pairs kept in memory
+const int KeySorter::MAX_MEMORY = 32 * 1024 * 1024;
+
+// Constructor. Run files are named after filename
+// Keys are concatenated data of types
+// Keys of non-unique index are followed by value so that every key is distinct
+// Pairs beyond memory bytes are spilled
+KeySorter::KeySorter(const char* _filename, const vector<short>* _types, bool _unique, int _memory):
+    filename(_filename), types(*_types), unique(_unique), memory(_memory)
+{
+    keyLength = unique ? 0 : 4;
+    for (auto type : types)
+        keyLength += Utils::getTypeSize(type);
+    entryLength = keyLength + 4;
+    count = 0;
+    orderPos = 0;
+}
+
+// Destructor
+KeySorter::~KeySorter()
+{
+    for (int i = 0; i < (int)runs.size(); i++)
+    {
+        fclose(runs[i]);
+        Utils::deleteFile((filename + ".run" + to_string(i)).c_str());
+    }
+    for (auto part : parts)
+        delete part;
+}
+
+// Get length of each key
+int KeySorter::getKeyLength() const
+{
+    return keyLength;
+}
+
+// Get number of pairs added
+int KeySorter::getCount() const
+{
+    return count;
+}
+
+// Add key-value pair
+void KeySorter::add(const char* data, int value)
+{
+    if ((int)buffer.size() + entryLength > memory)
+        spill();
+
+    int bias = buffer.size();
+    buffer.resize(bias + entryLength);
+    Utils::encodeKey(data, &types, &buffer[bias]);
+    if (!unique)
+    {
+        // Value is stored big-endian so that equal keys are ordered by it
+        int length = keyLength - 4;
+        for (int i = 0; i < 4; i++)
+            buffer[bias + length + i] = (char)((unsigned int)value >> (24 - i * 8));
+    }
+    memcpy(&buffer[bias + keyLength], &value, 4);
+    count++;
+}
+
+// Merge pairs of sorted parts when read. No pair should be added to this sorter
+// Parts are taken over and deleted with this sorter
+void KeySorter::merge(const vector<KeySorter*>* _parts)
+{
+    parts = *_parts;
+    for (auto part : parts)
+        count += part->getCount();
+}
+
+// Sort pairs. Must be called after all pairs are added
+void KeySorter::sort()
+{
+    if (runs.empty() && parts.empty())
+    {
+        // All pairs fit in memory
+        sortBuffer();
+        return;
+    }
+
+    // Merge all runs or parts with a heap
+    if (parts.empty() && !buffer.empty())
+        spill();
+    int sourceCount = parts.empty() ? runs.size() : parts.size();
+    heads.resize(sourceCount);
+    for (int i = 0; i < sourceCount; i++)
+    {
+        if (parts.empty())
+            rewind(runs[i]);
+        if (readHead(i))
+            heap.push_back(i);
+    }
+    make_heap(heap.begin(), heap.end(), [&](int a, int b) { return headGreater(a, b);});
+}
+
+// Get next key in sorted order. Return value, or -1 if all pairs are read
+int KeySorter::next(char* key)
+{
+    int value;
+    if (runs.empty() && parts.empty())
+    {
+        if (orderPos >= (int)order.size())
+            return -1;
+        const char* entry = &buffer[order[orderPos++]];
+        memcpy(key, entry, keyLength);
+        memcpy(&value, entry + keyLength, 4);
+        return value;
+    }
+
+    if (heap.empty())
+        return -1;
+
+    // Take smallest head and refill its run
+    auto cmp = [&](int a, int b) { return headGreater(a, b);};
+    pop_heap(heap.begin(), heap.end(), cmp);
+    int run = heap.back();
+    memcpy(key, heads[run].data(), keyLength);
+    memcpy(&value, heads[run].data() + keyLength, 4);
+
+    if (readHead(run))
+        push_heap(heap.begin(), heap.end(), cmp);
+    else
+        heap.pop_back();
+    return value;
+}
+
+// Sort pairs in memory
+void KeySorter::sortBuffer()
+{
+    int pairCount = buffer.size() / entryLength;
+    order.resize(pairCount);
+    for (int i = 0; i < pairCount; i++)
+        order[i] = i * entryLength;
+
+    std::sort(order.begin(), order.end(), [&](int a, int b)
+    {
+        return memcmp(&buffer[a], &buffer[b], keyLength) < 0;
+    });
+    orderPos = 0;
+}
+
+// Write pairs in memory to a new run file
+void KeySorter::spill()
+{
+    sortBuffer();
+
+    string runName = "data/" + filename + ".run" + to_string(runs.size()) + ".mdb";
+    FILE* file = fopen(runName.c_str(), "wb+");
+    if (file == NULL)
+    {
+        cerr << "ERROR: [KeySorter::spill] Cannot create run file " << runName << "!" << endl;
+        return;
+    }
+    for (auto bias : order)
+        fwrite(&buffer[bias], entryLength, 1, file);
+    runs.push_back(file);
+
+    buffer.clear();
+    order.clear();
+}
+
+// Read next pair of run or part into its head. Return false if it ends
+bool KeySorter::readHead(int run)
+{
+    heads[run].resize(entryLength);
+    if (parts.empty())
+        return fread(&heads[run][0], entryLength, 1, runs[run]) == 1;
+
+    int value = parts[run]->next(&heads[run][0]);
+    memcpy(&heads[run][keyLength], &value, 4);
+    return value >= 0;
+}
+
+// Compare current pairs of runs or parts for heap
+bool KeySorter::headGreater(int a, int b) const
+{
+    return memcmp(heads[a].data(), heads[b].data(), keyLength) > 0;
+}
@@ -0,0 +1,102 @@
+#ifndef _KEY_SORTER_H
+#define _KEY_SORTER_H
+
+#include <cstdio>
+#include <vector>
+#include <string>
+
+using namespace std;
+
+// Sorter of key-value pairs for bulk loading index
+// Keys are encoded when added, so sorted order is index order
+// Pairs beyond memory limit are spilled to sorted run files and merged when read
+// Sorters filled by several threads can be merged by another sorter when read
+class KeySorter
+{
+public:
+
+    // Default max bytes of pairs kept in memory
+    static const int MAX_MEMORY;
+
+    // Constructor. Run files are named after filename
+    // Keys are concatenated data of types
+    // Keys of non-unique index are followed by value so that every key is distinct
+    // Pairs beyond memory bytes are spilled
+    KeySorter(const char* _filename, const vector<short>* _types, bool _unique = true, int _memory = MAX_MEMORY);
+
+    // Destructor
+    ~KeySorter();
+
+    // Get length of each key
+    int getKeyLength() const;
+
+    // Get number of pairs added
+    int getCount() const;
+
+    // Add key-value pair
+    void add(const char* data, int value);
+
+    // Merge pairs of sorted parts when read. No pair should be added to this sorter
+    // Parts are taken over and deleted with this sorter
+    void merge(const vector<KeySorter*>* _parts);
+
+    // Sort pairs. Must be called after all pairs are added
+    void sort();
+
+    // Get next key in sorted order. Return value, or -1 if all pairs are read
+    int next(char* key);
+
+private:
+
+    // Run filename prefix
+    string filename;
+
+    // Types of key columns
+    vector<short> types;
+
+    // If keys are unique
+    bool unique;
+
+    // Max bytes of pairs kept in memory
+    int memory;
+
+    // Length of each key and each pair
+    int keyLength;
+    int entryLength;
+
+    // Number of pairs added
+    int count;
+
+    // Pairs in memory
+    vector<char> buffer;
+
+    // Sorted order of pairs in memory and read position
+    vector<int> order;
+    int orderPos;
+
+    // Run files
+    vector<FILE*> runs;
+
+    // Sorted parts merged by this sorter
+    vector<KeySorter*> parts;
+
+    // Current pairs of runs, or of parts if there are parts
+    vector<string> heads;
+
+    // Heap of runs or parts ordered by current pair
+    vector<int> heap;
+
+    // Sort pairs in memory
+    void sortBuffer();
+
+    // Write pairs in memory to a new run file
+    void spill();
+
+    // Read next pair of run or part into its head. Return false if it ends
+    bool readHead(int run);
+
+    // Compare current pairs of runs or parts for heap
+    bool headGreater(int a, int b) const;
+};
+
+#endif
@@ -0,0 +1,582 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "index/radixTree.h"
+
+using namespace std;
+
+// Max number of prefix bytes stored in an inner node
+// Size is given in header, as it bounds the prefix array
+const int RadixTree::MAX_PREFIX_LENGTH;
+
+// Node types
+const unsigned char RadixTree::NODE4 = 0;
+const unsigned char RadixTree::NODE16 = 1;
+const unsigned char RadixTree::NODE48 = 2;
+const unsigned char RadixTree::NODE256 = 3;
+
+// Constructor
+RadixTree::RadixTree(int _keyLength): keyLength(_keyLength)
+{
+    keyCount = 0;
+    memoryUsage = 0;
+    root = NULL;
+}
+
+// Destructor
+RadixTree::~RadixTree()
+{
+    destroy(root);
+}
+
+// Find value of key. Return -1 if key is not found
+int RadixTree::find(const char* _key) const
+{
+    // Only stored prefix bytes are compared on the way down, as the leaf reached is checked in whole
+    Node* node = root;
+    int depth = 0;
+    while (node != NULL)
+    {
+        if (isLeaf(node))
+        {
+            const char* leaf = getLeaf(node);
+            if (memcmp(leaf + 4, _key, keyLength) != 0)
+                return -1;
+            return *(reinterpret_cast<const int*>(leaf));
+        }
+
+        if (node->prefixLength > 0)
+        {
+            if (memcmp(node->prefix, _key + depth, min(node->prefixLength, MAX_PREFIX_LENGTH)) != 0)
+                return -1;
+            depth += node->prefixLength;
+        }
+
+        Node** child = findChild(node, _key[depth]);
+        node = child == NULL ? NULL : *child;
+        depth++;
+    }
+    return -1;
+}
+
+// Add key-value pair, replacing value of existing key. Return true if key is new
+bool RadixTree::add(const char* _key, int _value)
+{
+    return add(&root, _key, _value, 0);
+}
+
+// Remove key. Return true if success
+bool RadixTree::remove(const char* _key)
+{
+    return remove(&root, _key, 0);
+}
+
+// Get number of keys
+int RadixTree::getKeyCount() const
+{
+    return keyCount;
+}
+
+// Get bytes of memory taken by nodes and leaves
+long long RadixTree::getMemoryUsage() const
+{
+    return memoryUsage;
+}
+
+// Create leaf of key-value pair. Return tagged pointer
+RadixTree::Node* RadixTree::createLeaf(const char* _key, int _value)
+{
+    char* leaf = new char[4 + keyLength];
+    memcpy(leaf, &_value, 4);
+    memcpy(leaf + 4, _key, keyLength);
+    memoryUsage += 4 + keyLength;
+    keyCount++;
+    return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(leaf) | 1);
+}
+
+// Create empty inner node of type
+RadixTree::Node* RadixTree::createNode(unsigned char type)
+{
+    Node* node;
+    if (type == NODE4)
+    {
+        node = new Node4();
+        memoryUsage += sizeof(Node4);
+    }
+    else if (type == NODE16)
+    {
+        node = new Node16();
+        memoryUsage += sizeof(Node16);
+    }
+    else if (type == NODE48)
+    {
+        node = new Node48();
+        memoryUsage += sizeof(Node48);
+    }
+    else
+    {
+        node = new Node256();
+        memoryUsage += sizeof(Node256);
+    }
+    node->type = type;
+    node->count = 0;
+    node->prefixLength = 0;
+    return node;
+}
+
+// Free node or leaf with all nodes below it
+void RadixTree::destroy(Node* node)
+{
+    if (node == NULL)
+        return;
+
+    if (!isLeaf(node))
+    {
+        if (node->type == NODE4)
+            for (int i = 0; i < node->count; i++)
+                destroy(static_cast<Node4*>(node)->children[i]);
+        else if (node->type == NODE16)
+            for (int i = 0; i < node->count; i++)
+                destroy(static_cast<Node16*>(node)->children[i]);
+        else if (node->type == NODE48)
+            for (int i = 0; i < node->count; i++)
+                destroy(static_cast<Node48*>(node)->children[i]);
+        else
+            for (int i = 0; i < 256; i++)
+                destroy(static_cast<Node256*>(node)->children[i]);
+    }
+    release(node);
+}
+
+// Free single node or leaf
+void RadixTree::release(Node* node)
+{
+    if (isLeaf(node))
+    {
+        delete[] getLeaf(node);
+        memoryUsage -= 4 + keyLength;
+        keyCount--;
+    }
+    else if (node->type == NODE4)
+    {
+        delete static_cast<Node4*>(node);
+        memoryUsage -= sizeof(Node4);
+    }
+    else if (node->type == NODE16)
+    {
+        delete static_cast<Node16*>(node);
+        memoryUsage -= sizeof(Node16);
+    }
+    else if (node->type == NODE48)
+    {
+        delete static_cast<Node48*>(node);
+        memoryUsage -= sizeof(Node48);
+    }
+    else
+    {
+        delete static_cast<Node256*>(node);
+        memoryUsage -= sizeof(Node256);
+    }
+}
+
+// If pointer is a leaf
+bool RadixTree::isLeaf(const Node* node)
+{
+    return reinterpret_cast<uintptr_t>(node) & 1;
+}
+
+// Get data of leaf, which is value followed by key
+char* RadixTree::getLeaf(const Node* node)
+{
+    return reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(node) & ~(uintptr_t)1);
+}
+
+// Get pointer to child of key byte, or NULL if there is none
+RadixTree::Node** RadixTree::findChild(Node* node, unsigned char byte)
+{
+    if (node->type == NODE4)
+    {
+        Node4* n = static_cast<Node4*>(node);
+        for (int i = 0; i < n->count; i++)
+            if (n->keys[i] == byte)
+                return &n->children[i];
+        return NULL;
+    }
+
+    if (node->type == NODE16)
+    {
+        Node16* n = static_cast<Node16*>(node);
+#ifdef __SSE2__
+        // All key bytes are compared at once, and bits beyond count are masked off
+        __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)byte), _mm_loadu_si128(reinterpret_cast<const __m128i*>(n->keys)));
+        int mask = _mm_movemask_epi8(cmp) & ((1 << n->count) - 1);
+        if (mask == 0)
+            return NULL;
+        int i = 0;
+        while (!(mask >> i & 1))
+            i++;
+        return &n->children[i];
+#else
+        unsigned char* pos = lower_bound(n->keys, n->keys + n->count, byte);
+        if (pos == n->keys + n->count || *pos != byte)
+            return NULL;
+        return &n->children[pos - n->keys];
+#endif
+    }
+
+    if (node->type == NODE48)
+    {
+        Node48* n = static_cast<Node48*>(node);
+        return n->slots[byte] == 0 ? NULL : &n->children[n->slots[byte] - 1];
+    }
+
+    Node256* n = static_cast<Node256*>(node);
+    return n->children[byte] == NULL ? NULL : &n->children[byte];
+}
+
+// Get any leaf below node. The leftmost one is chosen
+const char* RadixTree::getMinLeaf(const Node* node)
+{
+    while (!isLeaf(node))
+    {
+        if (node->type == NODE4)
+            node = static_cast<const Node4*>(node)->children[0];
+        else if (node->type == NODE16)
+            node = static_cast<const Node16*>(node)->children[0];
+        else if (node->type == NODE48)
+        {
+            const Node48* n = static_cast<const Node48*>(node);
+            int i = 0;
+            while (n->slots[i] == 0)
+                i++;
+            node = n->children[n->slots[i] - 1];
+        }
+        else
+        {
+            const Node256* n = static_cast<const Node256*>(node);
+            int i = 0;
+            while (n->children[i] == NULL)
+                i++;
+            node = n->children[i];
+        }
+    }
+    return getLeaf(node);
+}
+
+// Get length of prefix of node matching key from depth
+int RadixTree::matchPrefix(const Node* node, const char* _key, int depth) const
+{
+    int stored = min(node->prefixLength, MAX_PREFIX_LENGTH);
+    int i = 0;
+    while (i < stored && node->prefix[i] == (unsigned char)_key[depth + i])
+        i++;
+    if (i < stored || node->prefixLength <= MAX_PREFIX_LENGTH)
+        return i;
+
+    // Bytes beyond stored prefix are shared by every key below, so any leaf tells them
+    const char* leafKey = getMinLeaf(node) + 4;
+    while (i < node->prefixLength && leafKey[depth + i] == _key[depth + i])
+        i++;
+    return i;
+}
+
+// Add child of key byte to node at ref, growing node if it is full
+void RadixTree::addChild(Node** ref, unsigned char byte, Node* child)
+{
+    Node* node = *ref;
+    if (node->type == NODE4 || node->type == NODE16)
+    {
+        int capacity = node->type == NODE4 ? 4 : 16;
+        unsigned char* keys = node->type == NODE4 ? static_cast<Node4*>(node)->keys : static_cast<Node16*>(node)->keys;
+        Node** children = node->type == NODE4 ? static_cast<Node4*>(node)->children : static_cast<Node16*>(node)->children;
+        if (node->count < capacity)
+        {
+            // Keep children sorted by key byte
+            int pos = lower_bound(keys, keys + node->count, byte) - keys;
+            memmove(keys + pos + 1, keys + pos, node->count - pos);
+            memmove(children + pos + 1, children + pos, (node->count - pos) * sizeof(Node*));
+            keys[pos] = byte;
+            children[pos] = child;
+            node->count++;
+            return;
+        }
+
+        // Full node moves its children into a larger one
+        Node* larger = createNode(node->type == NODE4 ? NODE16 : NODE48);
+        larger->prefixLength = node->prefixLength;
+        memcpy(larger->prefix, node->prefix, MAX_PREFIX_LENGTH);
+        if (larger->type == NODE16)
+        {
+            Node16* n = static_cast<Node16*>(larger);
+            memcpy(n->keys, keys, capacity);
+            memcpy(n->children, children, capacity * sizeof(Node*));
+        }
+        else
+        {
+            Node48* n = static_cast<Node48*>(larger);
+            for (int i = 0; i < capacity; i++)
+            {
+                n->slots[keys[i]] = i + 1;
+                n->children[i] = children[i];
+            }
+        }
+        larger->count = capacity;
+        release(node);
+        *ref = larger;
+        addChild(ref, byte, child);
+        return;
+    }
+
+    if (node->type == NODE48)
+    {
+        Node48* n = static_cast<Node48*>(node);
+        if (n->count < 48)
+        {
+            // Children stay packed, as removal moves the last one into the hole
+            n->children[n->count] = child;
+            n->slots[byte] = n->count + 1;
+            n->count++;
+            return;
+        }
+
+        Node256* larger = static_cast<Node256*>(createNode(NODE256));
+        larger->prefixLength = n->prefixLength;
+        memcpy(larger->prefix, n->prefix, MAX_PREFIX_LENGTH);
+        for (int i = 0; i < 256; i++)
+            if (n->slots[i] != 0)
+                larger->children[i] = n->children[n->slots[i] - 1];
+        larger->count = n->count;
+        release(n);
+        *ref = larger;
+        addChild(ref, byte, child);
+        return;
+    }
+
+    Node256* n = static_cast<Node256*>(node);
+    n->children[byte] = child;
+    n->count++;
+}
+
+// Remove child at pointer of key byte from node at ref, shrinking node if it is sparse
+void RadixTree::removeChild(Node** ref, unsigned char byte, Node** child)
+{
+    Node* node = *ref;
+    if (node->type == NODE256)
+    {
+        Node256* n = static_cast<Node256*>(node);
+        n->children[byte] = NULL;
+        n->count--;
+
+        // Shrink a little below capacity of the smaller node, so that it does not grow back at once
+        if (n->count > 37)
+            return;
+        Node48* smaller = static_cast<Node48*>(createNode(NODE48));
+        smaller->prefixLength = n->prefixLength;
+        memcpy(smaller->prefix, n->prefix, MAX_PREFIX_LENGTH);
+        for (int i = 0; i < 256; i++)
+            if (n->children[i] != NULL)
+            {
+                smaller->children[smaller->count] = n->children[i];
+                smaller->slots[i] = ++smaller->count;
+            }
+        release(n);
+        *ref = smaller;
+        return;
+    }
+
+    if (node->type == NODE48)
+    {
+        Node48* n = static_cast<Node48*>(node);
+        int slot = n->slots[byte] - 1;
+        n->slots[byte] = 0;
+        n->count--;
+        if (slot != n->count)
+        {
+            // Last child fills the hole
+            n->children[slot] = n->children[n->count];
+            for (int i = 0; i < 256; i++)
+                if (n->slots[i] == n->count + 1)
+                {
+                    n->slots[i] = slot + 1;
+                    break;
+                }
+        }
+
+        if (n->count > 12)
+            return;
+        Node16* smaller = static_cast<Node16*>(createNode(NODE16));
+        smaller->prefixLength = n->prefixLength;
+        memcpy(smaller->prefix, n->prefix, MAX_PREFIX_LENGTH);
+        for (int i = 0; i < 256; i++)
+            if (n->slots[i] != 0)
+            {
+                smaller->keys[smaller->count] = i;
+                smaller->children[smaller->count] = n->children[n->slots[i] - 1];
+                smaller->count++;
+            }
+        release(n);
+        *ref = smaller;
+        return;
+    }
+
+    unsigned char* keys = node->type == NODE4 ? static_cast<Node4*>(node)->keys : static_cast<Node16*>(node)->keys;
+    Node** children = node->type == NODE4 ? static_cast<Node4*>(node)->children : static_cast<Node16*>(node)->children;
+    int pos = child - children;
+    memmove(keys + pos, keys + pos + 1, node->count - pos - 1);
+    memmove(children + pos, children + pos + 1, (node->count - pos - 1) * sizeof(Node*));
+    node->count--;
+
+    if (node->type == NODE16)
+    {
+        if (node->count > 3)
+            return;
+        Node4* smaller = static_cast<Node4*>(createNode(NODE4));
+        smaller->prefixLength = node->prefixLength;
+        memcpy(smaller->prefix, node->prefix, MAX_PREFIX_LENGTH);
+        memcpy(smaller->keys, keys, node->count);
+        memcpy(smaller->children, children, node->count * sizeof(Node*));
+        smaller->count = node->count;
+        release(node);
+        *ref = smaller;
+        return;
+    }
+
+    if (node->count > 1)
+        return;
+
+    // Node with a single child is merged into it, whose prefix takes node prefix and key byte in front
+    Node* only = children[0];
+    if (!isLeaf(only))
+    {
+        unsigned char prefix[MAX_PREFIX_LENGTH];
+        int length = min(node->prefixLength, MAX_PREFIX_LENGTH);
+        memcpy(prefix, node->prefix, length);
+        if (length < MAX_PREFIX_LENGTH)
+            prefix[length++] = keys[0];
+        if (length < MAX_PREFIX_LENGTH)
+        {
+            int rest = min(only->prefixLength, MAX_PREFIX_LENGTH - length);
+            memcpy(prefix + length, only->prefix, rest);
+            length += rest;
+        }
+        memcpy(only->prefix, prefix, length);
+        only->prefixLength += node->prefixLength + 1;
+    }
+    release(node);
+    *ref = only;
+}
+
+// Recursive function for adding key-value pair below node at ref
+bool RadixTree::add(Node** ref, const char* _key, int _value, int depth)
+{
+    Node* node = *ref;
+    if (node == NULL)
+    {
+        *ref = createLeaf(_key, _value);
+        return true;
+    }
+
+    if (isLeaf(node))
+    {
+        char* leaf = getLeaf(node);
+        if (memcmp(leaf + 4, _key, keyLength) == 0)
+        {
+            memcpy(leaf, &_value, 4);
+            return false;
+        }
+
+        // Leaf is replaced by a node branching where keys differ. Keys have equal length, so they differ before end
+        const char* leafKey = leaf + 4;
+        int common = depth;
+        while (leafKey[common] == _key[common])
+            common++;
+        Node* branch = createNode(NODE4);
+        branch->prefixLength = common - depth;
+        memcpy(branch->prefix, _key + depth, min(branch->prefixLength, MAX_PREFIX_LENGTH));
+        *ref = branch;
+        addChild(ref, leafKey[common], node);
+        addChild(ref, _key[common], createLeaf(_key, _value));
+        return true;
+    }
+
+    if (node->prefixLength > 0)
+    {
+        int match = matchPrefix(node, _key, depth);
+        if (match < node->prefixLength)
+        {
+            // Prefix is split by a new node where key leaves it
+            Node* branch = createNode(NODE4);
+            branch->prefixLength = match;
+            memcpy(branch->prefix, node->prefix, min(match, MAX_PREFIX_LENGTH));
+
+            // Rest of prefix after branching byte stays with node. Bytes not stored are taken from a leaf
+            unsigned char byte;
+            if (node->prefixLength <= MAX_PREFIX_LENGTH)
+            {
+                byte = node->prefix[match];
+                node->prefixLength -= match + 1;
+                memmove(node->prefix, node->prefix + match + 1, min(node->prefixLength, MAX_PREFIX_LENGTH));
+            }
+            else
+            {
+                const char* leafKey = getMinLeaf(node) + 4;
+                byte = leafKey[depth + match];
+                node->prefixLength -= match + 1;
+                memcpy(node->prefix, leafKey + depth + match + 1, min(node->prefixLength, MAX_PREFIX_LENGTH));
+            }
+            *ref = branch;
+            addChild(ref, byte, node);
+            addChild(ref, _key[depth + match], createLeaf(_key, _value));
+            return true;
+        }
+        depth += node->prefixLength;
+    }
+
+    Node** child = findChild(node, _key[depth]);
+    if (child != NULL)
+        return add(child, _key, _value, depth + 1);
+    addChild(ref, _key[depth], createLeaf(_key, _value));
+    return true;
+}
+
+// Recursive function for removing key below node at ref
+bool RadixTree::remove(Node** ref, const char* _key, int depth)
+{
+    Node* node = *ref;
+    if (node == NULL)
+        return false;
+
+    if (isLeaf(node))
+    {
+        // Only a lone leaf at root is reached here
+        if (memcmp(getLeaf(node) + 4, _key, keyLength) != 0)
+            return false;
+        release(node);
+        *ref = NULL;
+        return true;
+    }
+
+    if (node->prefixLength > 0)
+    {
+        if (memcmp(node->prefix, _key + depth, min(node->prefixLength, MAX_PREFIX_LENGTH)) != 0)
+            return false;
+        depth += node->prefixLength;
+    }
+
+    Node** child = findChild(node, _key[depth]);
+    if (child == NULL)
+        return false;
+    if (!isLeaf(*child))
+        return remove(child, _key, depth + 1);
+
+    if (memcmp(getLeaf(*child) + 4, _key, keyLength) != 0)
+        return false;
+    release(*child);
+    removeChild(ref, _key[depth], child);
+    return true;
+}
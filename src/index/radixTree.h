@@ -0,0 +1,135 @@
+#ifndef _RADIX_TREE_H
+#define _RADIX_TREE_H
+
+using namespace std;
+
+// Adaptive radix tree over keys of a fixed length, kept in memory as a mirror of a B+ tree
+// Each inner node branches on one key byte, and holds 4, 16, 48 or 256 children as it grows or shrinks
+// A path of single children is compressed into a prefix of the node below it. Up to MAX_PREFIX_LENGTH
+// bytes of prefix are stored in node, and the rest is checked against a leaf below when needed
+// Leaves hold whole key and value, and are told from inner nodes by the lowest bit of child pointer
+class RadixTree
+{
+public:
+
+    // Max number of prefix bytes stored in an inner node
+    static const int MAX_PREFIX_LENGTH = 8;
+
+    // Constructor
+    RadixTree(int _keyLength);
+
+    // Destructor
+    ~RadixTree();
+
+    // Find value of key. Return -1 if key is not found
+    int find(const char* _key) const;
+
+    // Add key-value pair, replacing value of existing key. Return true if key is new
+    bool add(const char* _key, int _value);
+
+    // Remove key. Return true if success
+    bool remove(const char* _key);
+
+    // Get number of keys
+    int getKeyCount() const;
+
+    // Get bytes of memory taken by nodes and leaves
+    long long getMemoryUsage() const;
+
+private:
+
+    // Node types
+    static const unsigned char NODE4;
+    static const unsigned char NODE16;
+    static const unsigned char NODE48;
+    static const unsigned char NODE256;
+
+    // Header shared by inner nodes
+    struct Node
+    {
+        unsigned char type;
+        short count;
+        int prefixLength;
+        unsigned char prefix[MAX_PREFIX_LENGTH];
+    };
+
+    // Node with up to 4 children, sorted by key byte
+    struct Node4 : Node
+    {
+        unsigned char keys[4];
+        Node* children[4];
+    };
+
+    // Node with up to 16 children, sorted by key byte
+    struct Node16 : Node
+    {
+        unsigned char keys[16];
+        Node* children[16];
+    };
+
+    // Node with up to 48 children. Slot of each key byte is stored plus 1, and 0 means no child
+    struct Node48 : Node
+    {
+        unsigned char slots[256];
+        Node* children[48];
+    };
+
+    // Node with a child for each key byte
+    struct Node256 : Node
+    {
+        Node* children[256];
+    };
+
+    // Length of each key
+    int keyLength;
+
+    // Number of keys
+    int keyCount;
+
+    // Bytes taken by nodes and leaves
+    long long memoryUsage;
+
+    // Root node or leaf, NULL if tree is empty
+    Node* root;
+
+    // Create leaf of key-value pair. Return tagged pointer
+    Node* createLeaf(const char* _key, int _value);
+
+    // Create empty inner node of type
+    Node* createNode(unsigned char type);
+
+    // Free node or leaf with all nodes below it
+    void destroy(Node* node);
+
+    // Free single node or leaf
+    void release(Node* node);
+
+    // If pointer is a leaf
+    static bool isLeaf(const Node* node);
+
+    // Get data of leaf, which is value followed by key
+    static char* getLeaf(const Node* node);
+
+    // Get pointer to child of key byte, or NULL if there is none
+    static Node** findChild(Node* node, unsigned char byte);
+
+    // Get any leaf below node. The leftmost one is chosen
+    static const char* getMinLeaf(const Node* node);
+
+    // Get length of prefix of node matching key from depth
+    int matchPrefix(const Node* node, const char* _key, int depth) const;
+
+    // Add child of key byte to node at ref, growing node if it is full
+    void addChild(Node** ref, unsigned char byte, Node* child);
+
+    // Remove child at pointer of key byte from node at ref, shrinking node if it is sparse
+    void removeChild(Node** ref, unsigned char byte, Node** child);
+
+    // Recursive function for adding key-value pair below node at ref
+    bool add(Node** ref, const char* _key, int _value, int depth);
+
+    // Recursive function for removing key below node at ref
+    bool remove(Node** ref, const char* _key, int depth);
+};
+
+#endif
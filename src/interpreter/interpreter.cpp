@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <ctime>
 #include <iostream>
 #include <fstream>
@@ -8,11 +9,16 @@
 
 using namespace std;
 
+// Number of statements after which a checkpoint is taken
+// Buffered index messages are kept across statements, so checkpoint is not taken after each one
+const int Interpreter::CHECKPOINT_INTERVAL = 1000;
+
 // Constructor
 Interpreter::Interpreter(bool _fromFile): fromFile(_fromFile)
 {
     ptr = -1;
     queryCount = 0;
+    uncheckpointed = 0;
     exiting = false;
     tokenizer = new Tokenizer();
     api = new Api();
@@ -61,10 +67,20 @@ void Interpreter::execute(const char* sql)
             insert();
         else if (tokens[ptr] == "delete")
             remove();
+        else if (tokens[ptr] == "update")
+            update();
         else if (tokens[ptr] == "create")
             create();
         else if (tokens[ptr] == "drop")
             drop();
+        else if (tokens[ptr] == "vacuum")
+            vacuum();
+        else if (tokens[ptr] == "analyze")
+            analyze();
+        else if (tokens[ptr] == "set")
+            set();
+        else if (tokens[ptr] == "checkpoint")
+            checkpoint();
         else if (tokens[ptr] == "exec" || tokens[ptr] == "execfile")
             execfile();
         else if (tokens[ptr] == "exit" || tokens[ptr] == "quit")
@@ -74,20 +90,86 @@ void Interpreter::execute(const char* sql)
             cerr << "ERROR: [Interpreter::execute] Unknown instruction '" << tokens[ptr] << "'." << endl;
             skipStatement();
         }
+
+        // Lazily kept index state reaches file at least once every interval
+        if (++uncheckpointed >= CHECKPOINT_INTERVAL)
+        {
+            api->checkpoint();
+            uncheckpointed = 0;
+        }
     }
 }
 
 // Deal with select
 void Interpreter::select()
 {
+    // Prepare projection and aggregate information
+    vector<string> selColName;
+    vector<int> aggFunc;
+    vector<string> aggCol;
+
     ptr++;
     if (tokens[ptr] != "*" || type[ptr] != Tokenizer::TOKEN_SYMBOL)
     {
-        reportUnexpected("select", "'*'(MiniSQL does not support selecting specific columns)");
-        return;
+        // Select specific columns or aggregates
+        while (true)
+        {
+            if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+            {
+                reportUnexpected("select", "'*', column name or aggregate function");
+                return;
+            }
+
+            if (tokens[ptr+1] != "(" || type[ptr+1] != Tokenizer::TOKEN_SYMBOL)
+                // Column name
+                selColName.push_back(tokens[ptr]);
+            else
+            {
+                // Aggregate function
+                int func = getAggregateType(tokens[ptr].c_str());
+                if (func < 0)
+                {
+                    cerr << "ERROR: [Interpreter::select] Unknown aggregate function '" << tokens[ptr] << "'." << endl;
+                    skipStatement();
+                    return;
+                }
+                aggFunc.push_back(func);
+
+                ptr += 2;
+                if (func == AGG_COUNT && tokens[ptr] == "*" && type[ptr] == Tokenizer::TOKEN_SYMBOL)
+                    aggCol.push_back("*");
+                else if (type[ptr] == Tokenizer::TOKEN_IDENTIFIER)
+                    aggCol.push_back(tokens[ptr]);
+                else
+                {
+                    reportUnexpected("select", "column name");
+                    return;
+                }
+
+                ptr++;
+                if (tokens[ptr] != ")" || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+                {
+                    reportUnexpected("select", "')'");
+                    return;
+                }
+            }
+
+            ptr++;
+            if (tokens[ptr] != "," || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+                break;
+            ptr++;
+        }
+
+        if (!selColName.empty() && !aggFunc.empty())
+        {
+            cerr << "ERROR: [Interpreter::select] Cannot select columns and aggregates together(MiniSQL does not support group by)." << endl;
+            skipStatement();
+            return;
+        }
     }
+    else
+        ptr++;
 
-    ptr++;
     if (tokens[ptr] != "from" || type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
     {
         reportUnexpected("select", "'from'");
@@ -109,10 +191,24 @@ void Interpreter::select()
 
     if (where(&colName, &cond, &operand))
     {
+        if (!aggFunc.empty())
+        {
+            // Do aggregation
+            int tic, toc, aggCount;
+            tic = clock();
+            aggCount = api->aggregate(tableName, &aggFunc, &aggCol, &colName, &cond, &operand);
+            toc = clock();
+
+            // Print execution time
+            if (aggCount >= 0 && !fromFile)
+                cout << aggCount << " record(s) aggregated. Query done in " << 1.0 * (toc-tic) / CLOCKS_PER_SEC << "s." << endl;
+            return;
+        }
+
         // Do selection
         int tic, toc, selectCount;
         tic = clock();
-        selectCount = api->select(tableName, &colName, &cond, &operand);
+        selectCount = api->select(tableName, &selColName, &colName, &cond, &operand);
         toc = clock();
 
         // Print execution time
@@ -232,6 +328,75 @@ void Interpreter::remove()
     }
 }
 
+// Deal with update
+void Interpreter::update()
+{
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+    {
+        reportUnexpected("update", "table name");
+        return;
+    }
+
+    // Prepare update information
+    const char* tableName = tokens[ptr].c_str();
+    vector<string> setColName;
+    vector<string> setValue;
+    vector<string> colName;
+    vector<int> cond;
+    vector<string> operand;
+
+    ptr++;
+    if (tokens[ptr] != "set" || type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+    {
+        reportUnexpected("update", "'set'");
+        return;
+    }
+
+    while (true)
+    {
+        ptr++;
+        if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+        {
+            reportUnexpected("update", "column name");
+            return;
+        }
+        setColName.push_back(tokens[ptr]);
+
+        ptr++;
+        if (tokens[ptr] != "=" || type[ptr] != Tokenizer::TOKEN_OPERATOR)
+        {
+            reportUnexpected("update", "'='");
+            return;
+        }
+
+        ptr++;
+        if (type[ptr] != Tokenizer::TOKEN_NUMBER && type[ptr] != Tokenizer::TOKEN_STRING_SINGLE && type[ptr] != Tokenizer::TOKEN_STRING_DOUBLE)
+        {
+            reportUnexpected("update", "value");
+            return;
+        }
+        setValue.push_back(tokens[ptr]);
+
+        if (tokens[ptr+1] != "," || type[ptr+1] != Tokenizer::TOKEN_SYMBOL)
+            break;
+        ptr++;
+    }
+
+    if (where(&colName, &cond, &operand))
+    {
+        // Do update
+        int tic, toc, updateCount;
+        tic = clock();
+        updateCount = api->update(tableName, &setColName, &setValue, &colName, &cond, &operand);
+        toc = clock();
+
+        // Print execution time
+        if (updateCount >= 0 && !fromFile)
+            cout << updateCount << " record(s) updated. Query done in " << 1.0 * (toc-tic) / CLOCKS_PER_SEC << "s." << endl;
+    }
+}
+
 // Deal with where. Return true if success
 bool Interpreter::where(vector<string>* colName, vector<int>* cond, vector<string>* operand)
 {
@@ -257,27 +422,67 @@ bool Interpreter::where(vector<string>* colName, vector<int>* cond, vector<strin
         colName->push_back(tokens[ptr]);
 
         ptr++;
-        if (type[ptr] != Tokenizer::TOKEN_OPERATOR)
+        if (tokens[ptr] == "in" && type[ptr] == Tokenizer::TOKEN_IDENTIFIER)
         {
-            reportUnexpected("select", "operator");
-            return false;
+            // Values of in are separated by ',' and kept in one operand
+            ptr++;
+            if (tokens[ptr] != "(" || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+            {
+                reportUnexpected("select", "'('");
+                return false;
+            }
+
+            string list;
+            int start = ptr + 1;
+            while (true)
+            {
+                ptr++;
+                if (type[ptr] != Tokenizer::TOKEN_NUMBER && type[ptr] != Tokenizer::TOKEN_STRING_SINGLE && type[ptr] != Tokenizer::TOKEN_STRING_DOUBLE)
+                {
+                    reportUnexpected("select", "value");
+                    return false;
+                }
+                if (ptr > start)
+                    list += LIST_SEPARATOR;
+                list += tokens[ptr];
+
+                ptr++;
+                if (tokens[ptr] != "," || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+                    break;
+            }
+
+            if (tokens[ptr] != ")" || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+            {
+                reportUnexpected("select", "')'");
+                return false;
+            }
+            cond->push_back(COND_IN);
+            operand->push_back(list);
         }
-        int op = getOperatorType(tokens[ptr].c_str());
-        if (op < 0)
+        else
         {
-            cerr << "ERROR: [Interpreter::select] Unknown operator '" << tokens[ptr] << "'." << endl;
-            skipStatement();
-            return false;
-        }
-        cond->push_back(op);
+            if (type[ptr] != Tokenizer::TOKEN_OPERATOR)
+            {
+                reportUnexpected("select", "operator");
+                return false;
+            }
+            int op = getOperatorType(tokens[ptr].c_str());
+            if (op < 0)
+            {
+                cerr << "ERROR: [Interpreter::select] Unknown operator '" << tokens[ptr] << "'." << endl;
+                skipStatement();
+                return false;
+            }
+            cond->push_back(op);
 
-        ptr++;
-        if (type[ptr] != Tokenizer::TOKEN_NUMBER && type[ptr] != Tokenizer::TOKEN_STRING_SINGLE && type[ptr] != Tokenizer::TOKEN_STRING_DOUBLE)
-        {
-            reportUnexpected("select", "value");
-            return false;
+            ptr++;
+            if (type[ptr] != Tokenizer::TOKEN_NUMBER && type[ptr] != Tokenizer::TOKEN_STRING_SINGLE && type[ptr] != Tokenizer::TOKEN_STRING_DOUBLE)
+            {
+                reportUnexpected("select", "value");
+                return false;
+            }
+            operand->push_back(tokens[ptr]);
         }
-        operand->push_back(tokens[ptr]);
 
         ptr++;
         if (type[ptr] == Tokenizer::TOKEN_END)
@@ -454,7 +659,7 @@ void Interpreter::createIndex()
     // Prepare create table information
     const char* indexName = tokens[ptr].c_str();
     const char* tableName;
-    const char* colName;
+    vector<string> colName, includeColName;
 
     ptr++;
     if (tokens[ptr] != "on" || type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
@@ -478,22 +683,81 @@ void Interpreter::createIndex()
         return;
     }
 
-    ptr++;
-    if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+    // Columns are separated by ','
+    while (true)
     {
-        reportUnexpected("createIndex", "column name");
-        return;
+        ptr++;
+        if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+        {
+            reportUnexpected("createIndex", "column name");
+            return;
+        }
+        colName.push_back(tokens[ptr]);
+
+        ptr++;
+        if (tokens[ptr] != "," || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+            break;
     }
-    colName = tokens[ptr].c_str();
 
-    ptr++;
     if (tokens[ptr] != ")" || type[ptr] != Tokenizer::TOKEN_SYMBOL)
     {
         reportUnexpected("createIndex", "')'");
         return;
     }
 
+    // Included columns are given after 'include' in parentheses
     ptr++;
+    if (tokens[ptr] == "include" && type[ptr] == Tokenizer::TOKEN_IDENTIFIER)
+    {
+        ptr++;
+        if (tokens[ptr] != "(" || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+        {
+            reportUnexpected("createIndex", "'('");
+            return;
+        }
+
+        while (true)
+        {
+            ptr++;
+            if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+            {
+                reportUnexpected("createIndex", "column name");
+                return;
+            }
+            includeColName.push_back(tokens[ptr]);
+
+            ptr++;
+            if (tokens[ptr] != "," || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+                break;
+        }
+
+        if (tokens[ptr] != ")" || type[ptr] != Tokenizer::TOKEN_SYMBOL)
+        {
+            reportUnexpected("createIndex", "')'");
+            return;
+        }
+        ptr++;
+    }
+
+    // Index type is given after 'using'. B+ tree is the default
+    int indexType = INDEX_BPTREE;
+    if (tokens[ptr] == "using" && type[ptr] == Tokenizer::TOKEN_IDENTIFIER)
+    {
+        ptr++;
+        if (tokens[ptr] == "hash" && type[ptr] == Tokenizer::TOKEN_IDENTIFIER)
+            indexType = INDEX_HASH;
+        else if (tokens[ptr] == "buffered" && type[ptr] == Tokenizer::TOKEN_IDENTIFIER)
+            indexType = INDEX_BUFFERED;
+        else if (tokens[ptr] == "bitmap" && type[ptr] == Tokenizer::TOKEN_IDENTIFIER)
+            indexType = INDEX_BITMAP;
+        else if (tokens[ptr] != "btree" || type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+        {
+            reportUnexpected("createIndex", "'btree', 'hash', 'buffered' or 'bitmap'");
+            return;
+        }
+        ptr++;
+    }
+
     if (type[ptr] != Tokenizer::TOKEN_END)
     {
         reportUnexpected("createIndex", "';'");
@@ -504,7 +768,9 @@ void Interpreter::createIndex()
     int tic, toc;
     bool res;
     tic = clock();
-    res = api->createIndex(indexName, tableName, colName);
+    res = api->createIndex(
+        indexName, tableName, &colName, indexType, &includeColName, fromFile ? NULL : reportProgress
+    );
     toc = clock();
     
     // Print execution time
@@ -576,6 +842,146 @@ void Interpreter::drop()
         reportUnexpected("drop", "'table' or 'index'");
 }
 
+// Deal with vacuum
+void Interpreter::vacuum()
+{
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+    {
+        reportUnexpected("vacuum", "table name");
+        return;
+    }
+    const char* tableName = tokens[ptr].c_str();
+
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_END)
+    {
+        reportUnexpected("vacuum", "';'");
+        return;
+    }
+
+    // Do vacuum
+    int tic, toc;
+    bool res;
+    tic = clock();
+    res = api->vacuum(tableName);
+    toc = clock();
+
+    // Print execution time
+    if (res && !fromFile)
+        cout << "1 table vacuumed. Query done in " << 1.0 * (toc-tic) / CLOCKS_PER_SEC << "s." << endl;
+}
+
+// Deal with analyze index
+void Interpreter::analyze()
+{
+    ptr++;
+    if (tokens[ptr] != "index" || type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+    {
+        reportUnexpected("analyze", "'index'");
+        return;
+    }
+
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+    {
+        reportUnexpected("analyze", "index name");
+        return;
+    }
+    const char* indexName = tokens[ptr].c_str();
+
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_END)
+    {
+        reportUnexpected("analyze", "';'");
+        return;
+    }
+
+    // Do analyze
+    int tic, toc;
+    bool res;
+    tic = clock();
+    res = api->analyzeIndex(indexName);
+    toc = clock();
+
+    // Print execution time
+    if (res && !fromFile)
+        cout << "1 index analyzed. Query done in " << 1.0 * (toc-tic) / CLOCKS_PER_SEC << "s." << endl;
+}
+
+// Deal with set
+void Interpreter::set()
+{
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_IDENTIFIER)
+    {
+        reportUnexpected("set", "option name");
+        return;
+    }
+    string option = tokens[ptr];
+
+    ptr++;
+    if (tokens[ptr] != "=" || type[ptr] != Tokenizer::TOKEN_OPERATOR)
+    {
+        reportUnexpected("set", "'='");
+        return;
+    }
+
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_NUMBER)
+    {
+        reportUnexpected("set", "number");
+        return;
+    }
+    int value = atoi(tokens[ptr].c_str());
+
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_END)
+    {
+        reportUnexpected("set", "';'");
+        return;
+    }
+
+    // Do set
+    bool res;
+    if (option == "fillfactor")
+        res = api->setFillFactor(value);
+    else if (option == "threads")
+        res = api->setThreadCount(value);
+    else if (option == "indexcache")
+        res = api->setCacheSize(value);
+    else
+    {
+        cerr << "ERROR: [Interpreter::set] Unknown option '" << option << "'." << endl;
+        return;
+    }
+
+    if (res && !fromFile)
+        cout << "Option " << option << " set to " << value << "." << endl;
+}
+
+// Deal with checkpoint
+void Interpreter::checkpoint()
+{
+    ptr++;
+    if (type[ptr] != Tokenizer::TOKEN_END)
+    {
+        reportUnexpected("checkpoint", "';'");
+        return;
+    }
+
+    // Do checkpoint
+    int tic, toc;
+    tic = clock();
+    api->checkpoint();
+    toc = clock();
+    uncheckpointed = 0;
+
+    // Print execution time
+    if (!fromFile)
+        cout << "Checkpoint done in " << 1.0 * (toc-tic) / CLOCKS_PER_SEC << "s." << endl;
+}
+
 // Deal with execfile
 void Interpreter::execfile()
 {
@@ -666,6 +1072,24 @@ int Interpreter::getOperatorType(const char* op)
         return -1;
 }
 
+// Get aggregate function type
+int Interpreter::getAggregateType(const char* func)
+{
+    string s = func;
+    if (s == "count")
+        return AGG_COUNT;
+    else if (s == "sum")
+        return AGG_SUM;
+    else if (s == "min")
+        return AGG_MIN;
+    else if (s == "max")
+        return AGG_MAX;
+    else if (s == "avg")
+        return AGG_AVG;
+    else
+        return -1;
+}
+
 // Get next column type
 short Interpreter::getNextColType()
 {
@@ -714,6 +1138,14 @@ void Interpreter::reportUnexpected(const char* position, const char* expecting)
     skipStatement();
 }
 
+// Print progress of scanning records on one line
+void Interpreter::reportProgress(int done, int total)
+{
+    cout << "\rScanning records... " << done * 100 / total << "%" << flush;
+    if (done == total)
+        cout << endl;
+}
+
 // Skip current statement
 void Interpreter::skipStatement()
 {
@@ -13,6 +13,9 @@ class Interpreter
 {
 public:
 
+    // Number of statements after which a checkpoint is taken
+    static const int CHECKPOINT_INTERVAL;
+
     // Constructor
     Interpreter(bool _fromFile = false);
 
@@ -45,6 +48,9 @@ private:
     // Total number of queries processed
     int queryCount;
 
+    // Number of statements executed since last checkpoint
+    int uncheckpointed;
+
     // If user is exiting mini SQL
     bool exiting;
 
@@ -66,6 +72,9 @@ private:
     // Deal with delete
     void remove();
 
+    // Deal with update
+    void update();
+
     // Deal with where. Return true if success
     bool where(vector<string>* colName, vector<int>* cond, vector<string>* operand);
 
@@ -81,6 +90,18 @@ private:
     // Deal with drop table/index
     void drop();
 
+    // Deal with vacuum
+    void vacuum();
+
+    // Deal with analyze index
+    void analyze();
+
+    // Deal with set
+    void set();
+
+    // Deal with checkpoint
+    void checkpoint();
+
     // Deal with execfile
     void execfile();
 
@@ -90,12 +111,18 @@ private:
     // Get operator type
     int getOperatorType(const char* op);
 
+    // Get aggregate function type
+    int getAggregateType(const char* func);
+
     // Get next column type
     short getNextColType();
 
     // Report unexpected error
     void reportUnexpected(const char* position, const char* expecting);
 
+    // Print progress of scanning records on one line
+    static void reportProgress(int done, int total);
+
     // Skip current statement
     void skipStatement();
 };
@@ -4,6 +4,7 @@
 
 #include "global.h"
 #include "utils/utils.h"
+#include "api/api.h"
 #include "interpreter/interpreter.h"
 #include "index/bpTree.h"
 #include "minisql.h"
@@ -25,22 +26,27 @@ void MiniSQL::init()
 
     // Check if catalog/indices.mdb exists
     if (!Utils::fileExists("catalog/indices"))
-        HeapFile::createFile("catalog/indices", MAX_NAME_LENGTH*3);
+        HeapFile::createFile("catalog/indices", MAX_NAME_LENGTH*3 + 2);
 
     // Init managers
     bufferManager = new BufferManager();
     catalogManager = new CatalogManager();
     recordManager = new RecordManager();
     indexManager = new IndexManager();
+
+    // Indices left by an older version are rebuilt before any of them is opened
+    Api api;
+    api.upgradeIndices();
 }
 
 // Clean up managers
+// Buffer manager goes last, as other managers write back to buffer when deleted
 void MiniSQL::cleanUp()
 {
-    delete bufferManager;
-    delete catalogManager;
-    delete recordManager;
     delete indexManager;
+    delete recordManager;
+    delete catalogManager;
+    delete bufferManager;
 }
 
 // Get buffer manager
@@ -67,7 +73,8 @@ IndexManager* MiniSQL::getIndexManager()
     return indexManager;
 }
 
-// Main function
+#ifndef TEST
+// Main function. Test programs in test folder bring their own
 int main()
 {
     MiniSQL::init();
@@ -89,3 +96,4 @@ int main()
     MiniSQL::cleanUp();
     return 0;
 }
+#endif
@@ -1,22 +1,29 @@
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
 #include "global.h"
 #include "struct/table.h"
+#include "struct/predicate.h"
 #include "file/heapFile.h"
+#include "file/zoneMap.h"
+#include "file/bloomFilter.h"
 #include "utils/utils.h"
 
 #include "minisql.h"
 #include "catalog/catalogManager.h"
+#include "index/indexManager.h"
 #include "record/recordManager.h"
 
 using namespace std;
 
 // Select record from table. Return number of records selected
+// Only projected columns are copied if projection is provided
 int RecordManager::select(
     const char* tableName, const vector<string>* colName,
     const vector<int>* cond, const vector<string>* operand,
-    vector<char*>* record, vector<int>* ids
+    vector<char*>* record, vector<int>* ids,
+    const vector<int>* projection
 )
 {
     // Get table and record file
@@ -25,21 +32,29 @@ int RecordManager::select(
     if (table == NULL)
         return -1;
 
+    // Compile conditions and find blocks to scan by zone map
+    vector<char> blockMask;
+    Predicate* pred = prepareScan(table, colName, cond, operand, &blockMask);
+    if (pred == NULL)
+        return -1;
+
     HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
     int recordLength = table->getRecordLength();
+    int hitLength = projection == NULL ? recordLength : table->getProjectLength(projection);
 
     // Iterate through record file
     int id, hitCount = 0;
     char* dataIn = new char[recordLength];
 
-    while ((id = file->getNextRecord(dataIn)) >= 0)
+    while ((id = file->getNextRecord(dataIn, &blockMask)) >= 0)
         // Check all conditions
-        if (checkRecord(
-            dataIn, tableName, colName, cond, operand
-        ))
+        if (pred->check(dataIn))
         {
-            char* hit = new char[recordLength];
-            memcpy(hit, dataIn, recordLength);
+            char* hit = new char[hitLength];
+            if (projection == NULL)
+                memcpy(hit, dataIn, recordLength);
+            else
+                table->project(dataIn, projection, hit);
 
             record->push_back(hit);
             ids->push_back(id);
@@ -47,6 +62,156 @@ int RecordManager::select(
         }
 
     delete[] dataIn;
+    delete pred;
+    delete file;
+    return hitCount;
+}
+
+// Select records satisfying all conditions from candidate ids
+// Only projected columns are copied if projection is provided
+int RecordManager::select(
+    const char* tableName, const vector<int>* candidates,
+    const vector<string>* colName, const vector<int>* cond, const vector<string>* operand,
+    vector<char*>* record, vector<int>* ids,
+    const vector<int>* projection
+)
+{
+    // Get table and record file
+    CatalogManager* manager = MiniSQL::getCatalogManager();
+    Table* table = manager->getTable(tableName);
+    if (table == NULL)
+        return -1;
+
+    Predicate* pred = new Predicate(table, colName, cond, operand);
+    if (!pred->isValid())
+    {
+        delete pred;
+        return -1;
+    }
+
+    HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
+    int recordLength = table->getRecordLength();
+    int hitLength = projection == NULL ? recordLength : table->getProjectLength(projection);
+
+    // Fetch each candidate and check all conditions
+    int hitCount = 0;
+    for (auto id : *candidates)
+    {
+        const char* data = file->getRecordById(id);
+        if (data == NULL || !pred->check(data))
+            continue;
+
+        char* hit = new char[hitLength];
+        if (projection == NULL)
+            memcpy(hit, data, recordLength);
+        else
+            table->project(data, projection, hit);
+
+        record->push_back(hit);
+        ids->push_back(id);
+        hitCount++;
+    }
+
+    delete pred;
+    delete file;
+    return hitCount;
+}
+
+// Select records satisfying all conditions from index entries without reading record file
+// Each entry holds data of columns entryCol of record candidate, and other columns are left zero
+// Only projected columns are copied if projection is provided
+int RecordManager::select(
+    const char* tableName, const vector<int>* candidates,
+    const vector<string>* entries, const vector<int>* entryCol,
+    const vector<string>* colName, const vector<int>* cond, const vector<string>* operand,
+    vector<char*>* record, vector<int>* ids,
+    const vector<int>* projection
+)
+{
+    // Get table
+    CatalogManager* manager = MiniSQL::getCatalogManager();
+    Table* table = manager->getTable(tableName);
+    if (table == NULL)
+        return -1;
+
+    Predicate* pred = new Predicate(table, colName, cond, operand);
+    if (!pred->isValid())
+    {
+        delete pred;
+        return -1;
+    }
+
+    int recordLength = table->getRecordLength();
+    int hitLength = projection == NULL ? recordLength : table->getProjectLength(projection);
+
+    // Rebuild each candidate from its entry and check all conditions
+    int hitCount = 0;
+    char* data = new char[recordLength];
+    memset(data, 0, recordLength);
+    for (int i = 0; i < (int)candidates->size(); i++)
+    {
+        const char* entry = entries->at(i).data();
+        for (auto col : *entryCol)
+        {
+            int size = Utils::getTypeSize(table->getColType(col));
+            memcpy(data + table->getColStart(col), entry, size);
+            entry += size;
+        }
+        if (!pred->check(data))
+            continue;
+
+        char* hit = new char[hitLength];
+        if (projection == NULL)
+            memcpy(hit, data, recordLength);
+        else
+            table->project(data, projection, hit);
+
+        record->push_back(hit);
+        ids->push_back(candidates->at(i));
+        hitCount++;
+    }
+
+    delete[] data;
+    delete pred;
+    return hitCount;
+}
+
+// Aggregate records satisfying all conditions while scanning
+// Return number of records aggregated
+int RecordManager::aggregate(
+    const char* tableName, const vector<string>* colName,
+    const vector<int>* cond, const vector<string>* operand,
+    vector<Aggregate*>* aggregates
+)
+{
+    // Get table and record file
+    CatalogManager* manager = MiniSQL::getCatalogManager();
+    Table* table = manager->getTable(tableName);
+    if (table == NULL)
+        return -1;
+
+    // Compile conditions and find blocks to scan by zone map
+    vector<char> blockMask;
+    Predicate* pred = prepareScan(table, colName, cond, operand, &blockMask);
+    if (pred == NULL)
+        return -1;
+
+    HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
+
+    // Iterate through record file. Records are accumulated in place
+    int hitCount = 0;
+    char* dataIn = new char[table->getRecordLength()];
+
+    while (file->getNextRecord(dataIn, &blockMask) >= 0)
+        if (pred->check(dataIn))
+        {
+            for (auto agg : *aggregates)
+                agg->add(dataIn);
+            hitCount++;
+        }
+
+    delete[] dataIn;
+    delete pred;
     delete file;
     return hitCount;
 }
@@ -60,38 +225,252 @@ int RecordManager::insert(const char* tableName, const char* data)
     if (table == NULL)
         return -1;
     HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
+    BloomFilter* bloom = getBloomFilter(table, file->getLiveCount() + 1);
 
-    // Check unique columns
-    char* exist = new char[table->getRecordLength()];
-    while (file->getNextRecord(exist) >= 0)
+    // Check unique columns. Values absent from bloom filter need no lookup
+    // Indexed columns are looked up by index, the others by scanning
+    vector<int> scanCol;
+    for (int i = 0, j = 0; i < table->getColCount(); i++)
     {
-        int colId;
-        if ((colId = table->checkConsistency(data, exist)) >= 0)
+        if (!table->getColUnique(i))
+            continue;
+
+        const char* value = data + table->getColStart(i);
+        if (!bloom->mayContain(j++, value, Utils::getTypeSize(table->getColType(i))))
+            continue;
+
+        Index* index = manager->getIndexByTableCol(tableName, table->getColName(i));
+        if (index == NULL)
+            scanCol.push_back(i);
+        else if (MiniSQL::getIndexManager()->find(index->getName(), value, 1) >= 0)
+            return reportDuplicate(table, i, bloom, file);
+    }
+
+    if (!scanCol.empty())
+    {
+        char* exist = new char[table->getRecordLength()];
+        while (file->getNextRecord(exist) >= 0)
         {
-            // Uniqueness violated! Clean up
-            cerr << "ERROR: [RecordManager::insert] Duplicate values in unique column `" << table->getColName(colId) << "` of table `" << tableName << "`!" << endl;
-            delete[] exist;
-            delete file;
-            return -1;
+            int colId;
+            if ((colId = table->checkConsistency(data, exist, &scanCol)) >= 0)
+            {
+                delete[] exist;
+                return reportDuplicate(table, colId, bloom, file);
+            }
         }
+        delete[] exist;
     }
 
-    // Insert data
+    // Insert data, widen zone map of its block and add unique values to bloom filter
     int ret = file->addRecord(data);
+    ZoneMap* zone = getZoneMap(table);
+    zone->add(ret / file->getRecordBlockCount(), data);
+    updateBloomFilter(table, bloom, data, true);
 
-    delete[] exist;
+    delete zone;
+    delete bloom;
     delete file;
     return ret;
 }
 
-// Delete id-th record from table. Return true if success
-bool RecordManager::remove(const char* tableName, const vector<int>* ids)
+// Delete records satisfying all conditions while scanning
+// Keys of indices in deleted records and their ids are collected
+// Return number of records deleted
+int RecordManager::remove(
+    const char* tableName, const vector<string>* colName,
+    const vector<int>* cond, const vector<string>* operand,
+    const vector<vector<int>>* keyCol, vector<vector<string>>* keys, vector<int>* keyIds
+)
 {
+    // Get table and record file
+    CatalogManager* manager = MiniSQL::getCatalogManager();
+    Table* table = manager->getTable(tableName);
+    if (table == NULL)
+        return -1;
+
+    // Compile conditions and find blocks to scan by zone map
+    vector<char> blockMask;
+    Predicate* pred = prepareScan(table, colName, cond, operand, &blockMask);
+    if (pred == NULL)
+        return -1;
+
     HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
-    for (int i = 0; i < (int)ids->size(); i++)
-        file->deleteRecord(ids->at(i));
+    BloomFilter* bloom = getBloomFilter(table, file->getLiveCount());
+    keys->resize(keyCol->size());
+
+    // Iterate through record file. Hit records are marked deleted in place
+    int id, removeCount = 0;
+    char* dataIn = new char[table->getRecordLength()];
+
+    while ((id = file->getNextRecord(dataIn, &blockMask)) >= 0)
+        if (pred->check(dataIn))
+        {
+            collectKeys(table, dataIn, keyCol, keys);
+            keyIds->push_back(id);
+            updateBloomFilter(table, bloom, dataIn, false);
+            file->deleteRecord(id);
+            removeCount++;
+        }
+
+    delete[] dataIn;
+    delete pred;
+    delete bloom;
     delete file;
-    return true;
+    return removeCount;
+}
+
+// Delete records by id from table
+// Keys of indices in deleted records and their ids are collected
+// Return number of records deleted
+int RecordManager::remove(
+    const char* tableName, const vector<int>* ids,
+    const vector<vector<int>>* keyCol, vector<vector<string>>* keys, vector<int>* keyIds
+)
+{
+    // Get table and record file
+    CatalogManager* manager = MiniSQL::getCatalogManager();
+    Table* table = manager->getTable(tableName);
+    if (table == NULL)
+        return -1;
+
+    HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
+    BloomFilter* bloom = getBloomFilter(table, file->getLiveCount());
+    keys->resize(keyCol->size());
+
+    int removeCount = 0;
+    for (auto id : *ids)
+    {
+        const char* data = file->getRecordById(id);
+        if (data == NULL)
+            continue;
+
+        collectKeys(table, data, keyCol, keys);
+        keyIds->push_back(id);
+        updateBloomFilter(table, bloom, data, false);
+        file->deleteRecord(id);
+        removeCount++;
+    }
+
+    delete bloom;
+    delete file;
+    return removeCount;
+}
+
+// Update records satisfying all conditions in place while scanning
+// Old and new keys of indices whose columns are changed and ids of their records are collected
+// Return number of records updated
+int RecordManager::update(
+    const char* tableName, const vector<string>* colName,
+    const vector<int>* cond, const vector<string>* operand,
+    const vector<int>* setCol, const vector<string>* setData,
+    const vector<vector<int>>* keyCol, vector<vector<string>>* keys,
+    vector<vector<string>>* newKeys, vector<vector<int>>* keyIds
+)
+{
+    // Get table and record file
+    CatalogManager* manager = MiniSQL::getCatalogManager();
+    Table* table = manager->getTable(tableName);
+    if (table == NULL)
+        return -1;
+
+    // Compile conditions and find blocks to scan by zone map
+    vector<char> blockMask;
+    Predicate* pred = prepareScan(table, colName, cond, operand, &blockMask);
+    if (pred == NULL)
+        return -1;
+
+    HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
+    keys->resize(keyCol->size());
+    newKeys->resize(keyCol->size());
+    keyIds->resize(keyCol->size());
+
+    // Iterate through record file. Hit records are overwritten in place
+    int id, updateCount = 0;
+    char* dataIn = new char[table->getRecordLength()];
+
+    // Zone map is widened by new values
+    // Bloom filter is maintained only if unique column is set
+    ZoneMap* zone = getZoneMap(table);
+    BloomFilter* bloom = NULL;
+    for (auto col : *setCol)
+        if (table->getColUnique(col) && bloom == NULL)
+            bloom = getBloomFilter(table, file->getLiveCount());
+
+    while ((id = file->getNextRecord(dataIn, &blockMask)) >= 0)
+        if (pred->check(dataIn))
+        {
+            if (bloom != NULL)
+                updateBloomFilter(table, bloom, dataIn, false);
+            modifyRecord(table, id, dataIn, setCol, setData, keyCol, keys, newKeys, keyIds);
+            if (bloom != NULL)
+                updateBloomFilter(table, bloom, dataIn, true);
+            file->updateRecord(id, dataIn);
+            zone->add(id / file->getRecordBlockCount(), dataIn);
+            updateCount++;
+        }
+
+    delete[] dataIn;
+    delete pred;
+    delete zone;
+    delete bloom;
+    delete file;
+    return updateCount;
+}
+
+// Update records by id in place
+// Old and new keys of indices whose columns are changed and ids of their records are collected
+// Return number of records updated
+int RecordManager::update(
+    const char* tableName, const vector<int>* ids,
+    const vector<int>* setCol, const vector<string>* setData,
+    const vector<vector<int>>* keyCol, vector<vector<string>>* keys,
+    vector<vector<string>>* newKeys, vector<vector<int>>* keyIds
+)
+{
+    // Get table and record file
+    CatalogManager* manager = MiniSQL::getCatalogManager();
+    Table* table = manager->getTable(tableName);
+    if (table == NULL)
+        return -1;
+
+    HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
+    keys->resize(keyCol->size());
+    newKeys->resize(keyCol->size());
+    keyIds->resize(keyCol->size());
+
+    int updateCount = 0;
+    char* dataIn = new char[table->getRecordLength()];
+
+    // Zone map is widened by new values
+    // Bloom filter is maintained only if unique column is set
+    ZoneMap* zone = getZoneMap(table);
+    BloomFilter* bloom = NULL;
+    for (auto col : *setCol)
+        if (table->getColUnique(col) && bloom == NULL)
+            bloom = getBloomFilter(table, file->getLiveCount());
+
+    for (auto id : *ids)
+    {
+        const char* data = file->getRecordById(id);
+        if (data == NULL)
+            continue;
+
+        memcpy(dataIn, data, table->getRecordLength());
+        if (bloom != NULL)
+            updateBloomFilter(table, bloom, dataIn, false);
+        modifyRecord(table, id, dataIn, setCol, setData, keyCol, keys, newKeys, keyIds);
+        if (bloom != NULL)
+            updateBloomFilter(table, bloom, dataIn, true);
+        file->updateRecord(id, dataIn);
+        zone->add(id / file->getRecordBlockCount(), dataIn);
+        updateCount++;
+    }
+
+    delete[] dataIn;
+    delete zone;
+    delete bloom;
+    delete file;
+    return updateCount;
 }
 
 // Create table. Return true if success
@@ -102,6 +481,8 @@ bool RecordManager::createTable(const char* tableName)
     if (table == NULL)
         return false;
     HeapFile::createFile(("record/" + string(tableName)).c_str(), table->getRecordLength());
+    ZoneMap::createFile(("record/" + string(tableName) + ".zone").c_str());
+    delete buildBloomFilter(table, 0);
     return true;
 }
 
@@ -109,112 +490,189 @@ bool RecordManager::createTable(const char* tableName)
 bool RecordManager::dropTable(const char* tableName)
 {
     Utils::deleteFile(("record/" + string(tableName)).c_str());
+    Utils::deleteFile(("record/" + string(tableName) + ".zone").c_str());
+    Utils::deleteFile(("record/" + string(tableName) + ".bloom").c_str());
     return true;
 }
 
-// Check if record satisfy all conditions
-bool RecordManager::checkRecord(
-    const char* record, const char* tableName,
-    const vector<string>* colName, const vector<int>* cond,
-    const vector<string>* operand
-)
+// Vacuum table. Zone map and bloom filter are rebuilt from live records
+// Return true if success
+bool RecordManager::vacuum(const char* tableName)
 {
     CatalogManager* manager = MiniSQL::getCatalogManager();
     Table* table = manager->getTable(tableName);
     if (table == NULL)
         return false;
 
-    int condCount = colName->size();
+    // Zone map is rebuilt by scanning when it is missing
+    Utils::deleteFile(("record/" + string(tableName) + ".zone").c_str());
+    delete getZoneMap(table);
+
+    HeapFile* file = new HeapFile(("record/" + string(tableName)).c_str());
+    delete buildBloomFilter(table, file->getLiveCount());
+    delete file;
+    return true;
+}
+
+// Compile conditions and mark blocks to scan by zone map
+// Return NULL if conditions are invalid
+Predicate* RecordManager::prepareScan(
+    Table* table, const vector<string>* colName,
+    const vector<int>* cond, const vector<string>* operand,
+    vector<char>* blockMask
+)
+{
+    Predicate* pred = new Predicate(table, colName, cond, operand);
+    if (!pred->isValid())
+    {
+        delete pred;
+        return NULL;
+    }
 
-    for (int i = 0; i < condCount; i++)
+    if (pred->getCount() > 0)
     {
-        char dataOut[MAX_VALUE_LENGTH];
-        short type = table->getValue(colName->at(i).c_str(), record, dataOut);
+        ZoneMap* zone = getZoneMap(table);
+        zone->prune(pred, blockMask);
+        delete zone;
+    }
+    return pred;
+}
 
-        if (type <= TYPE_CHAR)
-        {
-            // Char type
-            if (!charCmp(dataOut, operand->at(i).c_str(), cond->at(i)))
-                return false;
-        }
-        else if (type == TYPE_INT)
-        {
-            // Int type
-            if (!intCmp(dataOut, operand->at(i).c_str(), cond->at(i)))
-                return false;
-        }
-        else if (type == TYPE_FLOAT)
-        {
-            // Float type
-            if (!floatCmp(dataOut, operand->at(i).c_str(), cond->at(i)))
-                return false;
-        }
+// Get zone map of table. Zone map is built if it does not exist
+ZoneMap* RecordManager::getZoneMap(Table* table)
+{
+    string filename = "record/" + string(table->getName()) + ".zone";
+    if (Utils::fileExists(filename.c_str()))
+        return new ZoneMap(filename.c_str(), table);
+
+    ZoneMap::createFile(filename.c_str());
+    ZoneMap* zone = new ZoneMap(filename.c_str(), table);
+
+    // Summarize existing records
+    HeapFile* file = new HeapFile(("record/" + string(table->getName())).c_str());
+    char* data = new char[table->getRecordLength()];
+    int id;
+    while ((id = file->getNextRecord(data)) >= 0)
+        zone->add(id / file->getRecordBlockCount(), data);
+
+    delete[] data;
+    delete file;
+    return zone;
+}
+
+// Get bloom filter of table
+// Bloom filter is rebuilt if it does not exist or cannot hold keyCount keys
+BloomFilter* RecordManager::getBloomFilter(Table* table, int keyCount)
+{
+    string filename = "record/" + string(table->getName()) + ".bloom";
+    if (Utils::fileExists(filename.c_str()))
+    {
+        BloomFilter* bloom = new BloomFilter(filename.c_str());
+        if (keyCount <= bloom->getKeyCapacity())
+            return bloom;
+        delete bloom;
     }
+    return buildBloomFilter(table, keyCount);
+}
 
-    return true;
+// Build bloom filter of table from existing records
+// Capacity is doubled from keyCount so that rebuilding is rare
+BloomFilter* RecordManager::buildBloomFilter(Table* table, int keyCount)
+{
+    string filename = "record/" + string(table->getName()) + ".bloom";
+    int filterCount = 0;
+    for (int i = 0; i < table->getColCount(); i++)
+        if (table->getColUnique(i))
+            filterCount++;
+
+    Utils::deleteFile(filename.c_str());
+    BloomFilter::createFile(filename.c_str(), filterCount, keyCount * 2);
+    BloomFilter* bloom = new BloomFilter(filename.c_str());
+
+    // Add unique values of existing records
+    HeapFile* file = new HeapFile(("record/" + string(table->getName())).c_str());
+    char* data = new char[table->getRecordLength()];
+    while (file->getNextRecord(data) >= 0)
+        updateBloomFilter(table, bloom, data, true);
+
+    delete[] data;
+    delete file;
+    return bloom;
 }
 
-// Compare string
-bool RecordManager::charCmp(const char* a, const char* b, int op)
-{
-    if (op == COND_EQ)
-        return strcmp(a, b) == 0;
-    else if (op == COND_NE)
-        return strcmp(a, b) != 0;
-    else if (op == COND_LT)
-        return strcmp(a, b) < 0;
-    else if (op == COND_GT)
-        return strcmp(a, b) > 0;
-    else if (op == COND_LE)
-        return strcmp(a, b) <= 0;
-    else if (op == COND_GE)
-        return strcmp(a, b) >= 0;
-    else
-        return false;
+// Add or remove values of unique columns in record to bloom filter
+void RecordManager::updateBloomFilter(Table* table, BloomFilter* bloom, const char* record, bool add)
+{
+    for (int i = 0, j = 0; i < table->getColCount(); i++)
+    {
+        if (!table->getColUnique(i))
+            continue;
+
+        const char* value = record + table->getColStart(i);
+        int length = Utils::getTypeSize(table->getColType(i));
+        if (add)
+            bloom->add(j++, value, length);
+        else
+            bloom->remove(j++, value, length);
+    }
 }
 
-// Compare int
-bool RecordManager::intCmp(const char* a, const char* b, int op)
-{
-    const int left = *(reinterpret_cast<const int*>(a));
-    int right;
-    sscanf(b, "%d", &right);
-
-    if (op == COND_EQ)
-        return left == right;
-    else if (op == COND_NE)
-        return left != right;
-    else if (op == COND_LT)
-        return left < right;
-    else if (op == COND_GT)
-        return left > right;
-    else if (op == COND_LE)
-        return left <= right;
-    else if (op == COND_GE)
-        return left >= right;
-    else
-        return false;
+// Report duplicate value in unique column and clean up. Return -1
+int RecordManager::reportDuplicate(Table* table, int colId, BloomFilter* bloom, HeapFile* file)
+{
+    cerr << "ERROR: [RecordManager::insert] Duplicate values in unique column `" << table->getColName(colId) << "` of table `" << table->getName() << "`!" << endl;
+    delete bloom;
+    delete file;
+    return -1;
 }
 
-// Compare float
-bool RecordManager::floatCmp(const char* a, const char* b, int op)
-{
-    const float left = *(reinterpret_cast<const float*>(a));
-    float right;
-    sscanf(b, "%f", &right);
-
-    if (op == COND_EQ)
-        return left == right;
-    else if (op == COND_NE)
-        return left != right;
-    else if (op == COND_LT)
-        return left < right;
-    else if (op == COND_GT)
-        return left > right;
-    else if (op == COND_LE)
-        return left <= right;
-    else if (op == COND_GE)
-        return left >= right;
-    else
-        return false;
+// Collect keys of indices in record
+void RecordManager::collectKeys(
+    Table* table, const char* record,
+    const vector<vector<int>>* keyCol, vector<vector<string>>* keys
+)
+{
+    for (int i = 0; i < (int)keyCol->size(); i++)
+        keys->at(i).push_back(table->getKey(record, &keyCol->at(i)));
+}
+
+// Write new values into record
+// Old and new keys of indices whose columns are changed and id of record are collected
+void RecordManager::modifyRecord(
+    Table* table, int id, char* record,
+    const vector<int>* setCol, const vector<string>* setData,
+    const vector<vector<int>>* keyCol, vector<vector<string>>* keys,
+    vector<vector<string>>* newKeys, vector<vector<int>>* keyIds
+)
+{
+    int setCount = (int)setCol->size();
+
+    // Keep old keys of indices on set columns
+    vector<string> oldKeys(keyCol->size());
+    for (int i = 0; i < (int)keyCol->size(); i++)
+        for (auto col : keyCol->at(i))
+            if (find(setCol->begin(), setCol->end(), col) != setCol->end())
+            {
+                oldKeys[i] = table->getKey(record, &keyCol->at(i));
+                break;
+            }
+
+    // Write new values
+    for (int j = 0; j < setCount; j++)
+        memcpy(record + table->getColStart(setCol->at(j)), setData->at(j).data(), setData->at(j).size());
+
+    // Collect keys that are changed
+    for (int i = 0; i < (int)keyCol->size(); i++)
+    {
+        if (oldKeys[i].empty())
+            continue;
+
+        string key = table->getKey(record, &keyCol->at(i));
+        if (key != oldKeys[i])
+        {
+            keys->at(i).push_back(oldKeys[i]);
+            newKeys->at(i).push_back(key);
+            keyIds->at(i).push_back(id);
+        }
+    }
 }
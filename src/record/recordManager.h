@@ -4,6 +4,13 @@
 #include <vector>
 #include <string>
 
+#include "struct/table.h"
+#include "struct/aggregate.h"
+#include "struct/predicate.h"
+#include "file/heapFile.h"
+#include "file/zoneMap.h"
+#include "file/bloomFilter.h"
+
 using namespace std;
 
 class RecordManager
@@ -11,17 +18,82 @@ class RecordManager
 public:
 
     // Select record from table. Return number of records selected
+    // Only projected columns are copied if projection is provided
+    int select(
+        const char* tableName, const vector<string>* colName,
+        const vector<int>* cond, const vector<string>* operand,
+        vector<char*>* record, vector<int>* ids,
+        const vector<int>* projection = NULL
+    );
+
+    // Select records satisfying all conditions from candidate ids
+    // Only projected columns are copied if projection is provided
+    int select(
+        const char* tableName, const vector<int>* candidates,
+        const vector<string>* colName, const vector<int>* cond, const vector<string>* operand,
+        vector<char*>* record, vector<int>* ids,
+        const vector<int>* projection = NULL
+    );
+
+    // Select records satisfying all conditions from index entries without reading record file
+    // Each entry holds data of columns entryCol of record candidate, and other columns are left zero
+    // Only projected columns are copied if projection is provided
     int select(
+        const char* tableName, const vector<int>* candidates,
+        const vector<string>* entries, const vector<int>* entryCol,
+        const vector<string>* colName, const vector<int>* cond, const vector<string>* operand,
+        vector<char*>* record, vector<int>* ids,
+        const vector<int>* projection = NULL
+    );
+
+    // Aggregate records satisfying all conditions while scanning
+    // Return number of records aggregated
+    int aggregate(
         const char* tableName, const vector<string>* colName,
         const vector<int>* cond, const vector<string>* operand,
-        vector<char*>* record, vector<int>* ids
+        vector<Aggregate*>* aggregates
     );
 
     // Insert record into table. Return new index id
     int insert(const char* tableName, const char* data);
 
-    // Delete id-th record from table. Return true if success
-    bool remove(const char* tableName, const vector<int>* ids);
+    // Delete records satisfying all conditions while scanning
+    // Keys of indices in deleted records and their ids are collected
+    // Return number of records deleted
+    int remove(
+        const char* tableName, const vector<string>* colName,
+        const vector<int>* cond, const vector<string>* operand,
+        const vector<vector<int>>* keyCol, vector<vector<string>>* keys, vector<int>* keyIds
+    );
+
+    // Delete records by id from table
+    // Keys of indices in deleted records and their ids are collected
+    // Return number of records deleted
+    int remove(
+        const char* tableName, const vector<int>* ids,
+        const vector<vector<int>>* keyCol, vector<vector<string>>* keys, vector<int>* keyIds
+    );
+
+    // Update records satisfying all conditions in place while scanning
+    // Old and new keys of indices whose columns are changed and ids of their records are collected
+    // Return number of records updated
+    int update(
+        const char* tableName, const vector<string>* colName,
+        const vector<int>* cond, const vector<string>* operand,
+        const vector<int>* setCol, const vector<string>* setData,
+        const vector<vector<int>>* keyCol, vector<vector<string>>* keys,
+        vector<vector<string>>* newKeys, vector<vector<int>>* keyIds
+    );
+
+    // Update records by id in place
+    // Old and new keys of indices whose columns are changed and ids of their records are collected
+    // Return number of records updated
+    int update(
+        const char* tableName, const vector<int>* ids,
+        const vector<int>* setCol, const vector<string>* setData,
+        const vector<vector<int>>* keyCol, vector<vector<string>>* keys,
+        vector<vector<string>>* newKeys, vector<vector<int>>* keyIds
+    );
 
     // Create table. Return true if success
     bool createTable(const char* tableName);
@@ -29,23 +101,51 @@ public:
     // Drop table. Return true if success
     bool dropTable(const char* tableName);
 
-    // Check if record satisfy all conditions
-    bool checkRecord(
-        const char* record, const char* tableName,
-        const vector<string>* colName, const vector<int>* cond,
-        const vector<string>* operand
-    );
+    // Vacuum table. Zone map and bloom filter are rebuilt from live records
+    // Return true if success
+    bool vacuum(const char* tableName);
 
 private:
 
-    // Compare string
-    bool charCmp(const char* a, const char* b, int op);
+    // Compile conditions and mark blocks to scan by zone map
+    // Return NULL if conditions are invalid
+    Predicate* prepareScan(
+        Table* table, const vector<string>* colName,
+        const vector<int>* cond, const vector<string>* operand,
+        vector<char>* blockMask
+    );
+
+    // Get zone map of table. Zone map is built if it does not exist
+    ZoneMap* getZoneMap(Table* table);
+
+    // Get bloom filter of table
+    // Bloom filter is rebuilt if it does not exist or cannot hold keyCount keys
+    BloomFilter* getBloomFilter(Table* table, int keyCount);
+
+    // Build bloom filter of table from existing records
+    // Capacity is doubled from keyCount so that rebuilding is rare
+    BloomFilter* buildBloomFilter(Table* table, int keyCount);
 
-    // Compare int
-    bool intCmp(const char* a, const char* b, int op);
+    // Add or remove values of unique columns in record to bloom filter
+    void updateBloomFilter(Table* table, BloomFilter* bloom, const char* record, bool add);
 
-    // Compare float
-    bool floatCmp(const char* a, const char* b, int op);
+    // Report duplicate value in unique column and clean up. Return -1
+    int reportDuplicate(Table* table, int colId, BloomFilter* bloom, HeapFile* file);
+
+    // Write new values into record
+    // Old and new keys of indices whose columns are changed and id of record are collected
+    void modifyRecord(
+        Table* table, int id, char* record,
+        const vector<int>* setCol, const vector<string>* setData,
+        const vector<vector<int>>* keyCol, vector<vector<string>>* keys,
+        vector<vector<string>>* newKeys, vector<vector<int>>* keyIds
+    );
+
+    // Collect keys of indices in record
+    void collectKeys(
+        Table* table, const char* record,
+        const vector<vector<int>>* keyCol, vector<vector<string>>* keys
+    );
 };
 
 #endif
@@ -0,0 +1,105 @@
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "global.h"
+#include "utils/utils.h"
+#include "struct/aggregate.h"
+
+using namespace std;
+
+// Constructor. Column name is "*" and type is TYPE_NULL for count(*)
+Aggregate::Aggregate(
+    int _func, const char* _colName, short _type, int _start
+): func(_func), colName(_colName), type(_type), start(_start)
+{
+    count = 0;
+    intSum = 0;
+    floatSum = 0;
+}
+
+// Get aggregate title, such as "sum(sage)"
+string Aggregate::getTitle() const
+{
+    static const char* names[] = {"count", "sum", "min", "max", "avg"};
+    return string(names[func]) + "(" + colName + ")";
+}
+
+// Get aggregate function
+int Aggregate::getFunc() const
+{
+    return func;
+}
+
+// Accumulate value of a record
+void Aggregate::add(const char* record)
+{
+    count++;
+    if (func == AGG_COUNT)
+        return;
+
+    const char* value = record + start;
+    if (func == AGG_SUM || func == AGG_AVG)
+    {
+        if (type == TYPE_INT)
+            intSum += *(reinterpret_cast<const int*>(value));
+        else
+            floatSum += *(reinterpret_cast<const float*>(value));
+    }
+    else if (
+        count == 1 ||
+        (func == AGG_MIN && compare(value, best) < 0) ||
+        (func == AGG_MAX && compare(value, best) > 0)
+    )
+        memcpy(best, value, Utils::getTypeSize(type));
+}
+
+// Set number of records directly(used by count(*) without condition)
+void Aggregate::setCount(int _count)
+{
+    count = _count;
+}
+
+// Get aggregate result as string
+string Aggregate::getResult() const
+{
+    ostringstream out;
+
+    if (func == AGG_COUNT)
+        out << count;
+    else if (func == AGG_SUM)
+    {
+        if (type == TYPE_INT)
+            out << intSum;
+        else
+            out << floatSum;
+    }
+    else if (count == 0)
+        // No record for avg/min/max
+        out << "NULL";
+    else if (func == AGG_AVG)
+        out << (type == TYPE_INT ? (double)intSum : floatSum) / count;
+    else
+        out << Utils::getStrFromData(best, type);
+
+    return out.str();
+}
+
+// Compare two values of column type
+int Aggregate::compare(const char* a, const char* b) const
+{
+    if (type <= TYPE_CHAR)
+        return strcmp(a, b);
+    else if (type == TYPE_INT)
+    {
+        int x = *(reinterpret_cast<const int*>(a));
+        int y = *(reinterpret_cast<const int*>(b));
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+    else
+    {
+        float x = *(reinterpret_cast<const float*>(a));
+        float y = *(reinterpret_cast<const float*>(b));
+        return x < y ? -1 : (x > y ? 1 : 0);
+    }
+}
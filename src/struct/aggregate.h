@@ -0,0 +1,62 @@
+#ifndef _AGGREGATE_H
+#define _AGGREGATE_H
+
+#include <string>
+
+#include "global.h"
+
+using namespace std;
+
+class Aggregate
+{
+public:
+
+    // Constructor. Column name is "*" and type is TYPE_NULL for count(*)
+    Aggregate(int _func, const char* _colName, short _type, int _start);
+
+    // Get aggregate title, such as "sum(sage)"
+    string getTitle() const;
+
+    // Get aggregate function
+    int getFunc() const;
+
+    // Accumulate value of a record
+    void add(const char* record);
+
+    // Set number of records directly(used by count(*) without condition)
+    void setCount(int _count);
+
+    // Get aggregate result as string
+    string getResult() const;
+
+private:
+
+    // Aggregate function
+    int func;
+
+    // Column name
+    string colName;
+
+    // Column type
+    short type;
+
+    // Starting position of column in record
+    int start;
+
+    // Number of records accumulated
+    int count;
+
+    // Sum of int values
+    long long intSum;
+
+    // Sum of float values
+    double floatSum;
+
+    // Current min/max value
+    char best[MAX_VALUE_LENGTH];
+
+    // Compare two values of column type
+    int compare(const char* a, const char* b) const;
+};
+
+#endif
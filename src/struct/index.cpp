@@ -1,16 +1,27 @@
+#include <cstring>
 #include <iostream>
 
 #include "global.h"
+#include "minisql.h"
 #include "struct/index.h"
 
 using namespace std;
 
+// Percentage of entries modified since analysis beyond which statistics are not used
+const int Index::STALE_PERCENT = 20;
+
 // Constructor
 Index::Index(const char* data)
 {
     name = data;
     tableName = data + MAX_NAME_LENGTH;
-    colName = data + MAX_NAME_LENGTH*2;
+    colNameList.push_back(data + MAX_NAME_LENGTH*2);
+    type = data[MAX_NAME_LENGTH*3];
+    includeCount = data[MAX_NAME_LENGTH*3 + 1];
+    colLoaded = false;
+    analyzed = false;
+    statsLoaded = false;
+    statsDirty = false;
 }
 
 // Get index name
@@ -25,10 +36,97 @@ const char* Index::getTableName() const
     return tableName.c_str();
 }
 
-// Get column name
-const char* Index::getColName() const
+// Get index type
+int Index::getType() const
+{
+    return type;
+}
+
+// Get number of columns, including included columns
+int Index::getColCount()
+{
+    if (!colLoaded)
+        loadColInfo();
+    return colNameList.size();
+}
+
+// Get number of key columns. Included columns follow key columns
+int Index::getKeyColCount()
+{
+    return getColCount() - includeCount;
+}
+
+// Get column name by position in index
+const char* Index::getColName(int id)
+{
+    if (id > 0 && !colLoaded)
+        loadColInfo();
+    return colNameList[id].c_str();
+}
+
+// Get statistics, or NULL if index is not analyzed or statistics are stale
+const IndexStats* Index::getStats()
+{
+    if (!statsLoaded)
+        loadStats();
+    if (!analyzed || (long long)stats.modifiedCount * 100 > (long long)stats.entryCount * STALE_PERCENT)
+        return NULL;
+    return &stats;
+}
+
+// Set statistics
+void Index::setStats(const IndexStats* _stats)
+{
+    stats = *_stats;
+    analyzed = true;
+    statsLoaded = true;
+    statsDirty = false;
+}
+
+// Count entries modified since index was analyzed
+void Index::addModified(int count)
+{
+    if (!statsLoaded)
+        loadStats();
+    if (!analyzed || count == 0)
+        return;
+    stats.modifiedCount += count;
+    statsDirty = true;
+}
+
+// Write statistics back to catalog file if modification count is changed
+void Index::flushStats()
 {
-    return colName.c_str();
+    if (statsDirty)
+        MiniSQL::getCatalogManager()->setIndexStats(name.c_str(), &stats);
+}
+
+// Estimate number of entries whose first column equals encoded key. Index must be analyzed
+double Index::estimateEqual(const char* key)
+{
+    // Values in a bucket are taken as equally frequent. A value beyond all buckets is taken as rare
+    for (int i = 0; i < (int)stats.bound.size(); i++)
+        if (memcmp(stats.bound[i].data(), key, stats.bound[i].size()) >= 0)
+            return 1.0 * stats.bucketCount[i] / stats.bucketDistinct[i];
+    return 1;
+}
+
+// Estimate number of entries whose first column is less than encoded key. Index must be analyzed
+double Index::estimateLess(const char* key)
+{
+    // Entries of the bucket holding key are taken as half below it, unless key is its bound
+    double rows = 0;
+    for (int i = 0; i < (int)stats.bound.size(); i++)
+    {
+        int res = memcmp(stats.bound[i].data(), key, stats.bound[i].size());
+        if (res < 0)
+            rows += stats.bucketCount[i];
+        else if (res == 0)
+            return rows + stats.bucketCount[i] - 1.0 * stats.bucketCount[i] / stats.bucketDistinct[i];
+        else
+            return rows + stats.bucketCount[i] / 2.0;
+    }
+    return rows;
 }
 
 #ifdef DEBUG
@@ -36,7 +134,27 @@ const char* Index::getColName() const
 void Index::debugPrint() const
 {
     cerr << "DEBUG: [Index::debugPrint]" << endl;
-    cerr << "Index name = " << name << ", table name = " << tableName << ", column name = " << colName << endl;
-    cerr << "----------------------------------------" << endl;
+    cerr << "Index name = " << name << ", table name = " << tableName << ", type = " << type << ", included = " << includeCount << ", column name =";
+    for (auto colName : colNameList)
+        cerr << " " << colName;
+    cerr << endl << "----------------------------------------" << endl;
 }
 #endif
+
+// Load column info from catalog file
+// Index without column file is built on the column in its catalog record
+void Index::loadColInfo()
+{
+    vector<string> vec;
+    if (MiniSQL::getCatalogManager()->loadIndexColInfo(name.c_str(), &vec) > 0)
+        colNameList.swap(vec);
+    colLoaded = true;
+}
+
+// Load statistics from catalog file
+// Index without statistics file is not analyzed
+void Index::loadStats()
+{
+    analyzed = MiniSQL::getCatalogManager()->loadIndexStats(name.c_str(), &stats);
+    statsLoaded = true;
+}
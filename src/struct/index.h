@@ -2,13 +2,43 @@
 #define _INDEX_H
 
 #include <string>
+#include <vector>
 
 using namespace std;
 
+// Statistics of a B+ tree index collected by analyze
+struct IndexStats
+{
+    // Number of levels, nodes and leaves
+    int height;
+    int nodeCount;
+    int leafCount;
+
+    // Average percentage of each leaf block in use
+    int leafFill;
+
+    // Number of entries
+    int entryCount;
+
+    // Number of distinct values of first i+1 columns
+    vector<int> distinct;
+
+    // Equi-depth histogram of first column. Bucket i holds entries up to encoded bound i
+    vector<string> bound;
+    vector<int> bucketCount;
+    vector<int> bucketDistinct;
+
+    // Number of entries inserted, removed or updated since index was analyzed
+    int modifiedCount;
+};
+
 class Index
 {
 public:
 
+    // Percentage of entries modified since analysis beyond which statistics are not used
+    static const int STALE_PERCENT;
+
     // Constructor
     Index(const char* data);
 
@@ -18,8 +48,35 @@ public:
     // Get table name
     const char* getTableName() const;
 
-    // Get column name
-    const char* getColName() const;
+    // Get index type
+    int getType() const;
+
+    // Get number of columns, including included columns
+    int getColCount();
+
+    // Get number of key columns. Included columns follow key columns
+    int getKeyColCount();
+
+    // Get column name by position in index
+    const char* getColName(int id = 0);
+
+    // Get statistics, or NULL if index is not analyzed or statistics are stale
+    const IndexStats* getStats();
+
+    // Set statistics
+    void setStats(const IndexStats* _stats);
+
+    // Count entries modified since index was analyzed
+    void addModified(int count);
+
+    // Write statistics back to catalog file if modification count is changed
+    void flushStats();
+
+    // Estimate number of entries whose first column equals encoded key. Index must be analyzed
+    double estimateEqual(const char* key);
+
+    // Estimate number of entries whose first column is less than encoded key. Index must be analyzed
+    double estimateLess(const char* key);
 
 #ifdef DEBUG
     // Print index info
@@ -34,8 +91,33 @@ private:
     // Table name
     string tableName;
 
-    // Column name
-    string colName;
+    // Index type
+    int type;
+
+    // Number of included columns
+    int includeCount;
+
+    // Column name list. First column is also kept in catalog record
+    vector<string> colNameList;
+
+    // If column info is loaded
+    bool colLoaded;
+
+    // Statistics, valid if analyzed
+    IndexStats stats;
+    bool analyzed;
+
+    // If statistics are loaded
+    bool statsLoaded;
+
+    // If modification count is changed but not written back
+    bool statsDirty;
+
+    // Load column info from catalog file
+    void loadColInfo();
+
+    // Load statistics from catalog file
+    void loadStats();
 };
 
 #endif
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "global.h"
+#include "utils/utils.h"
+#include "struct/predicate.h"
+
+using namespace std;
+
+// Constructor. Compile conditions on table
+Predicate::Predicate(
+    Table* table, const vector<string>* colName,
+    const vector<int>* _cond, const vector<string>* _operand
+)
+{
+    valid = true;
+
+    for (int i = 0; i < (int)colName->size(); i++)
+    {
+        int id = table->getId(colName->at(i).c_str());
+        if (id < 0)
+        {
+            cerr << "ERROR: [Predicate::Predicate] Table `" << table->getName() << "` has no column named `" << colName->at(i) << "`!" << endl;
+            valid = false;
+            return;
+        }
+
+        short type = table->getColType(id);
+        colId.push_back(id);
+        colStart.push_back(table->getColStart(id));
+        colType.push_back(type);
+        cond.push_back(_cond->at(i));
+        operand.push_back(vector<string>());
+        inKey.push_back(vector<string>());
+
+        if (_cond->at(i) != COND_IN)
+        {
+            if (!addOperand(i, _operand->at(i)))
+                return;
+            continue;
+        }
+
+        // Values of condition in are kept as sorted encoded keys
+        // Char value longer than column never matches and is dropped
+        int size = Utils::getTypeSize(type);
+        vector<string> values;
+        Utils::splitList(_operand->at(i), &values);
+        for (auto& value : values)
+        {
+            if (type <= TYPE_CHAR && (int)value.size() >= size)
+                continue;
+            if (!addOperand(i, value))
+                return;
+
+            string& data = operand[i].back();
+            data.resize(size, 0);
+            inKey[i].push_back(string(size, 0));
+            Utils::encodeKey(data.data(), type, &inKey[i].back()[0]);
+        }
+        sort(inKey[i].begin(), inKey[i].end());
+        inKey[i].erase(unique(inKey[i].begin(), inKey[i].end()), inKey[i].end());
+
+        // Operands follow the order of keys
+        operand[i].clear();
+        for (auto& key : inKey[i])
+        {
+            operand[i].push_back(string(size, 0));
+            Utils::decodeKey(key.data(), type, &operand[i].back()[0]);
+        }
+    }
+}
+
+// Parse value and append it to operands of i-th condition. Return true if success
+bool Predicate::addOperand(int i, const string& value)
+{
+    if (colType[i] <= TYPE_CHAR)
+    {
+        // Char operand may be longer than column
+        operand[i].push_back(value);
+        return true;
+    }
+
+    // Parse int and float operand only once
+    char* data = Utils::getDataFromStr(value.c_str(), colType[i]);
+    if (data == NULL)
+    {
+        valid = false;
+        return false;
+    }
+    operand[i].push_back(string(data, Utils::getTypeSize(colType[i])));
+    delete[] data;
+    return true;
+}
+
+// If all conditions are compiled successfully
+bool Predicate::isValid() const
+{
+    return valid;
+}
+
+// Get number of conditions
+int Predicate::getCount() const
+{
+    return (int)cond.size();
+}
+
+// Get column id of i-th condition
+int Predicate::getColId(int i) const
+{
+    return colId[i];
+}
+
+// Get column type of i-th condition
+short Predicate::getType(int i) const
+{
+    return colType[i];
+}
+
+// Get operator of i-th condition
+int Predicate::getCond(int i) const
+{
+    return cond[i];
+}
+
+// Get number of operands of i-th condition. Condition in has one operand for each value
+int Predicate::getOperandCount(int i) const
+{
+    return (int)operand[i].size();
+}
+
+// Get j-th binary operand of i-th condition. Char operand is kept as string
+// Operands of condition in are sorted and distinct
+const char* Predicate::getOperand(int i, int j) const
+{
+    return operand[i][j].c_str();
+}
+
+// Check if record satisfies all conditions
+bool Predicate::check(const char* record) const
+{
+    for (int i = 0; i < (int)cond.size(); i++)
+    {
+        const char* value = record + colStart[i];
+        int op = cond[i];
+        bool res;
+
+        if (op == COND_IN)
+        {
+            // Look for encoded value among sorted keys
+            char key[TYPE_CHAR + 1];
+            Utils::encodeKey(value, colType[i], key);
+            res = binary_search(
+                inKey[i].begin(), inKey[i].end(), string(key, Utils::getTypeSize(colType[i]))
+            );
+        }
+        else if (colType[i] == TYPE_FLOAT)
+        {
+            // Float type. Compare directly to keep semantics of NaN
+            float left = *(reinterpret_cast<const float*>(value));
+            float right = *(reinterpret_cast<const float*>(operand[i][0].data()));
+
+            if (op == COND_EQ)
+                res = left == right;
+            else if (op == COND_NE)
+                res = left != right;
+            else if (op == COND_LT)
+                res = left < right;
+            else if (op == COND_GT)
+                res = left > right;
+            else if (op == COND_LE)
+                res = left <= right;
+            else
+                res = left >= right;
+        }
+        else
+        {
+            int cmp;
+            if (colType[i] <= TYPE_CHAR)
+                // Char type
+                cmp = strcmp(value, operand[i][0].c_str());
+            else
+            {
+                // Int type
+                int left = *(reinterpret_cast<const int*>(value));
+                int right = *(reinterpret_cast<const int*>(operand[i][0].data()));
+                cmp = left < right ? -1 : (left > right ? 1 : 0);
+            }
+
+            if (op == COND_EQ)
+                res = cmp == 0;
+            else if (op == COND_NE)
+                res = cmp != 0;
+            else if (op == COND_LT)
+                res = cmp < 0;
+            else if (op == COND_GT)
+                res = cmp > 0;
+            else if (op == COND_LE)
+                res = cmp <= 0;
+            else
+                res = cmp >= 0;
+        }
+
+        if (!res)
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef _PREDICATE_H
+#define _PREDICATE_H
+
+#include <vector>
+#include <string>
+
+#include "struct/table.h"
+
+using namespace std;
+
+class Predicate
+{
+public:
+
+    // Constructor. Compile conditions on table
+    Predicate(
+        Table* table, const vector<string>* colName,
+        const vector<int>* cond, const vector<string>* operand
+    );
+
+    // If all conditions are compiled successfully
+    bool isValid() const;
+
+    // Get number of conditions
+    int getCount() const;
+
+    // Get column id of i-th condition
+    int getColId(int i) const;
+
+    // Get column type of i-th condition
+    short getType(int i) const;
+
+    // Get operator of i-th condition
+    int getCond(int i) const;
+
+    // Get number of operands of i-th condition. Condition in has one operand for each value
+    int getOperandCount(int i) const;
+
+    // Get j-th binary operand of i-th condition. Char operand is kept as string
+    // Operands of condition in are sorted and distinct
+    const char* getOperand(int i, int j = 0) const;
+
+    // Check if record satisfies all conditions
+    bool check(const char* record) const;
+
+private:
+
+    // If all conditions are compiled successfully
+    bool valid;
+
+    // Column id of each condition
+    vector<int> colId;
+
+    // Starting position of each column in record
+    vector<int> colStart;
+
+    // Column type of each condition
+    vector<short> colType;
+
+    // Operator of each condition
+    vector<int> cond;
+
+    // Binary operands of each condition
+    vector<vector<string>> operand;
+
+    // Sorted encoded keys of operands of each condition in. Empty for other conditions
+    vector<vector<string>> inKey;
+
+    // Parse value and append it to operands of i-th condition. Return true if success
+    bool addOperand(int i, const string& value);
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 
 #include "utils/utils.h"
@@ -57,6 +58,45 @@ const char* Table::getColName(int id)
     return colNameList[id].c_str();
 }
 
+// Get column type by id
+short Table::getColType(int id)
+{
+    if (colCount == 0)
+        loadColInfo();
+    if (id >= colCount)
+    {
+        cerr << "ERROR: [Table::getColType] Column id " << id << " too large!" << endl;
+        return TYPE_NULL;
+    }
+    return colType[id];
+}
+
+// Get starting position of column in record by id
+int Table::getColStart(int id)
+{
+    if (colCount == 0)
+        loadColInfo();
+    if (id >= colCount)
+    {
+        cerr << "ERROR: [Table::getColStart] Column id " << id << " too large!" << endl;
+        return -1;
+    }
+    return startPos[id];
+}
+
+// Get column unique by id
+char Table::getColUnique(int id)
+{
+    if (colCount == 0)
+        loadColInfo();
+    if (id >= colCount)
+    {
+        cerr << "ERROR: [Table::getColUnique] Column id " << id << " too large!" << endl;
+        return 0;
+    }
+    return colUnique[id];
+}
+
 // Get id by column name
 int Table::getId(const char* colName)
 {
@@ -115,14 +155,17 @@ char Table::getUnique(const char* colName)
 }
 
 // Check consistency(uniqueness) of new data and existing data
+// Only given columns are checked if cols is provided
 // Return -1 if consistent, else return column id of not unique column
-int Table::checkConsistency(const char* data, const char* exist)
+int Table::checkConsistency(const char* data, const char* exist, const vector<int>* cols)
 {
     if (colCount == 0)
         loadColInfo();
 
-    for (int i = 0; i < colCount; i++)
+    int checkCount = cols == NULL ? colCount : (int)cols->size();
+    for (int k = 0; k < checkCount; k++)
     {
+        int i = cols == NULL ? k : cols->at(k);
         if (!colUnique[i])
             continue;
 
@@ -136,6 +179,44 @@ int Table::checkConsistency(const char* data, const char* exist)
     return -1;
 }
 
+// Get length of projected columns
+int Table::getProjectLength(const vector<int>* cols)
+{
+    if (colCount == 0)
+        loadColInfo();
+
+    int length = 0;
+    for (auto id : *cols)
+        length += Utils::getTypeSize(colType[id]);
+    return length;
+}
+
+// Copy projected columns of record into data
+void Table::project(const char* record, const vector<int>* cols, char* data)
+{
+    if (colCount == 0)
+        loadColInfo();
+
+    for (auto id : *cols)
+    {
+        int size = Utils::getTypeSize(colType[id]);
+        memcpy(data, record + startPos[id], size);
+        data += size;
+    }
+}
+
+// Concatenate values of columns in record. Return key
+string Table::getKey(const char* data, const vector<int>* cols)
+{
+    if (colCount == 0)
+        loadColInfo();
+
+    string key;
+    for (auto id : *cols)
+        key.append(data + startPos[id], Utils::getTypeSize(colType[id]));
+    return key;
+}
+
 // Parse record to vector. Return true if success
 bool Table::recordToVec(const char* data, vector<char*>* vec)
 {
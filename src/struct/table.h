@@ -30,6 +30,15 @@ public:
     // Get column name by id
     const char* getColName(int id);
 
+    // Get column type by id
+    short getColType(int id);
+
+    // Get starting position of column in record by id
+    int getColStart(int id);
+
+    // Get column unique by id
+    char getColUnique(int id);
+
     // Get id by column name
     int getId(const char* colName);
 
@@ -43,8 +52,18 @@ public:
     char getUnique(const char* colName);
 
     // Check consistency(uniqueness) of new data and existing data
+    // Only given columns are checked if cols is provided
     // Return -1 if consistent, else return column id of not unique column
-    int checkConsistency(const char* data, const char* exist);
+    int checkConsistency(const char* data, const char* exist, const vector<int>* cols = NULL);
+
+    // Get length of projected columns
+    int getProjectLength(const vector<int>* cols);
+
+    // Copy projected columns of record into data
+    void project(const char* record, const vector<int>* cols, char* data);
+
+    // Concatenate values of columns in record. Return key
+    string getKey(const char* data, const vector<int>* cols);
 
     // Parse record to vector. Return true if success
     bool recordToVec(const char* data, vector<char*>* vec);
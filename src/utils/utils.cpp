@@ -1,5 +1,6 @@
 #include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 #include "global.h"
@@ -83,10 +84,126 @@ char* Utils::getDataFromStr(const char* s, int type)
             cerr << "ERROR: [Utils::getDataFromStr] Expecting float, but found '" << s << "'." << endl;
             return NULL;
         }
+
+        // -0 and 0 are the same value
+        if (value == 0)
+            value = 0;
         
         key = new char[size]();
         memcpy(key, &value, size);
     }
     
     return key;
-}
\ No newline at end of file
+}
+
+// Format binary data to string according to type
+string Utils::getStrFromData(const char* data, int type)
+{
+    ostringstream out;
+
+    if (type <= TYPE_CHAR)
+        out << data;
+    else if (type == TYPE_INT)
+        out << *(reinterpret_cast<const int*>(data));
+    else if (type == TYPE_FLOAT)
+        out << *(reinterpret_cast<const float*>(data));
+
+    return out.str();
+}
+
+// Encode binary data to key whose bytewise order is the order of values
+void Utils::encodeKey(const char* data, int type, char* key)
+{
+    if (type <= TYPE_CHAR)
+    {
+        // Chars are padded with zero, so they already compare bytewise
+        memcpy(key, data, getTypeSize(type));
+        return;
+    }
+
+    unsigned int bits;
+    memcpy(&bits, data, 4);
+    if (type == TYPE_INT)
+        // Flip sign bit so negative values come first
+        bits ^= 0x80000000u;
+    else if (type == TYPE_FLOAT)
+    {
+        // Flip all bits of negative values and only sign bit of the others
+        if (bits == 0x80000000u)
+            bits = 0;
+        bits = (bits & 0x80000000u) ? ~bits : bits ^ 0x80000000u;
+    }
+
+    // Store big-endian
+    for (int i = 0; i < 4; i++)
+        key[i] = (char)(bits >> (24 - i * 8));
+}
+
+// Encode concatenated binary data of types to key, one value after another
+void Utils::encodeKey(const char* data, const vector<short>* types, char* key)
+{
+    for (auto type : *types)
+    {
+        encodeKey(data, type, key);
+        data += getTypeSize(type);
+        key += getTypeSize(type);
+    }
+}
+
+// Decode key of type back to binary data. Negative zero comes back as zero
+void Utils::decodeKey(const char* key, int type, char* data)
+{
+    if (type <= TYPE_CHAR)
+    {
+        memcpy(data, key, getTypeSize(type));
+        return;
+    }
+
+    unsigned int bits = 0;
+    for (int i = 0; i < 4; i++)
+        bits = bits << 8 | (unsigned char)key[i];
+    if (type == TYPE_INT)
+        bits ^= 0x80000000u;
+    else if (type == TYPE_FLOAT)
+        // Keys with sign bit set come from non-negative values
+        bits = (bits & 0x80000000u) ? bits ^ 0x80000000u : ~bits;
+    memcpy(data, &bits, 4);
+}
+
+// Decode key of types back to concatenated binary data
+void Utils::decodeKey(const char* key, const vector<short>* types, char* data)
+{
+    for (auto type : *types)
+    {
+        decodeKey(key, type, data);
+        key += getTypeSize(type);
+        data += getTypeSize(type);
+    }
+}
+
+// Split operand of condition in into its values
+void Utils::splitList(const string& s, vector<string>* values)
+{
+    size_t start = 0, end;
+    while ((end = s.find(LIST_SEPARATOR, start)) != string::npos)
+    {
+        values->push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+    values->push_back(s.substr(start));
+}
+
+// Compare binary data of type. Return negative, zero or positive like memcmp
+int Utils::compareData(const char* a, const char* b, int type)
+{
+    int size = getTypeSize(type);
+    char* keyA = new char[size];
+    char* keyB = new char[size];
+    encodeKey(a, type, keyA);
+    encodeKey(b, type, keyB);
+
+    int ret = memcmp(keyA, keyB, size);
+    delete[] keyA;
+    delete[] keyB;
+    return ret;
+}
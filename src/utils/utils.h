@@ -1,6 +1,11 @@
 #ifndef _UTILS_H
 #define _UTILS_H
 
+#include <string>
+#include <vector>
+
+using namespace std;
+
 class Utils
 {
 public:
@@ -16,6 +21,27 @@ public:
     
     // Parse string to binary data according to type
     static char* getDataFromStr(const char* s, int type);
+
+    // Format binary data to string according to type
+    static string getStrFromData(const char* data, int type);
+
+    // Encode binary data to key whose bytewise order is the order of values
+    static void encodeKey(const char* data, int type, char* key);
+
+    // Encode concatenated binary data of types to key, one value after another
+    static void encodeKey(const char* data, const vector<short>* types, char* key);
+
+    // Decode key of type back to binary data. Negative zero comes back as zero
+    static void decodeKey(const char* key, int type, char* data);
+
+    // Decode key of types back to concatenated binary data
+    static void decodeKey(const char* key, const vector<short>* types, char* data);
+
+    // Split operand of condition in into its values
+    static void splitList(const string& s, vector<string>* values);
+
+    // Compare binary data of type. Return negative, zero or positive like memcmp
+    static int compareData(const char* a, const char* b, int type);
 };
 
 #endif
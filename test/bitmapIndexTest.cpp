@@ -0,0 +1,178 @@
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "minisql.h"
+#include "utils/utils.h"
+#include "buffer/bufferManager.h"
+#include "index/bitmapIndex.h"
+#include "test.h"
+
+using namespace std;
+
+// Test file and length of its keys
+static const char* FILENAME = "index/test_bitmap";
+static const int KEY_LENGTH = 8;
+
+// Get key of number
+static string makeKey(int i)
+{
+    char key[KEY_LENGTH + 1];
+    snprintf(key, sizeof(key), "%0*d", KEY_LENGTH, i);
+    return string(key, KEY_LENGTH);
+}
+
+// Write index back to file and open it again
+static BitmapIndex* reopen(BitmapIndex* index)
+{
+    index->flushHeader();
+    delete index;
+    MiniSQL::getBufferManager()->flush();
+    return new BitmapIndex(FILENAME);
+}
+
+// Get number of blocks in file
+static int getFileBlockCount()
+{
+    FILE* file = fopen(("data/" + string(FILENAME) + ".mdb").c_str(), "rb");
+    fseek(file, 0, SEEK_END);
+    int size = ftell(file);
+    fclose(file);
+    return (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+// Count blocks of file modified since buffer was flushed
+static int countDirtyBlocks()
+{
+    int count = 0;
+    for (int id = 0; id < getFileBlockCount() + 4; id++)
+        count += MiniSQL::getBufferManager()->getBlock(FILENAME, id)->dirty;
+    return count;
+}
+
+// Check that index holds exactly the record ids of each key
+static void checkContent(BitmapIndex* index, const map<string, set<int>>* expected, const string& testName)
+{
+    int errors = 0;
+    vector<string> keys;
+    vector<const Bitmap*> bitmaps;
+    index->findRange(NULL, true, NULL, true, &keys, &bitmaps);
+    if (keys.size() != expected->size())
+        errors++;
+    for (int i = 0; i < (int)keys.size(); i++)
+    {
+        auto it = expected->find(keys[i]);
+        vector<int> ids;
+        bitmaps[i]->getIds(&ids);
+        if (it == expected->end() || vector<int>(it->second.begin(), it->second.end()) != ids)
+            errors++;
+    }
+    check(errors == 0, testName + ": " + to_string(errors) + " key(s) differ from record ids added");
+}
+
+// Random record ids are added to and removed from keys, and index is reopened from file now and then
+// Keys whose ids are all removed are dropped, and may come back later
+static void testReopen()
+{
+    const int keyCount = 20, roundCount = 20, opCount = 5000, maxId = 300000;
+    BitmapIndex::createFile(FILENAME, KEY_LENGTH);
+    BitmapIndex* index = new BitmapIndex(FILENAME);
+    map<string, set<int>> expected;
+
+    mt19937 rng(1);
+    for (int round = 0; round < roundCount; round++)
+    {
+        for (int i = 0; i < opCount; i++)
+        {
+            string key = makeKey(rng() % keyCount);
+            int id = rng() % maxId;
+            if (rng() % 3 == 0 && !expected[key].empty())
+                id = *expected[key].begin();
+            bool removing = expected[key].count(id) > 0;
+            bool done = removing ? index->remove(key.data(), id) : index->add(key.data(), id);
+            if (!done)
+                check(false, "testReopen: record id is not " + string(removing ? "removed" : "added"));
+            if (removing)
+                expected[key].erase(id);
+            else
+                expected[key].insert(id);
+            if (expected[key].empty())
+                expected.erase(key);
+        }
+
+        // Every fifth round shrinks a few keys to nothing
+        if (round % 5 == 4)
+            for (int k = 0; k < keyCount; k += 7)
+            {
+                string key = makeKey(k);
+                for (int id : expected[key])
+                    index->remove(key.data(), id);
+                expected.erase(key);
+            }
+
+        if (round % 2 == 1)
+            index = reopen(index);
+        checkContent(index, &expected, "testReopen");
+    }
+
+    delete index;
+    Utils::deleteFile(FILENAME);
+}
+
+// Writing back a single added record id only changes blocks of its key, directory and header
+// Blocks freed by a shrinking bitmap are reused when it grows again, so file does not grow
+static void testChangedBlocks()
+{
+    const int keyCount = 10, idCount = 20000;
+    BitmapIndex::createFile(FILENAME, KEY_LENGTH);
+    BitmapIndex* index = new BitmapIndex(FILENAME);
+    for (int k = 0; k < keyCount; k++)
+        for (int i = 0; i < idCount; i++)
+            index->add(makeKey(k).data(), i * 7 + k);
+    index = reopen(index);
+
+    index->add(makeKey(0).data(), 1);
+    index->flushHeader();
+    int dirtyCount = countDirtyBlocks();
+    check(dirtyCount <= 3, "testChangedBlocks: " + to_string(dirtyCount) + " blocks are written for one record id");
+    index = reopen(index);
+
+    // Ids of the first key are removed and added again
+    int blockCount = getFileBlockCount();
+    for (int i = 0; i < idCount; i++)
+        index->remove(makeKey(0).data(), i * 7);
+    index = reopen(index);
+    for (int i = 0; i < idCount; i++)
+        index->add(makeKey(0).data(), i * 7);
+    index = reopen(index);
+    check(
+        getFileBlockCount() <= blockCount,
+        "testChangedBlocks: file grows from " + to_string(blockCount) + " to " + to_string(getFileBlockCount()) + " blocks"
+    );
+
+    map<string, set<int>> expected;
+    for (int k = 0; k < keyCount; k++)
+        for (int i = 0; i < idCount; i++)
+            expected[makeKey(k)].insert(i * 7 + k);
+    expected[makeKey(0)].insert(1);
+    checkContent(index, &expected, "testChangedBlocks");
+
+    delete index;
+    Utils::deleteFile(FILENAME);
+}
+
+// Main function
+int main()
+{
+    MiniSQL::init();
+
+    testReopen();
+    testChangedBlocks();
+
+    MiniSQL::cleanUp();
+    return report("bitmapIndexTest");
+}
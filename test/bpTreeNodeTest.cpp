@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "minisql.h"
+#include "utils/utils.h"
+#include "index/bpTree.h"
+#include "index/bpTreeNode.h"
+#include "test.h"
+
+using namespace std;
+
+// Test file
+static const char* FILENAME = "index/test_node";
+
+// Number of probes checked
+static int probeCount = 0;
+
+// Fill node with count random keys whose suffix after their common prefix is suffixLength bytes
+// Keys are returned in order. Return false if they do not fit. Suffix bytes take all 256 values, so compares must treat them as unsigned
+static bool fillNode(BPTreeNode* node, int keyLength, int suffixLength, int count, mt19937* rng, vector<string>* keys)
+{
+    string prefix;
+    for (int i = 0; i < keyLength - suffixLength; i++)
+        prefix += (char)((*rng)() % 256);
+
+    // First and last keys differ in first suffix byte, so common prefix is exactly prefix
+    set<string> keySet;
+    while ((int)keySet.size() < count)
+    {
+        string key = prefix;
+        for (int i = 0; i < suffixLength; i++)
+            key += (char)((*rng)() % 256);
+        keySet.insert(key);
+        if ((int)keySet.size() == count && count > 1 && keySet.begin()->at(prefix.size()) == keySet.rbegin()->at(prefix.size()))
+            keySet.erase(keySet.begin());
+    }
+    keys->assign(keySet.begin(), keySet.end());
+
+    string data;
+    vector<int> ptrs;
+    for (int i = 0; i < count; i++)
+    {
+        data += keys->at(i);
+        ptrs.push_back(i);
+    }
+    return node->assign(data.data(), ptrs.data(), count);
+}
+
+// Check position found in node against binary search over keys in order
+// Positions come from suffixes compared four at a time if SSE2 is available, and one at a time otherwise
+static bool checkProbe(BPTreeNode* node, const vector<string>* keys, const string& key)
+{
+    int expected = upper_bound(keys->begin(), keys->end(), key) - keys->begin();
+    int ptr;
+    bool found;
+    int pos = node->findPosition(key.data());
+    int probePos = node->probe(key.data(), &ptr, &found);
+    bool expectedFound = expected > 0 && keys->at(expected - 1) == key;
+
+    probeCount++;
+    return pos == expected && probePos == expected && found == expectedFound && ptr == (expected > 0 ? expected - 1 : -1);
+}
+
+// Keys of every suffix length up to 4 and a few longer ones are probed in nodes of every size up to 64
+// Sizes which are not multiples of 4 leave a partial group after the last four entries compared together
+static void testCountNotGreater()
+{
+    mt19937 rng(1);
+    const int keyLength = 8;
+    BPTree::createFile(FILENAME, keyLength);
+    BPTreeNode* node = new BPTreeNode(FILENAME, 1, keyLength, -1);
+
+    for (int suffixLength = 0; suffixLength <= keyLength; suffixLength++)
+    {
+        // A suffix of s bytes tells at most 256^s keys apart
+        int maxCount = suffixLength == 0 ? 1 : suffixLength == 1 ? 256 : 300;
+        vector<int> counts;
+        for (int count = 0; count <= min(64, maxCount); count++)
+            counts.push_back(count);
+        counts.push_back(maxCount);
+
+        for (int count : counts)
+        {
+            string testCase = "suffix length " + to_string(suffixLength) + ", size " + to_string(count);
+            int errors = 0;
+            for (int trial = 0; trial < 8; trial++)
+            {
+                vector<string> keys;
+                if (!fillNode(node, keyLength, suffixLength, count, &rng, &keys))
+                {
+                    check(false, testCase + ": keys do not fit in node");
+                    continue;
+                }
+
+                // Every key, with its last byte one less and one more
+                for (auto& key : keys)
+                {
+                    errors += !checkProbe(node, &keys, key);
+                    string below = key, above = key;
+                    below[keyLength - 1]--;
+                    above[keyLength - 1]++;
+                    errors += !checkProbe(node, &keys, below);
+                    errors += !checkProbe(node, &keys, above);
+                }
+
+                // Random keys sharing the prefix, and keys before and after the prefix
+                string prefix = count > 0 ? keys[0].substr(0, keyLength - suffixLength) : string();
+                for (int i = 0; i < 16; i++)
+                {
+                    string key = rng() % 4 == 0 ? string() : prefix;
+                    while ((int)key.size() < keyLength)
+                        key += (char)(rng() % 256);
+                    errors += !checkProbe(node, &keys, key);
+                }
+                errors += !checkProbe(node, &keys, string(keyLength, 0));
+                errors += !checkProbe(node, &keys, string(keyLength, (char)255));
+            }
+            check(errors == 0, testCase + ": " + to_string(errors) + " probe(s) found wrong position");
+        }
+    }
+
+    delete node;
+    Utils::deleteFile(FILENAME);
+}
+
+// Main function
+int main()
+{
+    MiniSQL::init();
+
+    testCountNotGreater();
+    cout << probeCount << " probes checked." << endl;
+
+    MiniSQL::cleanUp();
+    return report("bpTreeNodeTest");
+}
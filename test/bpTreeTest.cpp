@@ -0,0 +1,306 @@
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "global.h"
+#include "minisql.h"
+#include "utils/utils.h"
+#include "buffer/bufferManager.h"
+#include "file/heapFile.h"
+#include "index/bpTree.h"
+#include "test.h"
+
+using namespace std;
+
+// Test file and length of its keys
+static const char* FILENAME = "index/test_bptree";
+static const int KEY_LENGTH = 16;
+
+// File whose blocks are pinned to fill buffer
+static const char* PIN_FILENAME = "record/test_pins";
+
+// Write key of number, which sorts like the number
+static void makeKey(int i, char* key)
+{
+    char text[KEY_LENGTH + 1];
+    snprintf(text, sizeof(text), "%0*d", KEY_LENGTH, i);
+    memcpy(key, text, KEY_LENGTH);
+}
+
+// Check that tree holds exactly the numbers kept, with each key pointing to its number
+// Missing keys and the end of leaves are told by negative values
+// Keys are checked both by walking leaves in order and by finding each of them
+static void checkContent(BPTree* tree, const vector<bool>* kept, const string& testName)
+{
+    char key[KEY_LENGTH];
+    int count = 0, expected = 0, errors = 0;
+    int last = -1;
+
+    tree->seek(NULL, true);
+    for (int value; (value = tree->next(key)) >= 0; count++)
+    {
+        char expectedKey[KEY_LENGTH];
+        makeKey(value, expectedKey);
+        if (value <= last || value >= (int)kept->size() || !kept->at(value) || memcmp(key, expectedKey, KEY_LENGTH) != 0)
+            errors++;
+        last = value;
+    }
+    tree->closeCursor();
+
+    for (int i = 0; i < (int)kept->size(); i++)
+    {
+        makeKey(i, key);
+        int value = tree->find(key);
+        if (kept->at(i) ? value != i : value >= 0)
+            errors++;
+        expected += kept->at(i);
+    }
+    check(errors == 0 && count == expected, testName + ": tree content differs from keys kept");
+}
+
+// Appending ascending keys splits the rightmost leaf unevenly, so leaves left behind stay nearly full
+static void testAppendSplit()
+{
+    const int keyCount = 100000;
+    BPTree::createFile(FILENAME, KEY_LENGTH);
+    BPTree* tree = new BPTree(FILENAME);
+
+    char key[KEY_LENGTH];
+    for (int i = 0; i < keyCount; i++)
+    {
+        makeKey(i, key);
+        tree->add(key, i);
+    }
+
+    // Keys appended to a split leaf go to new rightmost leaf. Left leaf keeps APPEND_SPLIT_PERCENT of keys
+    int height, nodes, leaves;
+    long long leafBytes;
+    tree->analyze(&height, &nodes, &leaves, &leafBytes);
+    double fill = (double)leafBytes / leaves / BLOCK_SIZE;
+    check(fill > 0.85, "testAppendSplit: average leaf fill " + to_string(fill) + " is not near 90%");
+
+    vector<bool> kept(keyCount, true);
+    checkContent(tree, &kept, "testAppendSplit");
+
+    delete tree;
+    Utils::deleteFile(FILENAME);
+}
+
+// Threads append interleaved ascending keys to the rightmost leaf at the same time
+// Another thread removes every fourth key behind them, and readers find keys already appended
+static void testConcurrentAppendRemove()
+{
+    const int keyCount = 200000, threadCount = 4;
+    BPTree::createFile(FILENAME, KEY_LENGTH);
+    BPTree* tree = new BPTree(FILENAME);
+
+    // Number of keys appended by each thread so far
+    vector<atomic<int>> appended(threadCount);
+    for (auto& a : appended)
+        a = 0;
+    atomic<int> errors(0);
+    atomic<bool> stop(false);
+    vector<thread> threads;
+
+    for (int t = 0; t < threadCount; t++)
+        threads.emplace_back([&, t]
+        {
+            char key[KEY_LENGTH];
+            for (int j = 0; j * threadCount + t < keyCount; j++)
+            {
+                makeKey(j * threadCount + t, key);
+                if (!tree->add(key, j * threadCount + t))
+                    errors++;
+                appended[t] = j + 1;
+            }
+        });
+
+    // Key is removed once its thread has appended it
+    threads.emplace_back([&]
+    {
+        char key[KEY_LENGTH];
+        for (int i = 0; i < keyCount; i += 4)
+        {
+            while (appended[i % threadCount] <= i / threadCount)
+                this_thread::yield();
+            makeKey(i, key);
+            if (!tree->remove(key))
+                errors++;
+        }
+    });
+
+    // Keys not divisible by 4 stay once appended
+    threads.emplace_back([&]
+    {
+        char key[KEY_LENGTH];
+        unsigned int seed = 1;
+        while (!stop)
+        {
+            seed = seed * 1103515245 + 12345;
+            int t = seed % threadCount;
+            int count = appended[t];
+            if (count == 0)
+                continue;
+            int i = (int)(seed / threadCount % count) * threadCount + t;
+            makeKey(i, key);
+            if (i % 4 != 0 && tree->find(key) != i)
+                errors++;
+        }
+    });
+
+    for (int t = 0; t <= threadCount; t++)
+        threads[t].join();
+    stop = true;
+    threads.back().join();
+    check(errors == 0, "testConcurrentAppendRemove: " + to_string(errors) + " add, remove or find failed");
+
+    vector<bool> kept(keyCount);
+    for (int i = 0; i < keyCount; i++)
+        kept[i] = i % 4 != 0;
+    checkContent(tree, &kept, "testConcurrentAppendRemove");
+
+    delete tree;
+    Utils::deleteFile(FILENAME);
+}
+
+// Buffered tree drops insertion of a key already in leaves when messages are applied, unless key is removed first
+// A cursor open while messages are applied continues after the last key it read
+static void testBufferedFlush()
+{
+    const int keyCount = 100000;
+    BPTree::createFile(FILENAME, KEY_LENGTH, true);
+    BPTree* tree = new BPTree(FILENAME);
+
+    char key[KEY_LENGTH];
+    for (int i = 0; i < keyCount; i += 2)
+    {
+        makeKey(i, key);
+        tree->add(key, i);
+    }
+    tree->flushHeader();
+
+    // Duplicate is accepted as a message, and dropped once applied
+    makeKey(0, key);
+    check(tree->add(key, 1), "testBufferedFlush: insertion of key in leaves is not buffered");
+    makeKey(2, key);
+    tree->remove(key);
+    check(tree->add(key, 2), "testBufferedFlush: insertion after removal is rejected");
+    tree->flushHeader();
+    makeKey(0, key);
+    check(tree->find(key) == 0, "testBufferedFlush: duplicate insertion replaced key in leaves");
+    makeKey(2, key);
+    check(tree->find(key) == 2, "testBufferedFlush: insertion after removal is lost");
+
+    // Cursor reads pending messages along with leaves. They are all applied while it is in the middle
+    for (int i = 1; i < keyCount; i += 4)
+    {
+        makeKey(i, key);
+        tree->add(key, i);
+    }
+    int last = -1;
+    tree->seek(NULL, true);
+    for (int i = 0; i < keyCount / 100; i++)
+        last = tree->next(key);
+    for (int i = 3; i < keyCount; i += 4)
+    {
+        makeKey(i, key);
+        tree->add(key, i);
+    }
+    tree->flushHeader();
+
+    int errors = 0, count = 0, expected = keyCount - 1 - last;
+    for (int value; (value = tree->next(key)) >= 0; count++)
+    {
+        if (value <= last)
+            errors++;
+        last = value;
+    }
+    tree->closeCursor();
+    check(
+        errors == 0 && count == expected,
+        "testBufferedFlush: cursor did not continue after messages were applied"
+    );
+
+    vector<bool> kept(keyCount, true);
+    checkContent(tree, &kept, "testBufferedFlush");
+
+    delete tree;
+    Utils::deleteFile(FILENAME);
+}
+
+// Tree is changed while all blocks of buffer are pinned elsewhere, so it waits for an unpin to load any node
+// Keys added and removed meanwhile are all in place once blocks are unpinned
+static void testPinsRunOut()
+{
+    const int keyCount = 20000;
+    BPTree::createFile(FILENAME, KEY_LENGTH);
+    BPTree* tree = new BPTree(FILENAME);
+
+    char key[KEY_LENGTH];
+    for (int i = 0; i < keyCount; i++)
+    {
+        makeKey(i, key);
+        tree->add(key, i);
+    }
+
+    // Blocks of another file replace every block of tree
+    BufferManager* manager = MiniSQL::getBufferManager();
+    HeapFile::createFile(PIN_FILENAME, 4);
+    vector<Block*> pinned;
+    for (int id = 0; id < BufferManager::MAX_BLOCK_COUNT; id++)
+        pinned.push_back(manager->pinBlock(PIN_FILENAME, id));
+
+    // Writer appends keys after all keys and removes every other old key, which splits and merges nodes
+    atomic<int> changed(0);
+    int errors = 0;
+    thread writer([&]
+    {
+        char key[KEY_LENGTH];
+        for (int i = keyCount; i < keyCount * 2; i++)
+        {
+            makeKey(i, key);
+            errors += !tree->add(key, i);
+            changed++;
+        }
+        for (int i = 0; i < keyCount; i += 2)
+        {
+            makeKey(i, key);
+            errors += !tree->remove(key);
+            changed++;
+        }
+    });
+
+    this_thread::sleep_for(chrono::milliseconds(BufferManager::PIN_WAIT_TIME / 10));
+    check(changed == 0, "testPinsRunOut: tree was changed while all blocks are pinned");
+    for (auto block : pinned)
+        block->pin--;
+    writer.join();
+    check(errors == 0, "testPinsRunOut: " + to_string(errors) + " add or remove failed");
+
+    vector<bool> kept(keyCount * 2);
+    for (int i = 0; i < keyCount * 2; i++)
+        kept[i] = i >= keyCount || i % 2 == 1;
+    checkContent(tree, &kept, "testPinsRunOut");
+
+    delete tree;
+    Utils::deleteFile(FILENAME);
+    Utils::deleteFile(PIN_FILENAME);
+}
+
+// Main function
+int main()
+{
+    MiniSQL::init();
+
+    testAppendSplit();
+    testConcurrentAppendRemove();
+    testBufferedFlush();
+    testPinsRunOut();
+
+    MiniSQL::cleanUp();
+    return report("bpTreeTest");
+}
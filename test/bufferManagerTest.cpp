@@ -0,0 +1,124 @@
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "global.h"
+#include "minisql.h"
+#include "utils/utils.h"
+#include "file/heapFile.h"
+#include "buffer/bufferManager.h"
+#include "test.h"
+
+using namespace std;
+
+// Test file, which has more blocks than buffer holds
+static const char* FILENAME = "record/test_buffer";
+static const int BLOCK_COUNT = BufferManager::MAX_BLOCK_COUNT * 4;
+
+// Threads pin batches of random blocks while blocks are replaced, and each thread updates its own blocks
+// Content of every block is checked whenever it is pinned, so a replaced pinned block or a lost write is found
+// Batches of all threads fit in buffer together, as running out of blocks aborts
+static void testConcurrentPins()
+{
+    const int threadCount = 8, roundCount = 2000, maxBatch = BufferManager::MAX_BLOCK_COUNT / threadCount;
+    BufferManager* manager = MiniSQL::getBufferManager();
+
+    // Block stores its id followed by number of updates
+    for (int id = 0; id < BLOCK_COUNT; id++)
+    {
+        Block* block = manager->pinBlock(FILENAME, id);
+        int header[] = {id, 0};
+        memcpy(block->content, header, 8);
+        block->dirty = true;
+        block->pin--;
+    }
+
+    vector<int> errors(threadCount, 0);
+    vector<thread> threads;
+    for (int t = 0; t < threadCount; t++)
+        threads.emplace_back([&, t]
+        {
+            mt19937 rng(t);
+            vector<int> updates(BLOCK_COUNT, 0);
+            for (int round = 0; round < roundCount; round++)
+            {
+                vector<Block*> pinned;
+                int batch = 1 + rng() % maxBatch;
+                for (int i = 0; i < batch; i++)
+                {
+                    int id = rng() % BLOCK_COUNT;
+                    Block* block = manager->pinBlock(FILENAME, id);
+                    pinned.push_back(block);
+
+                    int header[2];
+                    memcpy(header, block->content, 8);
+                    if (block->id != id || header[0] != id)
+                        errors[t]++;
+
+                    // Only thread of block updates it, under the version latch like index nodes
+                    if (id % threadCount == t)
+                    {
+                        if (header[1] != updates[id])
+                            errors[t]++;
+                        unsigned int version = block->version.load();
+                        if ((version & 1) == 0 && block->version.compare_exchange_strong(version, version + 1))
+                        {
+                            header[1] = ++updates[id];
+                            memcpy(block->content + 4, &header[1], 4);
+                            block->dirty = true;
+                            block->version++;
+                        }
+                    }
+                }
+                for (auto block : pinned)
+                    block->pin--;
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+
+    int errorCount = 0;
+    for (int e : errors)
+        errorCount += e;
+    check(errorCount == 0, "Pinned blocks were replaced or updates were lost");
+}
+
+// When all blocks are pinned, fetching another block waits for an unpin
+static void testAllPinned()
+{
+    BufferManager* manager = MiniSQL::getBufferManager();
+    vector<Block*> pinned;
+    for (int id = 0; id < BufferManager::MAX_BLOCK_COUNT; id++)
+        pinned.push_back(manager->pinBlock(FILENAME, id));
+
+    // A block unpinned by another thread while waiting is replaced
+    Block* waitedBlock = NULL;
+    thread waiter([&]
+    {
+        waitedBlock = manager->pinBlock(FILENAME, BufferManager::MAX_BLOCK_COUNT);
+    });
+    this_thread::sleep_for(chrono::milliseconds(BufferManager::PIN_WAIT_TIME / 10));
+    pinned[0]->pin--;
+    waiter.join();
+    check(waitedBlock->id == BufferManager::MAX_BLOCK_COUNT, "Block was not fetched after another block was unpinned");
+
+    waitedBlock->pin--;
+    for (int i = 1; i < (int)pinned.size(); i++)
+        pinned[i]->pin--;
+}
+
+// Main function
+int main()
+{
+    MiniSQL::init();
+    HeapFile::createFile(FILENAME, 4);
+
+    testConcurrentPins();
+    testAllPinned();
+
+    Utils::deleteFile(FILENAME);
+    MiniSQL::cleanUp();
+    return report("bufferManagerTest");
+}
@@ -0,0 +1,34 @@
+#ifndef _TEST_H
+#define _TEST_H
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Helpers shared by test programs. Each program is built by `make test` and run from the root folder
+// Files of a test are created under data folders with names starting with test_, and deleted afterwards
+
+// Number of failed checks
+static int failCount = 0;
+
+// Count failed check and print its message
+static void check(bool cond, const string& message)
+{
+    if (cond)
+        return;
+    cerr << "FAILED: " << message << endl;
+    failCount++;
+}
+
+// Print result of test. Return exit code of test program
+static int report(const char* testName)
+{
+    if (failCount == 0)
+        cout << testName << ": all checks passed." << endl;
+    else
+        cout << testName << ": " << failCount << " check(s) failed!" << endl;
+    return failCount == 0 ? 0 : 1;
+}
+
+#endif